@@ -0,0 +1,53 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+
+#include "alloc-count.h"
+
+/* glibc's own allocator, which these wrap. operator new goes through
+   malloc(), and free() is left alone. */
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+}
+
+namespace {
+    /* Plain data, so that reaching it never allocates (which would recurse). */
+    thread_local unsigned long thread_count = 0;
+}
+
+extern "C" void* malloc(size_t size) {
+    ++thread_count;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    ++thread_count;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    ++thread_count;
+    return __libc_realloc(ptr, size);
+}
+
+unsigned long alloc_count::get() {
+    return thread_count;
+}
@@ -0,0 +1,39 @@
+#ifndef GRIDMGR_ALLOC_COUNT_H
+#define GRIDMGR_ALLOC_COUNT_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+/* Counts heap allocations, to check that the daemon's commands don't
+ * allocate once it's warmed up: see the "allocations" counter in --stats.
+ *
+ * Only compiled in when built with -DCOUNT_ALLOCS=ON, which replaces
+ * malloc(), calloc(), and realloc() for the whole process, Xlib included.
+ * Otherwise nothing is counted. */
+namespace alloc_count {
+#ifdef COUNT_ALLOCS
+    /* Returns how many allocations the calling thread has made so far. */
+    unsigned long get();
+#else
+    inline unsigned long get() { return 0; }
+#endif
+}
+
+#endif
@@ -0,0 +1,236 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "async-log.h"
+#include "io-util.h"
+
+/* Must be a power of two. 1024 * 256 bytes = 256KB of queued lines. */
+#define RING_SIZE 1024
+/* How much the writer collects before each write(). */
+#define BATCH_SIZE 65536
+
+namespace {
+    /* A bounded multi-producer queue (after Dmitry Vyukov's): each slot's
+       sequence number says whether it's ready to be filled (== position) or
+       ready to be read (== position + 1), so producers only contend on a
+       single counter and never wait on each other or on the writer. */
+    struct Slot {
+        std::atomic<size_t> seq;
+        size_t len;
+        char data[ASYNC_LOG_RECORD_MAX];
+    };
+
+    struct Ring {
+        Slot slots[RING_SIZE];
+        std::atomic<size_t> enqueue_pos;
+        // only touched by the writer
+        size_t dequeue_pos;
+        std::atomic<unsigned long> dropped;
+        // set while the writer is about to sleep, so producers know to wake it
+        std::atomic<bool> sleeping;
+        std::atomic<bool> stopping;
+        int wake_pipe[2];
+        int fd;
+        std::thread writer;
+    };
+
+    std::atomic<Ring*> ring(NULL);
+    std::atomic<FILE*> target(NULL);
+
+    bool pop(Ring& r, char* out, size_t& len_out) {
+        Slot& slot = r.slots[r.dequeue_pos & (RING_SIZE - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != r.dequeue_pos + 1) {
+            return false;// empty, or the producer is still copying
+        }
+        memcpy(out, slot.data, slot.len);
+        len_out = slot.len;
+        slot.seq.store(r.dequeue_pos + RING_SIZE, std::memory_order_release);
+        ++r.dequeue_pos;
+        return true;
+    }
+
+    /* Writes everything queued so far, ignoring write errors since there's
+       nowhere left to report them. Returns whether anything was written. */
+    bool drain(Ring& r, char* batch) {
+        size_t batch_len = 0, len;
+        bool any = false;
+        while (pop(r, batch + batch_len, len)) {
+            batch_len += len;
+            any = true;
+            if (batch_len + ASYNC_LOG_RECORD_MAX > BATCH_SIZE) {
+                io_util::write_all(r.fd, batch, batch_len);
+                batch_len = 0;
+            }
+        }
+        unsigned long dropped = r.dropped.exchange(0);
+        if (dropped > 0) {
+            batch_len += snprintf(batch + batch_len, BATCH_SIZE - batch_len,
+                    "LOG async_log dropped %lu lines\n", dropped);
+        }
+        if (batch_len > 0) {
+            io_util::write_all(r.fd, batch, batch_len);
+        }
+        return any;
+    }
+
+    void writer_loop(Ring* r) {
+        char* batch = new char[BATCH_SIZE];
+        for (;;) {
+            if (drain(*r, batch)) {
+                continue;
+            }
+            if (r->stopping.load()) {
+                break;
+            }
+            /* announce that we're going to sleep, then check once more: a
+               producer either sees 'sleeping' and wakes us, or we see its line.
+               the fences (here and in wake()) keep the store to 'sleeping' from
+               being ordered after the loads of the slots, and the producer's
+               store to its slot from being ordered after its load of 'sleeping'. */
+            r->sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (drain(*r, batch)) {
+                r->sleeping.store(false);
+                continue;
+            }
+            struct pollfd pfd;
+            pfd.fd = r->wake_pipe[0];
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, -1) > 0) {
+                char buf[64];
+                while (read(r->wake_pipe[0], buf, sizeof(buf)) > 0) { }
+            }
+            r->sleeping.store(false);
+        }
+        delete[] batch;
+    }
+
+    void wake(Ring& r) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (r.sleeping.load() && r.sleeping.exchange(false)) {
+            char c = 1;
+            if (write(r.wake_pipe[1], &c, 1) < 0) {
+                // pipe full: the writer is already awake
+            }
+        }
+    }
+
+    void stop_at_exit() {
+        async_log::stop();
+    }
+}
+
+bool async_log::start(FILE* file) {
+    if (ring.load() != NULL) {
+        return false;
+    }
+    fflush(file);
+
+    Ring* r = new Ring;
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+        r->slots[i].seq.store(i);
+    }
+    r->enqueue_pos.store(0);
+    r->dequeue_pos = 0;
+    r->dropped.store(0);
+    r->sleeping.store(false);
+    r->stopping.store(false);
+    r->fd = fileno(file);
+    if (pipe(r->wake_pipe) != 0) {
+        delete r;
+        return false;
+    }
+    for (int i = 0; i < 2; ++i) {
+        fcntl(r->wake_pipe[i], F_SETFL, fcntl(r->wake_pipe[i], F_GETFL, 0) | O_NONBLOCK);
+    }
+    r->writer = std::thread(writer_loop, r);
+
+    ring.store(r);
+    target.store(file);
+    atexit(stop_at_exit);
+    return true;
+}
+
+void async_log::stop() {
+    Ring* r = ring.load();
+    if (r == NULL) {
+        return;
+    }
+    // log synchronously again from here on
+    target.store(NULL);
+    ring.store(NULL);
+    r->stopping.store(true);
+    char c = 1;
+    if (write(r->wake_pipe[1], &c, 1) < 0) {
+        // pipe full: the writer is already awake
+    }
+    r->writer.join();
+    /* the ring and its pipe are left behind rather than freed: this runs at
+       exit, when other threads (eg the daemon's) may still be in push() with
+       the ring they loaded earlier. whatever they queue now is dropped. */
+}
+
+bool async_log::is_target(FILE* file) {
+    FILE* cur = target.load(std::memory_order_relaxed);
+    return cur != NULL && file == cur;
+}
+
+bool async_log::push(const char* line, size_t len) {
+    Ring* r = ring.load();
+    if (r == NULL) {
+        return false;
+    }
+    if (len > ASYNC_LOG_RECORD_MAX) {
+        len = ASYNC_LOG_RECORD_MAX;
+    }
+
+    size_t pos = r->enqueue_pos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &r->slots[pos & (RING_SIZE - 1)];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        long diff = (long)seq - (long)pos;
+        if (diff == 0) {
+            if (r->enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                            std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the writer hasn't caught up: drop rather than wait
+            r->dropped.fetch_add(1, std::memory_order_relaxed);
+            wake(*r);
+            return false;
+        } else {
+            pos = r->enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    memcpy(slot->data, line, len);
+    slot->len = len;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    wake(*r);
+    return true;
+}
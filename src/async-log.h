@@ -0,0 +1,54 @@
+#ifndef GRIDMGR_ASYNC_LOG_H
+#define GRIDMGR_ASYNC_LOG_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <stdio.h>
+
+/* Longest line which may be logged, including the newline. Longer lines are
+ * truncated. */
+#define ASYNC_LOG_RECORD_MAX 256
+
+/* Writes log lines to a file from a background thread, so that logging never
+ * waits on the disk. Lines are queued in a fixed-size lock-free ring, and the
+ * writer empties the ring with as few write() calls as possible. If the ring
+ * fills up, lines are dropped rather than waiting, and the number of dropped
+ * lines is written to the file once there's room. */
+namespace async_log {
+    /* Starts writing lines logged to 'file' in the background. Anything
+     * already buffered in 'file' is flushed first. The writer is stopped (and
+     * any queued lines written) at exit. Returns false if the writer couldn't
+     * be started, in which case logging to 'file' stays synchronous. */
+    bool start(FILE* file);
+
+    /* Writes any queued lines and stops the writer. Lines logged afterwards
+     * are written synchronously, except for any which were already being
+     * queued by other threads at the time, which are dropped. */
+    void stop();
+
+    /* Returns whether lines for 'file' should be passed to push(). */
+    bool is_target(FILE* file);
+
+    /* Queues a line, which should end in a newline. Never blocks.
+     * Returns false if the line was dropped because the ring is full. */
+    bool push(const char* line, size_t len);
+}
+
+#endif
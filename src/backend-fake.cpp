@@ -0,0 +1,449 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#include <algorithm>
+
+#include "backend-fake.h"
+#include "config.h"
+
+#define ROOT_WINDOW 0x100
+/* Client i is FIRST_CLIENT + 2i, and its frame is the id after it. */
+#define FIRST_CLIENT 0x400000
+#define FIRST_ATOM 1000
+
+#define MONITOR_WIDTH 1920
+#define MONITOR_HEIGHT 1080
+#define DOCK_HEIGHT 30
+#define FRAME_BORDER 2
+#define FRAME_TITLE 20
+/* Every TERMINAL_EVERY'th window only resizes by whole character cells. */
+#define TERMINAL_EVERY 4
+#define TERMINAL_BASE 4
+#define TERMINAL_CELL_WIDTH 9
+#define TERMINAL_CELL_HEIGHT 17
+
+namespace {
+    inline Window client_id(size_t index) {
+        return FIRST_CLIENT + (index * 2);
+    }
+    inline Window frame_id(size_t index) {
+        return client_id(index) + 1;
+    }
+
+    /* Deterministic, so that runs with the same count can be compared. */
+    unsigned long next_random(unsigned long& state) {
+        state = (state * 1103515245 + 12345) & 0x7fffffff;
+        return state >> 8;
+    }
+
+    /* Holds one axis of a client's size to its WM_NORMAL_HINTS. */
+    unsigned long constrain(unsigned long size, unsigned long min,
+            unsigned long base, unsigned long inc) {
+        if (size > base && inc > 1) {
+            size = base + (size - base) / inc * inc;
+        }
+        return (size < min) ? min : size;
+    }
+}
+
+FakeBackend::FakeBackend(size_t window_count, size_t monitor_count) {
+    if (monitor_count == 0) {
+        monitor_count = 1;
+    }
+    for (size_t i = 0; i < monitor_count; ++i) {
+        monitors.push_back(Dimensions());
+        Dimensions& m = monitors.back();
+        m.x = i * MONITOR_WIDTH;
+        m.y = 0;
+        m.width = MONITOR_WIDTH;
+        m.height = MONITOR_HEIGHT;
+    }
+    workarea.x = 0;
+    workarea.y = DOCK_HEIGHT;
+    workarea.width = monitor_count * MONITOR_WIDTH;
+    workarea.height = MONITOR_HEIGHT - DOCK_HEIGHT;
+
+    active_atom = atom("_NET_ACTIVE_WINDOW");
+    state_atom = atom("_NET_WM_STATE");
+    desktop_atom = atom("_NET_WM_DESKTOP");
+    max_vert_atom = atom("_NET_WM_STATE_MAXIMIZED_VERT");
+    max_horz_atom = atom("_NET_WM_STATE_MAXIMIZED_HORZ");
+    Atom type_atom = atom("_NET_WM_WINDOW_TYPE"), utf8_atom = atom("UTF8_STRING");
+
+    // the dock, with a strut covering the top of the first monitor
+    frames.push_back(Dimensions());
+    frames.back().x = 0;
+    frames.back().y = 0;
+    frames.back().width = MONITOR_WIDTH;
+    frames.back().height = DOCK_HEIGHT;
+    {
+        unsigned long dock_type = atom("_NET_WM_WINDOW_TYPE_DOCK");
+        set_longs(client_id(0), XA_ATOM, type_atom, &dock_type, 1);
+        unsigned long strut[12] = { 0, 0, DOCK_HEIGHT, 0, 0, 0, 0, 0, 0, MONITOR_WIDTH - 1, 0, 0 };
+        set_longs(client_id(0), XA_CARDINAL, atom("_NET_WM_STRUT_PARTIAL"), strut, 12);
+        set_string(client_id(0), XA_STRING, XA_WM_CLASS, std::string("dock\0Dock\0", 10));
+    }
+
+    // the windows, at random sizes and positions within the workarea
+    unsigned long normal_type = atom("_NET_WM_WINDOW_TYPE_NORMAL"), all_desktops = 0;
+    unsigned long random = 1;
+    for (size_t i = 1; i <= window_count; ++i) {
+        const Dimensions& m = monitors[i % monitors.size()];
+        frames.push_back(Dimensions());
+        Dimensions& f = frames.back();
+        f.width = 300 + (next_random(random) % (MONITOR_WIDTH / 2));
+        f.height = 200 + (next_random(random) % ((MONITOR_HEIGHT - DOCK_HEIGHT) / 2));
+        f.x = m.x + (next_random(random) % (m.width - f.width));
+        f.y = workarea.y + (next_random(random) % (workarea.height - f.height));
+
+        Window win = client_id(i);
+        set_longs(win, XA_ATOM, type_atom, &normal_type, 1);
+        set_longs(win, XA_ATOM, state_atom, NULL, 0);
+        // room for maximizing etc, so that messages don't allocate
+        props[std::make_pair(win, state_atom)].data.reserve(4 * sizeof(long));
+        set_longs(win, XA_CARDINAL, desktop_atom, &all_desktops, 1);
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "app%lu", i % 8);
+        std::string wm_class(buf, len + 1);
+        wm_class.append("App\0", 4);
+        set_string(win, XA_STRING, XA_WM_CLASS, wm_class);
+        len = snprintf(buf, sizeof(buf), "window %lu", i);
+        set_string(win, utf8_atom, atom("_NET_WM_NAME"), std::string(buf, len));
+        if (i % TERMINAL_EVERY == 0) {
+            // flags, x/y/w/h, min, max, inc, min/max aspect, base, gravity
+            unsigned long hints[18] = { PMinSize | PResizeInc | PBaseSize, 0, 0, 0, 0,
+                TERMINAL_BASE + TERMINAL_CELL_WIDTH, TERMINAL_BASE + TERMINAL_CELL_HEIGHT,
+                0, 0, TERMINAL_CELL_WIDTH, TERMINAL_CELL_HEIGHT, 0, 0, 0, 0,
+                TERMINAL_BASE, TERMINAL_BASE, NorthWestGravity };
+            set_longs(win, XA_WM_SIZE_HINTS, XA_WM_NORMAL_HINTS, hints, 18);
+        }
+    }
+
+    std::vector<unsigned long> clients;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        clients.push_back(client_id(i));
+    }
+    set_longs(ROOT_WINDOW, XA_WINDOW, atom("_NET_CLIENT_LIST"), &clients[0], clients.size());
+    set_longs(ROOT_WINDOW, XA_WINDOW, active_atom, &clients.back(), 1);
+    unsigned long desktop = 0, desktops = 1;
+    set_longs(ROOT_WINDOW, XA_CARDINAL, atom("_NET_CURRENT_DESKTOP"), &desktop, 1);
+    set_longs(ROOT_WINDOW, XA_CARDINAL, atom("_NET_NUMBER_OF_DESKTOPS"), &desktops, 1);
+    unsigned long area[4] = { (unsigned long)workarea.x, (unsigned long)workarea.y,
+                              workarea.width, workarea.height };
+    set_longs(ROOT_WINDOW, XA_CARDINAL, atom("_NET_WORKAREA"), area, 4);
+    DEBUG("fake desktop: %lu windows on %lu monitors", window_count, monitors.size());
+}
+
+Display* FakeBackend::Open(const char* /*name*/) {
+    return OpenStub(ROOT_WINDOW, monitors.size() * MONITOR_WIDTH, MONITOR_HEIGHT);
+}
+
+void FakeBackend::Close(Display* disp) {
+    CloseStub(disp);
+}
+
+void FakeBackend::Flush(Display* /*disp*/) {
+    // nothing is queued
+}
+
+Atom FakeBackend::InternAtom(Display* disp, const char* name) {
+    CountRequest(disp);
+    return atom(name);
+}
+
+bool FakeBackend::AtomName(Display* disp, Atom atom, std::string& out) {
+    CountRequest(disp);
+    for (std::map<std::string, Atom>::const_iterator iter = atoms.begin();
+         iter != atoms.end(); ++iter) {
+        if (iter->second == atom) {
+            out = iter->first;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned char* FakeBackend::GetProperty(Display* disp, Window win,
+        Atom type, Atom name, size_t* out_count, int* out_format) {
+    CountRequest(disp);
+    prop_map_t::const_iterator iter = props.find(std::make_pair(win, name));
+    if (iter == props.end() || iter->second.type != type) {
+        return NULL;
+    }
+    const Property& prop = iter->second;
+    // like Xlib, allocate an extra byte so that strings are terminated
+    unsigned char* ret = (unsigned char*)malloc(prop.data.size() + 1);
+    memcpy(ret, prop.data.data(), prop.data.size());
+    ret[prop.data.size()] = 0;
+    *out_count = (prop.format == 32) ? prop.data.size() / sizeof(long) : prop.data.size();
+    *out_format = prop.format;
+    return ret;
+}
+
+bool FakeBackend::GetValues(Display* disp, Window win, Atom type, Atom name,
+        unsigned long* out, size_t capacity, size_t* out_count) {
+    CountRequest(disp);
+    prop_map_t::const_iterator iter = props.find(std::make_pair(win, name));
+    if (iter == props.end() || iter->second.type != type || iter->second.format != 32) {
+        return false;
+    }
+    const std::string& data = iter->second.data;
+    size_t count = std::min(capacity, data.size() / sizeof(long));
+    memcpy(out, data.data(), count * sizeof(long));
+    *out_count = count;
+    return true;
+}
+
+void FakeBackend::GetProperties(Display* disp, const Window* wins, size_t count,
+        Atom type, Atom name, prop_list_t& out) {
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        PropertyReply& reply = out[i];
+        reply.count = 0;
+        reply.format = 0;
+        reply.data = GetProperty(disp, wins[i], type, name, &reply.count, &reply.format);
+    }
+}
+
+void FakeBackend::GetWindowProperties(Display* disp, Window win, const Atom* types,
+        const Atom* names, size_t count, prop_list_t& out) {
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        PropertyReply& reply = out[i];
+        reply.count = 0;
+        reply.format = 0;
+        reply.data = GetProperty(disp, win, types[i], names[i], &reply.count, &reply.format);
+    }
+}
+
+void FakeBackend::SetProperty(Display* disp, Window win,
+        Atom type, Atom name, const unsigned long* values, size_t count) {
+    CountRequest(disp);
+    if (count == 0) {
+        props.erase(std::make_pair(win, name));
+    } else {
+        set_longs(win, type, name, values, count);
+    }
+}
+
+Status FakeBackend::GetGeometry(Display* disp, Window win, Window* out_root,
+        int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+        unsigned int* out_border, unsigned int* out_depth) {
+    CountRequest(disp);
+    *out_root = ROOT_WINDOW;
+    *out_border = 0;
+    *out_depth = 24;
+    if (win == ROOT_WINDOW) {
+        *out_x = *out_y = 0;
+        *out_width = monitors.size() * MONITOR_WIDTH;
+        *out_height = MONITOR_HEIGHT;
+        return 1;
+    }
+    size_t index;
+    if (!client_index(win & ~1UL, index)) {
+        return 0;
+    }
+    const Dimensions& frame = frames[index];
+    if (win == frame_id(index)) {
+        *out_x = frame.x;
+        *out_y = frame.y;
+        *out_width = frame.width;
+        *out_height = frame.height;
+    } else {
+        // relative to the frame
+        *out_x = FRAME_BORDER;
+        *out_y = FRAME_TITLE;
+        *out_width = frame.width - (2 * FRAME_BORDER);
+        *out_height = frame.height - FRAME_TITLE - FRAME_BORDER;
+    }
+    return 1;
+}
+
+Status FakeBackend::QueryTree(Display* disp, Window win, Window* out_root, Window* out_parent,
+        Window** out_children, unsigned int* out_children_count) {
+    CountRequest(disp);
+    *out_root = ROOT_WINDOW;
+    *out_children = NULL;
+    *out_children_count = 0;
+    if (win == ROOT_WINDOW) {
+        *out_parent = None;
+        *out_children = (Window*)malloc(frames.size() * sizeof(Window));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            (*out_children)[i] = frame_id(i);
+        }
+        *out_children_count = frames.size();
+        return 1;
+    }
+    size_t index;
+    if (!client_index(win & ~1UL, index)) {
+        return 0;
+    }
+    if (win == frame_id(index)) {
+        *out_parent = ROOT_WINDOW;
+        *out_children = (Window*)malloc(sizeof(Window));
+        (*out_children)[0] = client_id(index);
+        *out_children_count = 1;
+    } else {
+        *out_parent = frame_id(index);
+    }
+    return 1;
+}
+
+bool FakeBackend::QueryScreens(Display* disp, dim_list_t& out) {
+    CountRequest(disp);
+    out = monitors;
+    return true;
+}
+
+bool FakeBackend::SendMessage(Display* disp, Window win, Atom type, const long data[5]) {
+    CountRequest(disp);
+    size_t index;
+    if (!client_index(win, index)) {
+        DEBUG("fake: message for unknown window %lu", win);
+        return true;// like X, the error would only show up later
+    }
+    if (type == active_atom) {
+        unsigned long active = win;
+        set_longs(ROOT_WINDOW, XA_WINDOW, type, &active, 1);
+    } else if (type == state_atom) {
+        update_state(win, data[0], data[1], data[2]);
+    } else if (type == desktop_atom) {
+        unsigned long desktop = data[0];
+        set_longs(win, XA_CARDINAL, type, &desktop, 1);
+    }
+    return true;
+}
+
+bool FakeBackend::MoveResize(Display* disp, Window win,
+        long x, long y, unsigned long width, unsigned long height) {
+    CountRequest(disp);
+    size_t index;
+    if (!client_index(win, index)) {
+        return true;
+    }
+    // like a window manager, hold the client to its size hints
+    prop_map_t::const_iterator hints =
+        props.find(std::make_pair(win, (Atom)XA_WM_NORMAL_HINTS));
+    if (hints != props.end()) {
+        const unsigned long* h = (const unsigned long*)hints->second.data.data();
+        width = constrain(width, h[5], h[15], h[9]);
+        height = constrain(height, h[6], h[16], h[10]);
+    }
+    // position is the frame's, size is the client's (see ActiveWindow::MoveResize)
+    Dimensions& frame = frames[index];
+    frame.x = x;
+    frame.y = y;
+    frame.width = width + (2 * FRAME_BORDER);
+    frame.height = height + FRAME_TITLE + FRAME_BORDER;
+    return true;
+}
+
+void FakeBackend::BeginErrorTrap(Display* /*disp*/) {
+}
+
+bool FakeBackend::EndErrorTrap(Display* /*disp*/) {
+    // requests about unknown windows fail without an error
+    return false;
+}
+
+Atom FakeBackend::atom(const char* name) {
+    std::map<std::string, Atom>::const_iterator iter = atoms.find(name);
+    if (iter != atoms.end()) {
+        return iter->second;
+    }
+    Atom ret = FIRST_ATOM + atoms.size();
+    atoms[name] = ret;
+    return ret;
+}
+
+void FakeBackend::set_longs(Window win, Atom type, Atom name,
+        const unsigned long* values, size_t count) {
+    Property& prop = props[std::make_pair(win, name)];
+    prop.type = type;
+    prop.format = 32;
+    if (count == 0) {
+        prop.data.clear();
+    } else {
+        prop.data.assign((const char*)values, count * sizeof(long));
+    }
+}
+
+void FakeBackend::set_string(Window win, Atom type, Atom name, const std::string& value) {
+    Property& prop = props[std::make_pair(win, name)];
+    prop.type = type;
+    prop.format = 8;
+    prop.data = value;
+}
+
+void FakeBackend::update_state(Window win, long action, Atom state1, Atom state2) {
+    Property& prop = props[std::make_pair(win, state_atom)];
+    prop.type = XA_ATOM;
+    prop.format = 32;
+
+    // edited in place, which only allocates when the list grows
+    Atom changes[2] = { state1, state2 };
+    for (size_t c = 0; c < 2; ++c) {
+        if (changes[c] == None) {
+            continue;
+        }
+        unsigned long change = changes[c];
+        size_t found = 0, count = prop.data.size() / sizeof(long);
+        for (; found < count &&
+                     memcmp(prop.data.data() + (found * sizeof(long)), &change, sizeof(long)) != 0;
+             ++found) { }
+        bool has = (found != count);
+        // 0 = remove, 1 = add, 2 = toggle
+        if (has && (action == 0 || action == 2)) {
+            prop.data.erase(found * sizeof(long), sizeof(long));
+        } else if (!has && (action == 1 || action == 2)) {
+            prop.data.append((const char*)&change, sizeof(long));
+        }
+    }
+
+    // maximizing fills the window's monitor, minus the dock
+    size_t index;
+    if (action != 0 && client_index(win, index) &&
+            (state1 == max_vert_atom || state1 == max_horz_atom)) {
+        Dimensions& frame = frames[index];
+        long center_x = frame.x + (frame.width / 2);
+        for (size_t i = 0; i < monitors.size(); ++i) {
+            const Dimensions& m = monitors[i];
+            if (center_x >= m.x && center_x < (long)(m.x + m.width)) {
+                frame.x = m.x;
+                frame.y = workarea.y;
+                frame.width = m.width;
+                frame.height = workarea.height;
+                break;
+            }
+        }
+    }
+}
+
+bool FakeBackend::client_index(Window win, size_t& out) const {
+    if (win < FIRST_CLIENT || (win - FIRST_CLIENT) % 2 != 0) {
+        return false;
+    }
+    out = (win - FIRST_CLIENT) / 2;
+    return out < frames.size();
+}
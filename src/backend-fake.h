@@ -0,0 +1,100 @@
+#ifndef GRIDMGR_BACKEND_FAKE_H
+#define GRIDMGR_BACKEND_FAKE_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <utility>
+
+#include "backend.h"
+
+/* An in-memory desktop which behaves like a reparenting EWMH window manager,
+ * so that whole commands can be run (and timed) without an X server.
+ *
+ * The desktop has side-by-side monitors, a dock along the top of the first
+ * one, and any number of normal windows scattered across them, each in a
+ * frame with a border and titlebar. Some of them are terminals, which only
+ * resize by whole character cells. Activating, moving, maximizing, and
+ * changing the desktop of windows all take effect immediately, as if the
+ * window manager had handled them before the next request. The same windows
+ * are generated every time for a given count. */
+class FakeBackend : public Backend {
+public:
+    FakeBackend(size_t window_count, size_t monitor_count);
+    virtual ~FakeBackend() { }
+
+    Display* Open(const char* name);
+    void Close(Display* disp);
+    void Flush(Display* disp);
+
+    Atom InternAtom(Display* disp, const char* name);
+    bool AtomName(Display* disp, Atom atom, std::string& out);
+
+    unsigned char* GetProperty(Display* disp, Window win,
+            Atom type, Atom name, size_t* out_count, int* out_format);
+    bool GetValues(Display* disp, Window win, Atom type, Atom name,
+            unsigned long* out, size_t capacity, size_t* out_count);
+    void GetProperties(Display* disp, const Window* wins, size_t count,
+            Atom type, Atom name, prop_list_t& out);
+    void GetWindowProperties(Display* disp, Window win, const Atom* types,
+            const Atom* names, size_t count, prop_list_t& out);
+    void SetProperty(Display* disp, Window win,
+            Atom type, Atom name, const unsigned long* values, size_t count);
+
+    Status GetGeometry(Display* disp, Window win, Window* out_root,
+            int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+            unsigned int* out_border, unsigned int* out_depth);
+    Status QueryTree(Display* disp, Window win, Window* out_root, Window* out_parent,
+            Window** out_children, unsigned int* out_children_count);
+    bool QueryScreens(Display* disp, dim_list_t& out);
+
+    bool SendMessage(Display* disp, Window win, Atom type, const long data[5]);
+    bool MoveResize(Display* disp, Window win,
+            long x, long y, unsigned long width, unsigned long height);
+
+    void BeginErrorTrap(Display* disp);
+    bool EndErrorTrap(Display* disp);
+
+private:
+    struct Property {
+        Atom type;
+        int format;
+        std::string data;
+    };
+    typedef std::map<std::pair<Window, Atom>, Property> prop_map_t;
+
+    Atom atom(const char* name);
+    void set_longs(Window win, Atom type, Atom name, const unsigned long* values, size_t count);
+    void set_string(Window win, Atom type, Atom name, const std::string& value);
+    void update_state(Window win, long action, Atom state1, Atom state2);
+
+    /* Returns the index of the client window 'win', or false if it isn't one. */
+    bool client_index(Window win, size_t& out) const;
+
+    std::map<std::string, Atom> atoms;
+    /* Looked up once, so that handling messages doesn't allocate. */
+    Atom active_atom, state_atom, desktop_atom, max_vert_atom, max_horz_atom;
+    prop_map_t props;
+    /* Frames of the dock and clients, in _NET_CLIENT_LIST order. */
+    dim_list_t frames;
+    dim_list_t monitors;
+    Dimensions workarea;
+};
+
+#endif
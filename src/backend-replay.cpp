@@ -0,0 +1,560 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "backend-replay.h"
+#include "config.h"
+
+#define RECORDING_MAGIC 0x47524d52 // "GRMR"
+#define RECORDING_VERSION 1
+
+/* Used for replaying recordings which don't say what their root was. */
+#define DEFAULT_ROOT 0x100
+
+namespace {
+    typedef std::map<std::string, std::string> reply_map_t;
+
+    enum CALL {
+        CALL_ATOM,
+        CALL_PROPERTY,
+        CALL_GEOMETRY,
+        CALL_TREE,
+        CALL_SCREENS,
+        CALL_ROOT
+    };
+
+    /* Replies as they're stored in recordings. */
+    struct property_reply {
+        int32_t found;
+        int32_t format;
+        uint64_t count;
+        // followed by the items
+    };
+
+    struct geometry_reply {
+        int32_t status;
+        int32_t x, y;
+        uint32_t width, height, border, depth;
+        uint64_t root;
+    };
+
+    struct tree_reply {
+        int32_t status;
+        uint32_t children_count;
+        uint64_t root, parent;
+        // followed by the children
+    };
+
+    /* Builds the key for a request. 'win' is translated so that the root
+       window of any display matches. 'name' is only used for atoms. */
+    std::string key(Display* disp, CALL call, Window win,
+            unsigned long arg1 = 0, unsigned long arg2 = 0, const char* name = NULL) {
+        uint64_t vals[4];
+        vals[0] = call;
+        vals[1] = (disp != NULL && win == DefaultRootWindow(disp)) ? 0 : win;
+        vals[2] = arg1;
+        vals[3] = arg2;
+        std::string ret((const char*)vals, sizeof(vals));
+        if (name != NULL) {
+            ret += name;
+        }
+        return ret;
+    }
+
+    /* Size of each item in a property of the given format, as returned by Xlib. */
+    size_t item_size(int format) {
+        switch (format) {
+        case 32:
+            return sizeof(long);
+        case 16:
+            return sizeof(short);
+        default:
+            return 1;
+        }
+    }
+
+    void append_u32(std::string& out, uint32_t val) {
+        out.append((const char*)&val, sizeof(val));
+    }
+
+    bool read_u32(const std::string& in, size_t& pos, uint32_t& out) {
+        if (pos + sizeof(out) > in.size()) {
+            return false;
+        }
+        memcpy(&out, in.data() + pos, sizeof(out));
+        pos += sizeof(out);
+        return true;
+    }
+
+    bool read_str(const std::string& in, size_t& pos, std::string& out) {
+        uint32_t len;
+        if (!read_u32(in, pos, len) || pos + len > in.size()) {
+            return false;
+        }
+        out.assign(in, pos, len);
+        pos += len;
+        return true;
+    }
+
+    bool read_u64(const std::string* reply, uint64_t& out) {
+        if (reply == NULL || reply->size() != sizeof(out)) {
+            return false;
+        }
+        memcpy(&out, reply->data(), sizeof(out));
+        return true;
+    }
+
+    // the one which writes at exit
+    RecordingBackend* recorder = NULL;
+}
+
+bool RecordingBackend::WriteAtExit(const char* new_path) {
+    FILE* file = fopen(new_path, "wb");// check now, rather than after the command
+    if (file == NULL) {
+        ERROR("unable to open %s: %s", new_path, strerror(errno));
+        return false;
+    }
+    fclose(file);
+    path = new_path;
+    if (recorder == NULL) {
+        atexit(write_at_exit);
+    }
+    recorder = this;
+    return true;
+}
+
+void RecordingBackend::write_at_exit() {
+    const reply_map_t& replies = recorder->replies;
+    std::string out;
+    append_u32(out, RECORDING_MAGIC);
+    append_u32(out, RECORDING_VERSION);
+    append_u32(out, replies.size());
+    for (reply_map_t::const_iterator iter = replies.begin();
+         iter != replies.end(); ++iter) {
+        append_u32(out, iter->first.size());
+        out += iter->first;
+        append_u32(out, iter->second.size());
+        out += iter->second;
+    }
+
+    const char* path = recorder->path.c_str();
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        ERROR("unable to open %s: %s", path, strerror(errno));
+        return;
+    }
+    if (fwrite(out.data(), 1, out.size(), file) != out.size()) {
+        ERROR("unable to write %s: %s", path, strerror(errno));
+    }
+    fclose(file);
+    LOG("recorded %lu replies to %s", replies.size(), path);
+}
+
+void RecordingBackend::save(const std::string& key, const void* reply, size_t len) {
+    if (replies.find(key) == replies.end()) {
+        replies[key].assign((const char*)reply, len);
+    }
+}
+
+void RecordingBackend::save_property(Display* disp, Window win, Atom type, Atom name,
+        const unsigned char* data, size_t count, int format) {
+    property_reply header;
+    header.found = (data != NULL) ? 1 : 0;
+    header.format = format;
+    header.count = count;
+    std::string reply((const char*)&header, sizeof(header));
+    if (data != NULL) {
+        reply.append((const char*)data, count * item_size(format));
+    }
+    save(key(disp, CALL_PROPERTY, win, type, name), reply.data(), reply.size());
+}
+
+Display* RecordingBackend::Open(const char* name) {
+    Display* disp = real->Open(name);
+    if (disp != NULL) {
+        // so that replies which mention the root make sense when replayed
+        uint64_t root = DefaultRootWindow(disp);
+        save(key(NULL, CALL_ROOT, 0), &root, sizeof(root));
+    }
+    return disp;
+}
+
+void RecordingBackend::Close(Display* disp) {
+    real->Close(disp);
+}
+
+void RecordingBackend::Flush(Display* disp) {
+    real->Flush(disp);
+}
+
+Atom RecordingBackend::InternAtom(Display* disp, const char* name) {
+    Atom atom = real->InternAtom(disp, name);
+    uint64_t val = atom;
+    save(key(disp, CALL_ATOM, 0, 0, 0, name), &val, sizeof(val));
+    return atom;
+}
+
+bool RecordingBackend::AtomName(Display* disp, Atom atom, std::string& out) {
+    // only used for debug output, which doesn't change what commands do
+    return real->AtomName(disp, atom, out);
+}
+
+unsigned char* RecordingBackend::GetProperty(Display* disp, Window win,
+        Atom type, Atom name, size_t* out_count, int* out_format) {
+    unsigned char* ret = real->GetProperty(disp, win, type, name, out_count, out_format);
+    save_property(disp, win, type, name, ret, *out_count, *out_format);
+    return ret;
+}
+
+bool RecordingBackend::GetValues(Display* disp, Window win, Atom type, Atom name,
+        unsigned long* out, size_t capacity, size_t* out_count) {
+    bool found = real->GetValues(disp, win, type, name, out, capacity, out_count);
+    save_property(disp, win, type, name,
+            found ? (const unsigned char*)out : NULL, found ? *out_count : 0, 32);
+    return found;
+}
+
+void RecordingBackend::GetProperties(Display* disp, const Window* wins, size_t count,
+        Atom type, Atom name, prop_list_t& out) {
+    real->GetProperties(disp, wins, count, type, name, out);
+    for (size_t i = 0; i < count; ++i) {
+        save_property(disp, wins[i], type, name, out[i].data, out[i].count, out[i].format);
+    }
+}
+
+void RecordingBackend::GetWindowProperties(Display* disp, Window win, const Atom* types,
+        const Atom* names, size_t count, prop_list_t& out) {
+    real->GetWindowProperties(disp, win, types, names, count, out);
+    for (size_t i = 0; i < count; ++i) {
+        save_property(disp, win, types[i], names[i], out[i].data, out[i].count, out[i].format);
+    }
+}
+
+void RecordingBackend::SetProperty(Display* disp, Window win,
+        Atom type, Atom name, const unsigned long* values, size_t count) {
+    real->SetProperty(disp, win, type, name, values, count);
+}
+
+Status RecordingBackend::GetGeometry(Display* disp, Window win, Window* out_root,
+        int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+        unsigned int* out_border, unsigned int* out_depth) {
+    Status status = real->GetGeometry(disp, win, out_root, out_x, out_y,
+            out_width, out_height, out_border, out_depth);
+    geometry_reply reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.status = status;
+    if (status != 0) {
+        reply.root = *out_root;
+        reply.x = *out_x;
+        reply.y = *out_y;
+        reply.width = *out_width;
+        reply.height = *out_height;
+        reply.border = *out_border;
+        reply.depth = *out_depth;
+    }
+    save(key(disp, CALL_GEOMETRY, win), &reply, sizeof(reply));
+    return status;
+}
+
+Status RecordingBackend::QueryTree(Display* disp, Window win, Window* out_root,
+        Window* out_parent, Window** out_children, unsigned int* out_children_count) {
+    Status status = real->QueryTree(disp, win, out_root, out_parent,
+            out_children, out_children_count);
+    tree_reply reply;
+    reply.status = status;
+    reply.root = (status != 0) ? *out_root : 0;
+    reply.parent = (status != 0) ? *out_parent : 0;
+    reply.children_count = (status != 0) ? *out_children_count : 0;
+    std::string data((const char*)&reply, sizeof(reply));
+    for (uint32_t i = 0; i < reply.children_count; ++i) {
+        uint64_t child = (*out_children)[i];
+        data.append((const char*)&child, sizeof(child));
+    }
+    save(key(disp, CALL_TREE, win), data.data(), data.size());
+    return status;
+}
+
+bool RecordingBackend::QueryScreens(Display* disp, dim_list_t& out) {
+    // recorded as the raw list, which is empty if the screens weren't known
+    bool ok = real->QueryScreens(disp, out);
+    if (ok && !out.empty()) {
+        save(key(disp, CALL_SCREENS, 0), &out[0], out.size() * sizeof(Dimensions));
+    } else {
+        save(key(disp, CALL_SCREENS, 0), "", 0);
+    }
+    return ok;
+}
+
+bool RecordingBackend::SendMessage(Display* disp, Window win, Atom type, const long data[5]) {
+    return real->SendMessage(disp, win, type, data);
+}
+
+bool RecordingBackend::MoveResize(Display* disp, Window win,
+        long x, long y, unsigned long width, unsigned long height) {
+    return real->MoveResize(disp, win, x, y, width, height);
+}
+
+void RecordingBackend::BeginErrorTrap(Display* disp) {
+    real->BeginErrorTrap(disp);
+}
+
+bool RecordingBackend::EndErrorTrap(Display* disp) {
+    return real->EndErrorTrap(disp);
+}
+
+bool ReplayBackend::Read(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        ERROR("unable to open %s: %s", path, strerror(errno));
+        return false;
+    }
+    std::string in;
+    char buf[4096];
+    size_t got;
+    while ((got = fread(buf, 1, sizeof(buf), file)) > 0) {
+        in.append(buf, got);
+    }
+    fclose(file);
+
+    size_t pos = 0;
+    uint32_t magic, version, count;
+    if (!read_u32(in, pos, magic) || !read_u32(in, pos, version) ||
+            !read_u32(in, pos, count) ||
+            magic != RECORDING_MAGIC || version != RECORDING_VERSION) {
+        ERROR("%s isn't a gridmgr recording", path);
+        return false;
+    }
+    replies.clear();
+    next_atom = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string key, reply;
+        if (!read_str(in, pos, key) || !read_str(in, pos, reply)) {
+            ERROR("%s is truncated", path);
+            replies.clear();
+            return false;
+        }
+        uint64_t call, atom;
+        if (key.size() >= sizeof(call)) {
+            memcpy(&call, key.data(), sizeof(call));
+            if (call == CALL_ATOM && read_u64(&reply, atom)) {
+                next_atom = std::max(next_atom, (Atom)atom + 1);
+            }
+        }
+        replies[key].swap(reply);
+    }
+    DEBUG("replaying %lu replies from %s", replies.size(), path);
+    return true;
+}
+
+const std::string* ReplayBackend::find(const std::string& key) const {
+    reply_map_t::const_iterator iter = replies.find(key);
+    if (iter == replies.end()) {
+        DEBUG("request %lu wasn't recorded", (unsigned long)key[0]);
+        return NULL;
+    }
+    return &iter->second;
+}
+
+Display* ReplayBackend::Open(const char* /*name*/) {
+    uint64_t root;
+    if (!read_u64(find(key(NULL, CALL_ROOT, 0)), root)) {
+        root = DEFAULT_ROOT;
+    }
+    // the screen size isn't used: monitors come from the recording
+    return OpenStub(root, 0, 0);
+}
+
+void ReplayBackend::Close(Display* disp) {
+    CloseStub(disp);
+}
+
+void ReplayBackend::Flush(Display* /*disp*/) {
+    // nothing is queued
+}
+
+Atom ReplayBackend::InternAtom(Display* disp, const char* name) {
+    CountRequest(disp);
+    // the recorded values, which recorded properties refer to
+    uint64_t atom;
+    if (read_u64(find(key(disp, CALL_ATOM, 0, 0, 0, name)), atom)) {
+        return atom;
+    }
+    std::map<std::string, Atom>::const_iterator iter = made_up_atoms.find(name);
+    if (iter != made_up_atoms.end()) {
+        return iter->second;
+    }
+    made_up_atoms[name] = next_atom;
+    return next_atom++;
+}
+
+bool ReplayBackend::AtomName(Display* /*disp*/, Atom /*atom*/, std::string& /*out*/) {
+    // not recorded
+    return false;
+}
+
+unsigned char* ReplayBackend::GetProperty(Display* disp, Window win,
+        Atom type, Atom name, size_t* out_count, int* out_format) {
+    CountRequest(disp);
+    *out_count = 0;
+    *out_format = 0;
+    const std::string* reply = find(key(disp, CALL_PROPERTY, win, type, name));
+    property_reply header;
+    if (reply == NULL || reply->size() < sizeof(header)) {
+        return NULL;
+    }
+    memcpy(&header, reply->data(), sizeof(header));
+    if (!header.found) {
+        return NULL;
+    }
+    size_t len = reply->size() - sizeof(header);
+    // like Xlib, allocate an extra byte so that strings are terminated
+    unsigned char* ret = (unsigned char*)malloc(len + 1);
+    memcpy(ret, reply->data() + sizeof(header), len);
+    ret[len] = 0;
+    *out_count = header.count;
+    *out_format = header.format;
+    return ret;
+}
+
+bool ReplayBackend::GetValues(Display* disp, Window win, Atom type, Atom name,
+        unsigned long* out, size_t capacity, size_t* out_count) {
+    size_t count;
+    int format;
+    unsigned long* values = (unsigned long*)GetProperty(disp, win, type, name,
+            &count, &format);
+    if (values == NULL) {
+        return false;
+    }
+    bool ok = format == 32;
+    if (ok) {
+        *out_count = std::min(count, capacity);
+        memcpy(out, values, *out_count * sizeof(unsigned long));
+    }
+    free(values);
+    return ok;
+}
+
+void ReplayBackend::GetProperties(Display* disp, const Window* wins, size_t count,
+        Atom type, Atom name, prop_list_t& out) {
+    // recorded one window at a time, either way
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        out[i].data = GetProperty(disp, wins[i], type, name, &out[i].count, &out[i].format);
+    }
+}
+
+void ReplayBackend::GetWindowProperties(Display* disp, Window win, const Atom* types,
+        const Atom* names, size_t count, prop_list_t& out) {
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        out[i].data = GetProperty(disp, win, types[i], names[i], &out[i].count, &out[i].format);
+    }
+}
+
+void ReplayBackend::SetProperty(Display* disp, Window win,
+        Atom /*type*/, Atom /*name*/, const unsigned long* /*values*/, size_t count) {
+    CountRequest(disp);
+    DEBUG("dropping %lu values for window %lu", count, win);
+}
+
+Status ReplayBackend::GetGeometry(Display* disp, Window win, Window* out_root,
+        int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+        unsigned int* out_border, unsigned int* out_depth) {
+    CountRequest(disp);
+    const std::string* recorded = find(key(disp, CALL_GEOMETRY, win));
+    geometry_reply reply;
+    if (recorded == NULL || recorded->size() != sizeof(reply)) {
+        return 0;
+    }
+    memcpy(&reply, recorded->data(), sizeof(reply));
+    *out_root = reply.root;
+    *out_x = reply.x;
+    *out_y = reply.y;
+    *out_width = reply.width;
+    *out_height = reply.height;
+    *out_border = reply.border;
+    *out_depth = reply.depth;
+    return reply.status;
+}
+
+Status ReplayBackend::QueryTree(Display* disp, Window win, Window* out_root,
+        Window* out_parent, Window** out_children, unsigned int* out_children_count) {
+    CountRequest(disp);
+    const std::string* recorded = find(key(disp, CALL_TREE, win));
+    tree_reply reply;
+    if (recorded == NULL || recorded->size() < sizeof(reply)) {
+        return 0;
+    }
+    memcpy(&reply, recorded->data(), sizeof(reply));
+    if (recorded->size() != sizeof(reply) + reply.children_count * sizeof(uint64_t)) {
+        return 0;
+    }
+    *out_root = reply.root;
+    *out_parent = reply.parent;
+    *out_children_count = reply.children_count;
+    *out_children = NULL;
+    if (reply.children_count > 0) {
+        *out_children = (Window*)malloc(reply.children_count * sizeof(Window));
+        for (uint32_t i = 0; i < reply.children_count; ++i) {
+            uint64_t child;
+            memcpy(&child, recorded->data() + sizeof(reply) + i * sizeof(child),
+                    sizeof(child));
+            (*out_children)[i] = child;
+        }
+    }
+    return reply.status;
+}
+
+bool ReplayBackend::QueryScreens(Display* disp, dim_list_t& out) {
+    CountRequest(disp);
+    const std::string* reply = find(key(disp, CALL_SCREENS, 0));
+    if (reply == NULL || reply->empty() || reply->size() % sizeof(Dimensions) != 0) {
+        return false;
+    }
+    out.resize(reply->size() / sizeof(Dimensions));
+    memcpy(&out[0], reply->data(), reply->size());
+    return true;
+}
+
+bool ReplayBackend::SendMessage(Display* disp, Window win, Atom type, const long /*data*/[5]) {
+    CountRequest(disp);
+    DEBUG("dropping message %lu for window %lu", type, win);
+    return true;
+}
+
+bool ReplayBackend::MoveResize(Display* disp, Window win,
+        long x, long y, unsigned long width, unsigned long height) {
+    CountRequest(disp);
+    DEBUG("dropping move of window %lu to %ldx %ldy %luw %luh", win, x, y, width, height);
+    return true;
+}
+
+void ReplayBackend::BeginErrorTrap(Display* /*disp*/) {
+}
+
+bool ReplayBackend::EndErrorTrap(Display* /*disp*/) {
+    // requests for windows which weren't recorded fail without an error
+    return false;
+}
@@ -0,0 +1,146 @@
+#ifndef GRIDMGR_BACKEND_REPLAY_H
+#define GRIDMGR_BACKEND_REPLAY_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <string>
+
+#include "backend.h"
+
+/* Record and replay the replies to the X queries which a command makes, so
+ * that the same command can later be run against the same desktop without it
+ * being around, or without any X server at all. Covers atoms, properties,
+ * geometry, the window tree, and the monitor list.
+ *
+ * Replies are keyed by the request, with the root window stored as 0 so that
+ * recordings replay against any display. The file is in native byte order. */
+
+/* Passes everything through to another backend, saving the replies to a file
+ * at exit. */
+class RecordingBackend : public Backend {
+public:
+    /* 'real' isn't deleted. */
+    RecordingBackend(Backend* real) : real(real) { }
+    virtual ~RecordingBackend() { }
+
+    /* Arranges for the recording to be written to 'path' at exit. Only one
+     * RecordingBackend may do so, and it must then last until exit.
+     * Returns false if 'path' can't be written to. */
+    bool WriteAtExit(const char* path);
+
+    Display* Open(const char* name);
+    void Close(Display* disp);
+    void Flush(Display* disp);
+
+    Atom InternAtom(Display* disp, const char* name);
+    bool AtomName(Display* disp, Atom atom, std::string& out);
+
+    unsigned char* GetProperty(Display* disp, Window win,
+            Atom type, Atom name, size_t* out_count, int* out_format);
+    bool GetValues(Display* disp, Window win, Atom type, Atom name,
+            unsigned long* out, size_t capacity, size_t* out_count);
+    void GetProperties(Display* disp, const Window* wins, size_t count,
+            Atom type, Atom name, prop_list_t& out);
+    void GetWindowProperties(Display* disp, Window win, const Atom* types,
+            const Atom* names, size_t count, prop_list_t& out);
+    void SetProperty(Display* disp, Window win,
+            Atom type, Atom name, const unsigned long* values, size_t count);
+
+    Status GetGeometry(Display* disp, Window win, Window* out_root,
+            int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+            unsigned int* out_border, unsigned int* out_depth);
+    Status QueryTree(Display* disp, Window win, Window* out_root, Window* out_parent,
+            Window** out_children, unsigned int* out_children_count);
+    bool QueryScreens(Display* disp, dim_list_t& out);
+
+    bool SendMessage(Display* disp, Window win, Atom type, const long data[5]);
+    bool MoveResize(Display* disp, Window win,
+            long x, long y, unsigned long width, unsigned long height);
+
+    void BeginErrorTrap(Display* disp);
+    bool EndErrorTrap(Display* disp);
+
+private:
+    /* Only the first reply to each request is kept. */
+    void save(const std::string& key, const void* reply, size_t len);
+    void save_property(Display* disp, Window win, Atom type, Atom name,
+            const unsigned char* data, size_t count, int format);
+    static void write_at_exit();
+
+    Backend* real;
+    std::map<std::string, std::string> replies;
+    std::string path;
+};
+
+/* Answers queries from a recording, with no X server involved. Anything sent
+ * to the display (moves, messages, property changes) is dropped, as it would
+ * have gone to windows which don't exist here anyway. */
+class ReplayBackend : public Backend {
+public:
+    ReplayBackend() : next_atom(0) { }
+    virtual ~ReplayBackend() { }
+
+    /* Loads the recording at 'path'. Returns false if it can't be read. */
+    bool Read(const char* path);
+
+    Display* Open(const char* name);
+    void Close(Display* disp);
+    void Flush(Display* disp);
+
+    Atom InternAtom(Display* disp, const char* name);
+    bool AtomName(Display* disp, Atom atom, std::string& out);
+
+    unsigned char* GetProperty(Display* disp, Window win,
+            Atom type, Atom name, size_t* out_count, int* out_format);
+    bool GetValues(Display* disp, Window win, Atom type, Atom name,
+            unsigned long* out, size_t capacity, size_t* out_count);
+    void GetProperties(Display* disp, const Window* wins, size_t count,
+            Atom type, Atom name, prop_list_t& out);
+    void GetWindowProperties(Display* disp, Window win, const Atom* types,
+            const Atom* names, size_t count, prop_list_t& out);
+    void SetProperty(Display* disp, Window win,
+            Atom type, Atom name, const unsigned long* values, size_t count);
+
+    Status GetGeometry(Display* disp, Window win, Window* out_root,
+            int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+            unsigned int* out_border, unsigned int* out_depth);
+    Status QueryTree(Display* disp, Window win, Window* out_root, Window* out_parent,
+            Window** out_children, unsigned int* out_children_count);
+    bool QueryScreens(Display* disp, dim_list_t& out);
+
+    bool SendMessage(Display* disp, Window win, Atom type, const long data[5]);
+    bool MoveResize(Display* disp, Window win,
+            long x, long y, unsigned long width, unsigned long height);
+
+    void BeginErrorTrap(Display* disp);
+    bool EndErrorTrap(Display* disp);
+
+private:
+    /* Returns the recorded reply, or NULL if the request wasn't recorded. */
+    const std::string* find(const std::string& key) const;
+
+    std::map<std::string, std::string> replies;
+    /* Atoms which weren't recorded are made up, starting after the highest
+     * one that was. */
+    std::map<std::string, Atom> made_up_atoms;
+    Atom next_atom;
+};
+
+#endif
@@ -0,0 +1,390 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2011-2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "backend-xlib.h"
+#include "config.h"
+#include "stats.h"
+
+// for GetProperties(). last, since it defines min() and max() macros
+#include <X11/Xlibint.h>
+
+#ifdef USE_XINERAMA
+#include <X11/extensions/Xinerama.h>
+#endif
+
+#define MAX_PROPERTY_VALUE_LEN 4096
+
+namespace {
+    /* Bytes per value in what's returned, the same as XGetWindowProperty():
+       format 32 values are expanded to longs. */
+    size_t value_size(int format) {
+        switch (format) {
+        case 8:
+            return 1;
+        case 16:
+            return sizeof(short);
+        case 32:
+            return sizeof(long);
+        default:
+            return 0;
+        }
+    }
+
+    /* Reads the value which follows 'rep', as the reply to the latest request. */
+    void read_property(Display* disp, const xGetPropertyReply& rep, Atom type,
+            PropertyReply& out) {
+        size_t size = value_size(rep.format);
+        if (rep.propertyType != type || size == 0) {
+            // missing or of another type: no value was sent
+            _XEatDataWords(disp, rep.length);
+            return;
+        }
+        out.data = (unsigned char*)Xmalloc(rep.nItems * size + 1);
+        if (out.data == NULL) {
+            ERROR("unable to read property of %lu bytes", rep.nItems * size);
+            _XEatDataWords(disp, rep.length);
+            return;
+        }
+        switch (rep.format) {
+        case 8:
+            _XReadPad(disp, (char*)out.data, rep.nItems);
+            break;
+        case 16:
+            _XRead16Pad(disp, (short*)out.data, rep.nItems << 1);
+            break;
+        case 32:
+            _XRead32(disp, (long*)out.data, rep.nItems << 2);
+            break;
+        }
+        out.data[rep.nItems * size] = '\0';
+        out.count = rep.nItems;
+        out.format = rep.format;
+    }
+
+    /* One of GetProperties()' requests other than the last, whose reply is
+       read by property_handler() while Xlib waits for the last one. */
+    struct PendingProperty {
+        _XAsyncHandler async;
+        unsigned long seq;
+        Atom type;
+        PropertyReply* reply;
+    };
+
+    Bool property_handler(Display* dpy, xReply* rep, char* buf, int len, XPointer data) {
+        PendingProperty* pending = (PendingProperty*)data;
+        if (dpy->last_request_read != pending->seq) {
+            return False;
+        }
+        if (rep->generic.type == X_Error) {
+            // eg the window is gone. leave it to the error handler
+            return False;
+        }
+
+        xGetPropertyReply replbuf;
+        const xGetPropertyReply* repl = (const xGetPropertyReply*)_XGetAsyncReply(
+                dpy, (char*)&replbuf, rep, buf, len, 0, False);
+        unsigned long nitems = repl->nItems, total = repl->length << 2;
+        int format = repl->format;
+        size_t size = value_size(format);
+        unsigned char* value = NULL;
+        if (repl->propertyType == pending->type && size != 0) {
+            value = (unsigned char*)Xmalloc(nitems * size + 1);
+        }
+        if (value == NULL) {
+            // missing, of another type, or out of memory: skip past it
+            _XGetAsyncData(dpy, NULL, buf, len, SIZEOF(xGetPropertyReply), 0, total);
+            return True;
+        }
+        _XGetAsyncData(dpy, (char*)value, buf, len, SIZEOF(xGetPropertyReply),
+                nitems * (format / 8), total);
+        if (format == 32) {
+            /* widen to longs in place, sign extended like _XRead32(). from the
+               end, so that each value is read before anything is written over it */
+            for (unsigned long i = nitems; i-- > 0; ) {
+                INT32 v = ((const INT32*)value)[i];
+                ((long*)value)[i] = v;
+            }
+        }
+        value[nitems * size] = '\0';
+        pending->reply->data = value;
+        pending->reply->count = nitems;
+        pending->reply->format = format;
+        return True;
+    }
+
+    /* Gets 'count' properties with one round trip. Request i is for
+       wins[i * wins_step], types[i * types_step], names[i * names_step].
+
+       Xlib only waits for the reply to the latest request, so this works like
+       XGetWindowAttributes(): every request is queued, each but the last with
+       an async handler for its reply, and then waiting for the last reply
+       hands each of the earlier ones to its handler on the way. */
+    void get_pipelined(Display* disp, size_t count,
+            const Window* wins, size_t wins_step, const Atom* types, size_t types_step,
+            const Atom* names, size_t names_step, prop_list_t& out) {
+        out.resize(count);
+        if (count == 0) {
+            return;
+        }
+        stats::count(stats::COUNTER_ROUND_TRIPS);
+
+        std::vector<PendingProperty> pending(count - 1);
+        Display* dpy = disp;// GetReq() and SyncHandle() expect 'dpy'
+        LockDisplay(dpy);
+        for (size_t i = 0; i < count; ++i) {
+            out[i].data = NULL;
+            out[i].count = 0;
+            out[i].format = 0;
+
+            xGetPropertyReq* req;
+            GetReq(GetProperty, req);
+            req->window = wins[i * wins_step];
+            req->property = names[i * names_step];
+            req->type = types[i * types_step];
+            req->c_delete = xFalse;
+            req->longOffset = 0;
+            req->longLength = MAX_PROPERTY_VALUE_LEN / 4;
+
+            if (i + 1 < count) {
+                PendingProperty& p = pending[i];
+                p.seq = dpy->request;
+                p.type = types[i * types_step];
+                p.reply = &out[i];
+                p.async.next = dpy->async_handlers;
+                p.async.handler = property_handler;
+                p.async.data = (XPointer)&p;
+                dpy->async_handlers = &p.async;
+            }
+        }
+
+        xGetPropertyReply rep;
+        if (_XReply(dpy, (xReply*)&rep, 0, xFalse)) {
+            read_property(dpy, rep, types[(count - 1) * types_step], out[count - 1]);
+        }// else eg the window is gone. the error handler has already seen it
+
+        for (size_t i = 0; i < pending.size(); ++i) {
+            DeqAsyncHandler(dpy, &pending[i].async);
+        }
+        UnlockDisplay(dpy);
+        SyncHandle();
+    }
+
+    XErrorHandler trapped_handler = NULL;
+    bool trap_hit = false;
+
+    int trap_error(Display* /*disp*/, XErrorEvent* /*event*/) {
+        trap_hit = true;
+        return 0;
+    }
+}
+
+Display* XlibBackend::Open(const char* name) {
+    return XOpenDisplay(name);
+}
+
+void XlibBackend::Close(Display* disp) {
+    XCloseDisplay(disp);
+}
+
+void XlibBackend::Flush(Display* disp) {
+    XFlush(disp);
+}
+
+Atom XlibBackend::InternAtom(Display* disp, const char* name) {
+    stats::count(stats::COUNTER_ROUND_TRIPS);
+    return XInternAtom(disp, name, False);
+}
+
+bool XlibBackend::AtomName(Display* disp, Atom atom, std::string& out) {
+    stats::count(stats::COUNTER_ROUND_TRIPS);
+    char* name = XGetAtomName(disp, atom);
+    if (name == NULL) {
+        return false;
+    }
+    out = name;
+    XFree(name);
+    return true;
+}
+
+unsigned char* XlibBackend::GetProperty(Display *disp, Window win,
+        Atom xa_prop_type, Atom xa_prop_name, size_t* out_count, int* out_format) {
+    Atom xa_ret_type;
+    int ret_format;
+    unsigned long ret_nitems, ret_bytes_after;
+    unsigned char* ret_prop;
+    stats::count(stats::COUNTER_ROUND_TRIPS);
+
+    /* MAX_PROPERTY_VALUE_LEN / 4 explanation (XGetWindowProperty manpage):
+     *
+     * long_length = Specifies the length in 32-bit multiples of the
+     *               data to be retrieved.
+     */
+    if (XGetWindowProperty(disp, win, xa_prop_name, 0, MAX_PROPERTY_VALUE_LEN / 4, false,
+                    xa_prop_type, &xa_ret_type, &ret_format,
+                    &ret_nitems, &ret_bytes_after, &ret_prop) != Success) {
+        std::string name;
+        AtomName(disp, xa_prop_name, name);
+        ERROR("Cannot get property %lu/%s.", xa_prop_name, name.c_str());
+        return NULL;
+    } else if (config::debug_enabled) {
+        // the name is another round trip, only look it up if it's shown
+        std::string name;
+        AtomName(disp, xa_prop_name, name);
+        DEBUG("Property %lu/%s -> %lu items", xa_prop_name, name.c_str(), ret_nitems);
+    }
+
+    if (xa_ret_type != xa_prop_type) {
+        //not necessarily an error if it's None: the window just lacks the requested property
+        if (xa_ret_type != None) {
+            std::string name, req, got;
+            AtomName(disp, xa_prop_name, name);
+            AtomName(disp, xa_prop_type, req);
+            AtomName(disp, xa_ret_type, got);
+            ERROR("Invalid type of property %lu/%s: req %s, got %s",
+                    xa_prop_name, name.c_str(), req.c_str(), got.c_str());
+        }
+        XFree(ret_prop);
+        return NULL;
+    }
+
+    *out_count = ret_nitems;
+    *out_format = ret_format;
+    return ret_prop;
+}
+
+bool XlibBackend::GetValues(Display* disp, Window win, Atom type, Atom name,
+        unsigned long* out, size_t capacity, size_t* out_count) {
+    stats::count(stats::COUNTER_ROUND_TRIPS);
+
+    // XGetWindowProperty() without its allocation, see GetProperties()
+    Display* dpy = disp;
+    LockDisplay(dpy);
+    xGetPropertyReq* req;
+    GetReq(GetProperty, req);
+    req->window = win;
+    req->property = name;
+    req->type = type;
+    req->c_delete = xFalse;
+    req->longOffset = 0;
+    req->longLength = capacity;
+
+    bool ok = false;
+    xGetPropertyReply rep;
+    if (_XReply(dpy, (xReply*)&rep, 0, xFalse)) {
+        if (rep.propertyType == type && rep.format == 32 && rep.nItems <= capacity) {
+            _XRead32(dpy, (long*)out, rep.nItems << 2);
+            *out_count = rep.nItems;
+            ok = true;
+        } else {
+            _XEatDataWords(dpy, rep.length);
+        }
+    }
+    UnlockDisplay(dpy);
+    SyncHandle();
+    return ok;
+}
+
+void XlibBackend::GetProperties(Display* disp, const Window* wins, size_t count,
+        Atom type, Atom name, prop_list_t& out) {
+    get_pipelined(disp, count, wins, 1, &type, 0, &name, 0, out);
+}
+
+void XlibBackend::GetWindowProperties(Display* disp, Window win, const Atom* types,
+        const Atom* names, size_t count, prop_list_t& out) {
+    get_pipelined(disp, count, &win, 0, types, 1, names, 1, out);
+}
+
+void XlibBackend::SetProperty(Display* disp, Window win,
+        Atom type, Atom name, const unsigned long* values, size_t count) {
+    if (count == 0) {
+        XDeleteProperty(disp, win, name);
+    } else {
+        XChangeProperty(disp, win, name, type, 32,
+                PropModeReplace, (const unsigned char*)values, count);
+    }
+}
+
+Status XlibBackend::GetGeometry(Display* disp, Window win, Window* out_root,
+        int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+        unsigned int* out_border, unsigned int* out_depth) {
+    stats::count(stats::COUNTER_ROUND_TRIPS);
+    return XGetGeometry(disp, win, out_root, out_x, out_y,
+            out_width, out_height, out_border, out_depth);
+}
+
+Status XlibBackend::QueryTree(Display* disp, Window win, Window* out_root, Window* out_parent,
+        Window** out_children, unsigned int* out_children_count) {
+    stats::count(stats::COUNTER_ROUND_TRIPS);
+    return XQueryTree(disp, win, out_root, out_parent, out_children, out_children_count);
+}
+
+bool XlibBackend::QueryScreens(Display* disp, dim_list_t& out) {
+#ifdef USE_XINERAMA
+    int screen_count = 0;
+    XineramaScreenInfo* screens = XineramaQueryScreens(disp, &screen_count);
+    if (screens == NULL) {
+        return false;
+    }
+    out.clear();
+    for (int i = 0; i < screen_count; ++i) {
+        out.push_back(Dimensions());
+        Dimensions& d = out.back();
+        d.x = screens[i].x_org;
+        d.y = screens[i].y_org;
+        d.width = screens[i].width;
+        d.height = screens[i].height;
+    }
+    XFree(screens);
+    return !out.empty();
+#else
+    return false;
+#endif
+}
+
+bool XlibBackend::SendMessage(Display* disp, Window win, Atom type, const long data[5]) {
+    XEvent event;
+    long mask = SubstructureRedirectMask | SubstructureNotifyMask;
+
+    event.xclient.type = ClientMessage;
+    event.xclient.serial = 0;
+    event.xclient.send_event = True;
+    event.xclient.message_type = type;
+    event.xclient.window = win;
+    event.xclient.format = 32;
+    for (int i = 0; i < 5; ++i) {
+        event.xclient.data.l[i] = data[i];
+    }
+
+    return XSendEvent(disp, DefaultRootWindow(disp), False, mask, &event) != 0;
+}
+
+bool XlibBackend::MoveResize(Display* disp, Window win,
+        long x, long y, unsigned long width, unsigned long height) {
+    return XMoveResizeWindow(disp, win, x, y, width, height) != 0;
+}
+
+void XlibBackend::BeginErrorTrap(Display* /*disp*/) {
+    trap_hit = false;
+    trapped_handler = XSetErrorHandler(trap_error);
+}
+
+bool XlibBackend::EndErrorTrap(Display* /*disp*/) {
+    XSetErrorHandler(trapped_handler);
+    trapped_handler = NULL;
+    return trap_hit;
+}
@@ -0,0 +1,60 @@
+#ifndef GRIDMGR_BACKEND_XLIB_H
+#define GRIDMGR_BACKEND_XLIB_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "backend.h"
+
+/* The real thing: talks to an X server. */
+class XlibBackend : public Backend {
+public:
+    Display* Open(const char* name);
+    void Close(Display* disp);
+    void Flush(Display* disp);
+
+    Atom InternAtom(Display* disp, const char* name);
+    bool AtomName(Display* disp, Atom atom, std::string& out);
+
+    unsigned char* GetProperty(Display* disp, Window win,
+            Atom type, Atom name, size_t* out_count, int* out_format);
+    bool GetValues(Display* disp, Window win, Atom type, Atom name,
+            unsigned long* out, size_t capacity, size_t* out_count);
+    void GetProperties(Display* disp, const Window* wins, size_t count,
+            Atom type, Atom name, prop_list_t& out);
+    void GetWindowProperties(Display* disp, Window win, const Atom* types,
+            const Atom* names, size_t count, prop_list_t& out);
+    void SetProperty(Display* disp, Window win,
+            Atom type, Atom name, const unsigned long* values, size_t count);
+
+    Status GetGeometry(Display* disp, Window win, Window* out_root,
+            int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+            unsigned int* out_border, unsigned int* out_depth);
+    Status QueryTree(Display* disp, Window win, Window* out_root, Window* out_parent,
+            Window** out_children, unsigned int* out_children_count);
+    bool QueryScreens(Display* disp, dim_list_t& out);
+
+    bool SendMessage(Display* disp, Window win, Atom type, const long data[5]);
+    bool MoveResize(Display* disp, Window win,
+            long x, long y, unsigned long width, unsigned long height);
+
+    void BeginErrorTrap(Display* disp);
+    bool EndErrorTrap(Display* disp);
+};
+
+#endif
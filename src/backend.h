@@ -0,0 +1,136 @@
+#ifndef GRIDMGR_BACKEND_H
+#define GRIDMGR_BACKEND_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <X11/Xlib.h>
+
+#include "dimensions.h"
+
+typedef std::vector<Dimensions> dim_list_t;
+
+/* One window's answer to GetProperties(), as if from GetProperty(). */
+struct PropertyReply {
+    unsigned char* data;// NULL if the window lacks the property
+    size_t count;
+    int format;
+};
+typedef std::vector<PropertyReply> prop_list_t;
+
+/* Everything that commands ask of the display, so that they can be run
+ * against something other than an X server (see backend-fake.h and
+ * backend-replay.h). Commands don't use this directly, they go through
+ * x11_util.
+ *
+ * The Display returned by Open() supports DefaultRootWindow() and
+ * NextRequest(), but nothing else should be done with it outside of the
+ * backend. Memory returned by a backend is freed with XFree(). */
+class Backend {
+public:
+    virtual ~Backend() { }
+
+    /* Opens the named display (or $DISPLAY if NULL). Returns NULL if it
+     * couldn't be opened. */
+    virtual Display* Open(const char* name) = 0;
+    /* Flushes anything that's queued. */
+    virtual void Close(Display* disp) = 0;
+    /* Sends anything that's queued, without closing. */
+    virtual void Flush(Display* disp) = 0;
+
+    virtual Atom InternAtom(Display* disp, const char* name) = 0;
+    /* Returns false if the atom is unknown. */
+    virtual bool AtomName(Display* disp, Atom atom, std::string& out) = 0;
+
+    /* Returns NULL if the window lacks the property, or if it's of another
+     * type. The result has an extra nul at the end. */
+    virtual unsigned char* GetProperty(Display* disp, Window win,
+            Atom type, Atom name, size_t* out_count, int* out_format) = 0;
+    /* Like GetProperty() for a format-32 property, but copies up to
+     * 'capacity' values into 'out' rather than allocating. Returns false if
+     * the window lacks the property, or if it's of another type or format. */
+    virtual bool GetValues(Display* disp, Window win, Atom type, Atom name,
+            unsigned long* out, size_t capacity, size_t* out_count) = 0;
+    /* Gets the same property from each of 'wins', sending every request
+     * before waiting for any of the replies, so that a whole list of windows
+     * costs one round trip rather than one per window. 'out' gets a reply
+     * for each window, in the same order. */
+    virtual void GetProperties(Display* disp, const Window* wins, size_t count,
+            Atom type, Atom name, prop_list_t& out) = 0;
+    /* Like GetProperties(), but gets several properties of a single window,
+     * each with its own type. */
+    virtual void GetWindowProperties(Display* disp, Window win, const Atom* types,
+            const Atom* names, size_t count, prop_list_t& out) = 0;
+    /* Replaces the property with 'count' format-32 values, or deletes it if
+     * 'count' is 0. */
+    virtual void SetProperty(Display* disp, Window win,
+            Atom type, Atom name, const unsigned long* values, size_t count) = 0;
+
+    virtual Status GetGeometry(Display* disp, Window win, Window* out_root,
+            int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+            unsigned int* out_border, unsigned int* out_depth) = 0;
+    virtual Status QueryTree(Display* disp, Window win, Window* out_root, Window* out_parent,
+            Window** out_children, unsigned int* out_children_count) = 0;
+    /* Gets the area of each monitor. Returns false if they aren't known,
+     * leaving the caller to fall back to the EWMH workarea. */
+    virtual bool QueryScreens(Display* disp, dim_list_t& out) = 0;
+
+    /* Sends a format-32 client message about 'win' to the window manager. */
+    virtual bool SendMessage(Display* disp, Window win, Atom type, const long data[5]) = 0;
+    /* Asks for the window's frame to be moved to 'x','y', and for the window
+     * itself to be resized to 'width','height'. */
+    virtual bool MoveResize(Display* disp, Window win,
+            long x, long y, unsigned long width, unsigned long height) = 0;
+
+    /* Between these, errors from requests which wait for a reply (eg asking
+     * about a window which has since been destroyed) are swallowed rather
+     * than ending the process. EndErrorTrap() returns whether there were
+     * any. Only for single commands: the daemon ignores errors anyway. */
+    virtual void BeginErrorTrap(Display* disp) = 0;
+    virtual bool EndErrorTrap(Display* disp) = 0;
+
+protected:
+    /* For backends without an X server: just enough of a Display for
+     * DefaultRootWindow() and NextRequest(), freed with CloseStub(). */
+    static Display* OpenStub(Window root, unsigned int width, unsigned int height) {
+        _XPrivDisplay disp = (_XPrivDisplay)calloc(1, sizeof(*disp));
+        Screen* screen = (Screen*)calloc(1, sizeof(Screen));
+        screen->display = (Display*)disp;
+        screen->root = root;
+        screen->width = width;
+        screen->height = height;
+        disp->screens = screen;
+        disp->nscreens = 1;
+        disp->default_screen = 0;
+        disp->request = 1;
+        return (Display*)disp;
+    }
+    static void CloseStub(Display* disp) {
+        free(((_XPrivDisplay)disp)->screens);
+        free(disp);
+    }
+    /* Counts a request on a stub, as seen by NextRequest() and the probes. */
+    static void CountRequest(Display* disp) {
+        ++((_XPrivDisplay)disp)->request;
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <X11/Xlib.h>
+
+#include "alloc-count.h"
+#include "batch.h"
+#include "command.h"
+#include "config.h"
+#include "desktop.h"
+#include "grid.h"
+#include "predict.h"
+#include "window.h"
+#include "x11-util.h"
+
+#define LINE_MAX_LEN 1024 // arbitrarily large
+
+namespace {
+    /* Parses a line into 'cmd'. Returns false if it's invalid, or sets 'empty'
+       if there's nothing on it. */
+    bool parse_line(char* line, Command& cmd, bool& empty) {
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        empty = true;
+        char* save;
+        for (char* arg = strtok_r(line, " \t\r\n", &save); arg != NULL;
+             arg = strtok_r(NULL, " \t\r\n", &save)) {
+            if (!command::parse_arg(arg, cmd)) {
+                return false;
+            }
+            empty = false;
+        }
+        return true;
+    }
+
+    bool run_cmd(Display* disp, DesktopSnapshot& snapshot, const Command& cmd) {
+        // activate window (if specified)
+        if (cmd.window == grid::POS_STACK) {
+            const WindowInfo* info = snapshot.active_info();
+            Window next;
+            if (info == NULL || !occupancy::stack_next(snapshot, *info, next)) {
+                LOG("No other windows share this window's cell.");
+                return false;
+            }
+            if (!window::activate(disp, snapshot.active, next)) {
+                return false;
+            }
+            snapshot.active = next;
+        } else if (cmd.window != grid::POS_CURRENT) {
+            Window next;
+            if (!desktop::neighbor(snapshot, snapshot.active, cmd.window, next)) {
+                ERROR("unable to get list of windows");
+                return false;
+            }
+            if (!window::activate(disp, snapshot.active, next)) {
+                return false;
+            }
+            /* don't wait for the WM to get around to it: later commands in the
+               batch apply to this window regardless */
+            snapshot.active = next;
+        }
+
+        // move window (if specified)
+        if (cmd.monitor != grid::POS_CURRENT || cmd.gridpos != grid::POS_CURRENT) {
+            return grid::set_position_cached(disp, snapshot,
+                    grid::pos_list_t(1, cmd.gridpos), cmd.monitor);
+        }
+        return true;
+    }
+}
+
+bool batch::run(FILE* in) {
+    Display* disp = x11_util::open_display();
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+
+    // the only round trips: everything after this is sent without waiting
+    DesktopSnapshot snapshot;
+    if (!desktop::fetch_classified(disp, snapshot)) {
+        x11_util::close_display(disp);
+        return false;
+    }
+
+    bool ok = true;
+    size_t line_num = 0, cmd_count = 0;
+    char line[LINE_MAX_LEN];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        ++line_num;
+        Command cmd;
+        bool empty;
+        if (!parse_line(line, cmd, empty)) {
+            ERROR("skipping invalid line %lu", line_num);
+            ok = false;
+            continue;
+        }
+        if (empty) {
+            continue;
+        }
+        ++cmd_count;
+        if (!run_cmd(disp, snapshot, cmd)) {
+            ERROR("command on line %lu failed", line_num);
+            ok = false;
+        }
+    }
+    if (ferror(in)) {
+        ERROR("error reading commands after line %lu", line_num);
+        ok = false;
+    }
+
+    DEBUG("ran %lu commands from %lu lines", cmd_count, line_num);
+    x11_util::close_display(disp);// flushes everything that's queued
+    return ok;
+}
+
+#ifdef COUNT_ALLOCS
+bool batch::check_allocs(FILE* in) {
+    cmd_list_t keys;
+    size_t line_num = 0;
+    char line[LINE_MAX_LEN];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        ++line_num;
+        Command cmd;
+        bool empty;
+        if (!parse_line(line, cmd, empty)) {
+            ERROR("invalid line %lu", line_num);
+            return false;
+        }
+        if (!empty) {
+            keys.push_back(cmd);
+        }
+    }
+    if (ferror(in) || keys.empty()) {
+        ERROR("no commands to check after line %lu", line_num);
+        return false;
+    }
+
+    Display* disp = x11_util::open_display();
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+    // commands find the display the same way they do in the daemon
+    x11_util::set_thread_connection(disp);
+
+    /* the first pass fills the buffers and statics which the daemon keeps
+       between commands. the second should find them all in place */
+    bool ok = true;
+    DesktopSnapshot snapshot;
+    cmd_list_t cmds(1);
+    std::vector<bool> results;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            // what the daemon's event thread would have published by now
+            if (!desktop::fetch_classified(disp, snapshot)) {
+                ok = false;
+                break;
+            }
+            predict::compute(snapshot);
+            ++snapshot.generation;
+
+            cmds[0] = keys[i];
+            unsigned long before = alloc_count::get();
+            command::run(cmds, results, &snapshot);
+            unsigned long allocs = alloc_count::get() - before;
+            if (pass > 0 && allocs != 0) {
+                ERROR("command %lu allocated %lu times after warming up", i + 1, allocs);
+                ok = false;
+            }
+        }
+    }
+    if (ok) {
+        LOG("%lu commands ran without allocating", keys.size());
+    }
+
+    x11_util::set_thread_connection(NULL);
+    x11_util::close_display(disp);
+    return ok;
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef GRIDMGR_BATCH_H
+#define GRIDMGR_BATCH_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+
+#include "config.h"
+
+namespace batch {
+    /* Runs commands read from 'in', one per line, in the same format as the
+     * command line (eg "wright gleft"). Blank lines and anything following a
+     * '#' are ignored. All commands share a single connection and a single
+     * fetch of the windows/viewports, which is updated in place as commands
+     * are applied. Returns true if every command succeeded, else false. */
+    bool run(FILE* in);
+
+#ifdef COUNT_ALLOCS
+    /* Runs the commands read from 'in' (as with run()) one at a time the way
+     * the daemon does, against a freshly fetched snapshot each, then runs them
+     * all again. Returns false if any of them allocated the second time. */
+    bool check_allocs(FILE* in);
+#endif
+}
+
+#endif
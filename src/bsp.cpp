@@ -0,0 +1,331 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bsp.h"
+#include "core-hooks.h"
+
+#define BSP_MAGIC 0x47524d42 // "GRMB"
+#define BSP_VERSION 1
+#define HEADER_LEN 8
+#define NODE_LEN 11
+
+namespace {
+    // stored as CARDINAL, so positions which may be negative go through int32
+    long to_signed(unsigned long val) {
+        return (long)(int)(val & 0xffffffff);
+    }
+}
+
+BspTree::BspTree() : root(NONE) {
+    area.x = area.y = 0;
+    area.width = area.height = 0;
+}
+
+void BspTree::SetArea(const Dimensions& new_area, change_list_t& changes) {
+    area = new_area;
+    if (root != NONE) {
+        layout(root, area, changes);
+    }
+}
+
+bool BspTree::Contains(unsigned long window) const {
+    return leaves.find(window) != leaves.end();
+}
+
+void BspTree::Windows(std::vector<unsigned long>& out) const {
+    out.clear();
+    for (std::map<unsigned long, size_t>::const_iterator iter = leaves.begin();
+         iter != leaves.end(); ++iter) {
+        out.push_back(iter->first);
+    }
+}
+
+unsigned long BspTree::WindowNear(long x, long y) const {
+    if (root == NONE) {
+        return 0;
+    }
+    // walk down towards the point, like any other tree lookup
+    size_t node = root;
+    while (nodes[node].window == 0) {
+        const Dimensions& first = nodes[nodes[node].first].dim;
+        bool in_first = (nodes[node].split == SPLIT_HORIZONTAL) ?
+            x < first.x + (long)first.width : y < first.y + (long)first.height;
+        node = in_first ? nodes[node].first : nodes[node].second;
+    }
+    const Dimensions& dim = nodes[node].dim;
+    if (x >= dim.x && x < dim.x + (long)dim.width &&
+            y >= dim.y && y < dim.y + (long)dim.height) {
+        return nodes[node].window;
+    }
+
+    // point is outside the area entirely
+    unsigned long largest = 0, largest_area = 0;
+    for (std::map<unsigned long, size_t>::const_iterator iter = leaves.begin();
+         iter != leaves.end(); ++iter) {
+        const Dimensions& leaf = nodes[iter->second].dim;
+        if (largest == 0 || leaf.width * leaf.height > largest_area) {
+            largest = iter->first;
+            largest_area = leaf.width * leaf.height;
+        }
+    }
+    return largest;
+}
+
+bool BspTree::Insert(unsigned long window, unsigned long at, SPLIT split,
+        change_list_t& changes) {
+    if (window == 0 || Contains(window)) {
+        return false;
+    }
+    if (root == NONE) {
+        root = alloc();
+        nodes[root].window = window;
+        leaves[window] = root;
+        layout(root, area, changes);
+        return true;
+    }
+
+    std::map<unsigned long, size_t>::const_iterator iter = leaves.find(at);
+    if (iter == leaves.end()) {
+        return false;
+    }
+    /* the leaf for 'at' becomes the parent of two new leaves. allocate first,
+       since that may move the nodes around */
+    size_t parent = iter->second, first = alloc(), second = alloc();
+    Node& node = nodes[parent];
+    if (split == SPLIT_AUTO) {
+        split = (node.dim.width >= node.dim.height) ? SPLIT_HORIZONTAL : SPLIT_VERTICAL;
+    }
+    node.split = split;
+    node.ratio = 500;
+    node.first = first;
+    node.second = second;
+
+    // 'at' keeps its old dimensions for now, so that only real changes are reported
+    nodes[first].parent = parent;
+    nodes[first].window = node.window;
+    nodes[first].dim = node.dim;
+    leaves[node.window] = first;
+
+    nodes[second].parent = parent;
+    nodes[second].window = window;
+    leaves[window] = second;
+    node.window = 0;
+
+    layout(parent, node.dim, changes);
+    return true;
+}
+
+bool BspTree::Remove(unsigned long window, change_list_t& changes) {
+    std::map<unsigned long, size_t>::iterator iter = leaves.find(window);
+    if (iter == leaves.end()) {
+        return false;
+    }
+    size_t leaf = iter->second, parent = nodes[leaf].parent;
+    leaves.erase(iter);
+    release(leaf);
+    if (parent == NONE) {
+        root = NONE;
+        return true;
+    }
+
+    // the sibling's subtree takes the parent's place and area
+    size_t sibling = (nodes[parent].first == leaf) ?
+        nodes[parent].second : nodes[parent].first;
+    size_t grandparent = nodes[parent].parent;
+    Dimensions dim = nodes[parent].dim;
+    nodes[sibling].parent = grandparent;
+    if (grandparent == NONE) {
+        root = sibling;
+    } else if (nodes[grandparent].first == parent) {
+        nodes[grandparent].first = sibling;
+    } else {
+        nodes[grandparent].second = sibling;
+    }
+    release(parent);
+
+    layout(sibling, dim, changes);
+    return true;
+}
+
+size_t BspTree::alloc() {
+    if (!free_nodes.empty()) {
+        size_t node = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[node] = Node();
+        return node;
+    }
+    nodes.push_back(Node());
+    return nodes.size() - 1;
+}
+
+void BspTree::release(size_t node) {
+    nodes[node] = Node();
+    free_nodes.push_back(node);
+}
+
+void BspTree::layout(size_t node, const Dimensions& dim, change_list_t& changes) {
+    Node& n = nodes[node];
+    if (n.window != 0) {
+        if (n.dim != dim) {
+            Change change;
+            change.window = n.window;
+            change.dim = dim;
+            changes.push_back(change);
+        }
+        n.dim = dim;
+        return;
+    }
+    n.dim = dim;
+
+    Dimensions first = dim, second = dim;
+    if (n.split == SPLIT_HORIZONTAL) {
+        first.width = dim.width * n.ratio / 1000;
+        second.x = dim.x + first.width;
+        second.width = dim.width - first.width;
+    } else {
+        first.height = dim.height * n.ratio / 1000;
+        second.y = dim.y + first.height;
+        second.height = dim.height - first.height;
+    }
+    layout(n.first, first, changes);
+    layout(n.second, second, changes);
+}
+
+void BspTree::Serialize(std::vector<unsigned long>& out) const {
+    out.clear();
+    out.reserve(HEADER_LEN + nodes.size() * NODE_LEN);
+    out.push_back(BSP_MAGIC);
+    out.push_back(BSP_VERSION);
+    out.push_back(area.x & 0xffffffff);
+    out.push_back(area.y & 0xffffffff);
+    out.push_back(area.width);
+    out.push_back(area.height);
+    out.push_back(root + 1);// NONE -> 0
+    out.push_back(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const Node& n = nodes[i];
+        out.push_back(n.parent + 1);
+        out.push_back(n.first + 1);
+        out.push_back(n.second + 1);
+        out.push_back(n.split);
+        out.push_back(n.ratio);
+        out.push_back(n.window);
+        out.push_back(n.dim.x & 0xffffffff);
+        out.push_back(n.dim.y & 0xffffffff);
+        out.push_back(n.dim.width);
+        out.push_back(n.dim.height);
+        // whether the node's in use
+        out.push_back((n.window != 0 || n.first != NONE) ? 1 : 0);
+    }
+}
+
+bool BspTree::Deserialize(const unsigned long* values, size_t count) {
+    *this = BspTree();
+    if (count < HEADER_LEN || values[0] != BSP_MAGIC || values[1] != BSP_VERSION) {
+        return false;
+    }
+    size_t node_count = values[7];
+    if (count != HEADER_LEN + node_count * NODE_LEN) {
+        CORE_ERROR("BSP tree has %lu values, expected %lu",
+                count, HEADER_LEN + node_count * NODE_LEN);
+        return false;
+    }
+    area.x = to_signed(values[2]);
+    area.y = to_signed(values[3]);
+    area.width = values[4];
+    area.height = values[5];
+    root = values[6] - 1;
+
+    nodes.resize(node_count);
+    std::vector<bool> in_use(node_count, false);
+    size_t leaf_count = 0;
+    for (size_t i = 0; i < node_count; ++i) {
+        const unsigned long* v = values + HEADER_LEN + i * NODE_LEN;
+        Node& n = nodes[i];
+        n.parent = v[0] - 1;
+        n.first = v[1] - 1;
+        n.second = v[2] - 1;
+        n.split = (v[3] == SPLIT_VERTICAL) ? SPLIT_VERTICAL : SPLIT_HORIZONTAL;
+        n.ratio = (v[4] <= 1000) ? v[4] : 500;
+        n.window = v[5];
+        n.dim.x = to_signed(v[6]);
+        n.dim.y = to_signed(v[7]);
+        n.dim.width = v[8];
+        n.dim.height = v[9];
+        if (v[10] == 0) {
+            free_nodes.push_back(i);
+            continue;
+        }
+        in_use[i] = true;
+        bool leaf = (n.window != 0);
+        if ((n.parent != NONE && n.parent >= node_count) ||
+                (!leaf && (n.first >= node_count || n.second >= node_count))) {
+            CORE_ERROR("BSP tree node %lu is invalid", i);
+            *this = BspTree();
+            return false;
+        }
+        if (leaf) {
+            leaves[n.window] = i;
+            ++leaf_count;
+        }
+    }
+    if (!is_tree(in_use, leaf_count)) {
+        CORE_ERROR("BSP tree nodes don't form a tree");
+        *this = BspTree();
+        return false;
+    }
+    return true;
+}
+
+bool BspTree::is_tree(const std::vector<bool>& in_use, size_t leaf_count) const {
+    if (leaves.size() != leaf_count) {
+        return false;// a window in more than one leaf
+    }
+    if (root == NONE) {
+        return free_nodes.size() == nodes.size();
+    }
+    if (root >= nodes.size() || !in_use[root] || nodes[root].parent != NONE) {
+        return false;
+    }
+    // walk down from the root, making sure that nothing is reached twice
+    std::vector<bool> reached(nodes.size(), false);
+    size_t reached_count = 0;
+    std::vector<size_t> pending(1, root);
+    while (!pending.empty()) {
+        size_t node = pending.back();
+        pending.pop_back();
+        if (reached[node]) {
+            return false;
+        }
+        reached[node] = true;
+        ++reached_count;
+        const Node& n = nodes[node];
+        if (n.window != 0) {
+            continue;
+        }
+        const size_t children[2] = { n.first, n.second };
+        for (size_t i = 0; i < 2; ++i) {
+            if (!in_use[children[i]] || nodes[children[i]].parent != node) {
+                return false;
+            }
+            pending.push_back(children[i]);
+        }
+    }
+    // anything in use which wasn't reached is detached from the tree
+    return reached_count == nodes.size() - free_nodes.size();
+}
@@ -0,0 +1,113 @@
+#ifndef GRIDMGR_BSP_H
+#define GRIDMGR_BSP_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include "dimensions.h"
+
+/* A binary space partition of an area (eg a viewport) into windows. Each
+ * internal node splits its area in two, either side by side or stacked, and
+ * each leaf holds a window. Changes only lay out the subtree they affect, and
+ * only report windows whose dimensions actually changed.
+ *
+ * Windows are identified by an opaque nonzero id (eg an X Window). */
+class BspTree {
+public:
+    enum SPLIT {
+        SPLIT_AUTO,// split along the longer side
+        SPLIT_HORIZONTAL,// side by side
+        SPLIT_VERTICAL// stacked
+    };
+
+    struct Change {
+        unsigned long window;
+        Dimensions dim;
+    };
+    typedef std::vector<Change> change_list_t;
+
+    BspTree();
+
+    /* Resizes the area filled by the tree, relaying out every window. */
+    void SetArea(const Dimensions& area, change_list_t& changes);
+    const Dimensions& Area() const { return area; }
+
+    bool Empty() const { return root == NONE; }
+    bool Contains(unsigned long window) const;
+    void Windows(std::vector<unsigned long>& out) const;
+
+    /* Returns the window whose area contains the point, or the window with
+     * the largest area if none do. Returns 0 if the tree is empty. */
+    unsigned long WindowNear(long x, long y) const;
+
+    /* Splits the area of 'at' in two, giving the second half to 'window'.
+     * If the tree is empty, 'window' fills the whole area and 'at' is ignored.
+     * Returns false if 'window' is already in the tree or 'at' isn't. */
+    bool Insert(unsigned long window, unsigned long at, SPLIT split,
+            change_list_t& changes);
+
+    /* Removes 'window', giving its area to its sibling's subtree.
+     * Returns false if 'window' isn't in the tree. */
+    bool Remove(unsigned long window, change_list_t& changes);
+
+    /* Converts the tree to/from a flat list of values, eg for storing in an
+     * X property. Deserialize returns false (and leaves the tree empty) if
+     * the values are invalid. */
+    void Serialize(std::vector<unsigned long>& out) const;
+    bool Deserialize(const unsigned long* values, size_t count);
+
+private:
+    static const size_t NONE = (size_t)-1;
+
+    struct Node {
+        Node()
+            : parent(NONE), first(NONE), second(NONE), split(SPLIT_HORIZONTAL),
+              ratio(500), window(0) {
+            dim.x = dim.y = 0;
+            dim.width = dim.height = 0;
+        }
+
+        size_t parent, first, second;
+        SPLIT split;
+        // thousandths of the area given to 'first'
+        unsigned int ratio;
+        // nonzero for leaves
+        unsigned long window;
+        Dimensions dim;
+    };
+
+    size_t alloc();
+    void release(size_t node);
+    void layout(size_t node, const Dimensions& dim, change_list_t& changes);
+    /* Whether the nodes in use form a single tree under 'root', with each
+     * child pointing back at its parent, and each window in one leaf. */
+    bool is_tree(const std::vector<bool>& in_use, size_t leaf_count) const;
+
+    std::vector<Node> nodes;
+    std::vector<size_t> free_nodes;
+    // window -> leaf node
+    std::map<unsigned long, size_t> leaves;
+    size_t root;
+    Dimensions area;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "command.h"
+#include "config.h"
+#include "grid.h"
+#include "stats.h"
+
+namespace {
+    /* 'type' is the argument's prefix: 'g', 'w', or 'm'. */
+    bool strsub_to_pos(char type, const char* arg, grid::POS& out) {
+        if (strcmp(arg, "uleft") == 0) {
+            out = grid::POS_UP_LEFT;
+        } else if (strcmp(arg, "up") == 0) {
+            out = grid::POS_UP_CENTER;
+        } else if (strcmp(arg, "uright") == 0) {
+            out = grid::POS_UP_RIGHT;
+
+        } else if (strcmp(arg, "left") == 0) {
+            out = grid::POS_LEFT;
+        } else if (type == 'g' && strcmp(arg, "center") == 0) {
+            out = grid::POS_CENTER;
+        } else if (strcmp(arg, "right") == 0) {
+            out = grid::POS_RIGHT;
+
+        } else if (strcmp(arg, "dleft") == 0) {
+            out = grid::POS_DOWN_LEFT;
+        } else if (strcmp(arg, "down") == 0) {
+            out = grid::POS_DOWN_CENTER;
+        } else if (strcmp(arg, "dright") == 0) {
+            out = grid::POS_DOWN_RIGHT;
+
+        } else if (type == 'w' && strcmp(arg, "stack") == 0) {
+            out = grid::POS_STACK;
+        } else if (type == 'g' && strcmp(arg, "free") == 0) {
+            out = grid::POS_FREE;
+
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    /* Positions which don't build on the window's current state, so they
+       can't be coalesced with any others. */
+    inline bool standalone(grid::POS pos) {
+        return pos == grid::POS_FREE || pos == grid::POS_UNDO || pos == grid::POS_REDO;
+    }
+
+    /* A run of grid positions which all apply to the same window, along with
+       the commands they came from. */
+    struct pos_run {
+        grid::pos_list_t gridpos;
+        std::vector<size_t> cmd_indexes;
+    };
+
+    void flush(pos_run& run, std::vector<bool>& results,
+            const DesktopSnapshot* snapshot) {
+        if (run.gridpos.empty()) {
+            return;
+        }
+        if (run.gridpos.size() > 1) {
+            DEBUG("coalescing %lu positions into one move", run.gridpos.size());
+            stats::count(stats::COUNTER_COALESCED, run.gridpos.size() - 1);
+        }
+        bool ok = grid::set_position(run.gridpos, grid::POS_CURRENT, snapshot);
+        for (size_t i = 0; i < run.cmd_indexes.size(); ++i) {
+            results[run.cmd_indexes[i]] = ok;
+        }
+        run.gridpos.clear();
+        run.cmd_indexes.clear();
+    }
+}
+
+bool command::parse_arg(const char* arg, Command& cmd) {
+    grid::POS tmp_pos;
+    if (arg[0] == 'g' && strsub_to_pos(arg[0], arg+1, tmp_pos)) {
+        if (cmd.gridpos != grid::POS_CURRENT) {
+            ERROR("Multiple positions specified: '%s'", arg);
+            return false;
+        }
+        cmd.gridpos = tmp_pos;
+    } else if (arg[0] == 'w' && strsub_to_pos(arg[0], arg+1, tmp_pos)) {
+        if (cmd.window != grid::POS_CURRENT) {
+            ERROR("Multiple windows specified: '%s'", arg);
+            return false;
+        }
+        cmd.window = tmp_pos;
+    } else if (strcmp(arg, "undo") == 0 || strcmp(arg, "redo") == 0) {
+        if (cmd.gridpos != grid::POS_CURRENT) {
+            ERROR("Multiple positions specified: '%s'", arg);
+            return false;
+        }
+        if (cmd.monitor != grid::POS_CURRENT) {
+            // history already says where the window goes
+            ERROR("'%s' can't be combined with a monitor", arg);
+            return false;
+        }
+        cmd.gridpos = (arg[0] == 'u') ? grid::POS_UNDO : grid::POS_REDO;
+    } else if (arg[0] == 'm' && strsub_to_pos(arg[0], arg+1, tmp_pos)) {
+        if (cmd.monitor != grid::POS_CURRENT) {
+            ERROR("Multiple monitors specified: '%s'", arg);
+            return false;
+        }
+        if (cmd.gridpos == grid::POS_UNDO || cmd.gridpos == grid::POS_REDO) {
+            ERROR("'%s' can't be combined with undo/redo", arg);
+            return false;
+        }
+        cmd.monitor = tmp_pos;
+    } else {
+        ERROR("Unknown argument: '%s'", arg);
+        return false;
+    }
+    return true;
+}
+
+void command::run(const cmd_list_t& cmds, std::vector<bool>& results,
+        const DesktopSnapshot* snapshot) {
+    results.assign(cmds.size(), true);
+
+    // reused by each call, so that the daemon doesn't allocate them per command
+    static thread_local pos_run run;
+    static thread_local grid::pos_list_t single_pos(1);
+    run.gridpos.clear();
+    run.cmd_indexes.clear();
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        const Command& cmd = cmds[i];
+        if (cmd.window != grid::POS_CURRENT || cmd.monitor != grid::POS_CURRENT ||
+                standalone(cmd.gridpos)) {
+            // this command changes the active window or its monitor, or depends
+            // on where the other windows are: finish up the previous window's
+            // run before continuing
+            flush(run, results, snapshot);
+        }
+
+        // activate window (if specified)
+        if (cmd.window != grid::POS_CURRENT && !grid::set_active(cmd.window, snapshot)) {
+            results[i] = false;
+            continue;
+        }
+
+        // move window (if specified)
+        if (cmd.monitor != grid::POS_CURRENT || standalone(cmd.gridpos)) {
+            single_pos[0] = cmd.gridpos;
+            results[i] = grid::set_position(single_pos, cmd.monitor, snapshot);
+        } else if (cmd.gridpos != grid::POS_CURRENT) {
+            run.gridpos.push_back(cmd.gridpos);
+            run.cmd_indexes.push_back(i);
+        }
+    }
+    flush(run, results, snapshot);
+}
@@ -0,0 +1,55 @@
+#ifndef GRIDMGR_COMMAND_H
+#define GRIDMGR_COMMAND_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+
+#include "desktop.h"
+#include "pos.h"
+
+/* A single gridmgr invocation: activate a window, then move the active window
+ * to a monitor and/or grid position. Any of these may be POS_CURRENT. */
+struct Command {
+    Command()
+        : window(grid::POS_CURRENT), monitor(grid::POS_CURRENT),
+          gridpos(grid::POS_CURRENT) { }
+
+    grid::POS window;
+    grid::POS monitor;
+    grid::POS gridpos;
+};
+
+typedef std::vector<Command> cmd_list_t;
+
+namespace command {
+    /* Applies a single "w<dir>", "m<dir>", "g<pos>", "undo", or "redo"
+     * argument to 'cmd'.
+     * Returns false if it's invalid or if 'cmd' already has one of its kind. */
+    bool parse_arg(const char* arg, Command& cmd);
+
+    /* Runs the provided commands in order, producing a success/failure result
+     * for each of them. Consecutive grid positions for the same window are
+     * coalesced into a single move. If 'snapshot' is provided, windows and
+     * viewports are taken from it rather than being fetched. */
+    void run(const cmd_list_t& cmds, std::vector<bool>& results,
+            const DesktopSnapshot* snapshot = NULL);
+}
+
+#endif
@@ -16,34 +16,67 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "async-log.h"
 #include "config.h"
 
+#include <errno.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace {
+    /* Prints a line to 'out', prefixed with 'prefix' (containing the function
+       name) unless 'func' is NULL. Lines for the --log file are queued for
+       the background writer instead of being written here. */
+    void emit(FILE* out, const char* prefix, const char* func,
+            const char* format, va_list args) {
+        if (async_log::is_target(out)) {
+            char line[ASYNC_LOG_RECORD_MAX];
+            int len = 0;
+            if (func != NULL) {
+                len = snprintf(line, sizeof(line), prefix, func);
+            }
+            if (len >= 0 && (size_t)len < sizeof(line)) {
+                int body = vsnprintf(line + len, sizeof(line) - len, format, args);
+                len = (body < 0) ? len : len + body;
+            }
+            if (len < 0) {
+                return;
+            }
+            if ((size_t)len >= sizeof(line) - 1) {
+                len = sizeof(line) - 2;// truncated: make room for the newline
+            }
+            line[len++] = '\n';
+            async_log::push(line, len);
+            return;
+        }
+        if (func != NULL) {
+            fprintf(out, prefix, func);
+        }
+        vfprintf(out, format, args);
+        fprintf(out, "\n");
+    }
+}
 
 namespace config {
     FILE *fout = stdout, *ferr = stderr;
     bool debug_enabled = false;
+    bool sync_enabled = false;
 
     void _debug(const char* func, const char* format, ...) {
         if (debug_enabled) {
             va_list args;
             va_start(args, format);
-            if (func != NULL) {
-                fprintf(fout, "DEBUG %s ", func);
-            }
-            vfprintf(fout, format, args);
+            emit(fout, "DEBUG %s ", func, format, args);
             va_end(args);
-            fprintf(fout, "\n");
         }
     }
     void _debug(const char* func, ...) {
         if (debug_enabled) {
             va_list args;
             va_start(args, func);
-            if (func != NULL) {
-                fprintf(fout, "DEBUG %s ", func);
-            }
-            vfprintf(fout, "%s\n", args);//only one arg, the string itself
+            emit(fout, "DEBUG %s ", func, "%s", args);//only one arg, the string itself
             va_end(args);
         }
     }
@@ -51,40 +84,79 @@ namespace config {
     void _log(const char* func, const char* format, ...) {
         va_list args;
         va_start(args, format);
-        if (func != NULL) {
-            fprintf(fout, "LOG %s() ", func);
-        }
-        vfprintf(fout, format, args);
+        emit(fout, "LOG %s() ", func, format, args);
         va_end(args);
-        fprintf(fout, "\n");
     }
     void _log(const char* func, ...) {
         va_list args;
         va_start(args, func);
-        if (func != NULL) {
-            fprintf(fout, "LOG %s() ", func);
-        }
-        vfprintf(fout, "%s\n", args);//only one arg, the string itself
+        emit(fout, "LOG %s() ", func, "%s", args);//only one arg, the string itself
         va_end(args);
     }
 
     void _error(const char* func, const char* format, ...) {
         va_list args;
         va_start(args, format);
-        if (func != NULL) {
-            fprintf(ferr, "ERROR %s() ", func);
-        }
-        vfprintf(ferr, format, args);
+        emit(ferr, "ERROR %s() ", func, format, args);
         va_end(args);
-        fprintf(ferr, "\n");
     }
     void _error(const char* func, ...) {
         va_list args;
         va_start(args, func);
-        if (func != NULL) {
-            fprintf(ferr, "ERROR %s() ", func);
-        }
-        vfprintf(ferr, "%s\n", args);//only one arg, the string itself
+        emit(ferr, "ERROR %s() ", func, "%s", args);//only one arg, the string itself
         va_end(args);
     }
+
+    void core_message(core_hooks::LEVEL level, const char* func,
+            const char* format, va_list args) {
+        if (level == core_hooks::LEVEL_ERROR) {
+            emit(ferr, "ERROR %s() ", func, format, args);
+        } else if (debug_enabled) {
+            emit(fout, "DEBUG %s ", func, format, args);
+        }
+    }
+
+    bool user_dir(const char* subdir, bool create, std::string& out) {
+        const char* config_home = getenv("XDG_CONFIG_HOME");
+        if (config_home != NULL && config_home[0] != '\0') {
+            out = config_home;
+        } else {
+            const char* home = getenv("HOME");
+            if (home == NULL || home[0] == '\0') {
+                _error(__FUNCTION__, "neither XDG_CONFIG_HOME nor HOME are set");
+                return false;
+            }
+            out = std::string(home) + "/.config";
+        }
+
+        // create any missing parents of the base dir, eg a fresh ~/.config
+        for (size_t slash = out.find('/', 1); create && slash != std::string::npos;
+             slash = out.find('/', slash + 1)) {
+            std::string parent = out.substr(0, slash);
+            if (mkdir(parent.c_str(), 0700) != 0 && errno != EEXIST) {
+                _error(__FUNCTION__, "unable to create %s: %s", parent.c_str(), strerror(errno));
+                return false;
+            }
+        }
+        if (create && mkdir(out.c_str(), 0700) != 0 && errno != EEXIST) {
+            _error(__FUNCTION__, "unable to create %s: %s", out.c_str(), strerror(errno));
+            return false;
+        }
+
+        const char* subdirs[] = { "/gridmgr", subdir };
+        for (size_t i = 0; i < sizeof(subdirs) / sizeof(const char*); ++i) {
+            if (subdirs[i] == NULL) {
+                continue;
+            }
+            if (i > 0) {
+                out += '/';
+            }
+            out += subdirs[i];
+            if (create && mkdir(out.c_str(), 0700) != 0 && errno != EEXIST) {
+                _error(__FUNCTION__, "unable to create %s: %s", out.c_str(), strerror(errno));
+                return false;
+            }
+        }
+        return true;
+    }
 }
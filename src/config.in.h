@@ -19,7 +19,11 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdarg.h>
 #include <stdio.h>
+#include <string>
+
+#include "core-hooks.h"
 
 /* Some simple print helpers */
 
@@ -31,6 +35,9 @@
 #define PRINT_HELP(...) config::_error(NULL, __VA_ARGS__)
 
 #cmakedefine USE_XINERAMA
+#cmakedefine USE_XSYNC
+#cmakedefine USE_USDT
+#cmakedefine COUNT_ALLOCS
 
 namespace config {
     static const int
@@ -45,6 +52,12 @@ namespace config {
     extern FILE *ferr;
 
     extern bool debug_enabled;
+    extern bool sync_enabled;
+
+    /* Gets gridmgr's directory under \$XDG_CONFIG_HOME (or ~/.config), with
+     * 'subdir' appended if it's non-NULL. If 'create' is set, any missing
+     * directories are created. Returns true on success, else false. */
+    bool user_dir(const char* subdir, bool create, std::string& out);
 
     /* DONT USE THESE DIRECTLY, use DEBUG()/LOG()/ERROR() instead.
      * The ones with a 'format' function support printf-style format before a list of args.
@@ -56,6 +69,10 @@ namespace config {
     void _log(const char* func, ...);
     void _error(const char* func, const char* format, ...);
     void _error(const char* func, ...);
+
+    /* Passes gridmgr_core's messages to DEBUG()/ERROR(). See core-hooks.h. */
+    void core_message(core_hooks::LEVEL level, const char* func,
+            const char* format, va_list args);
 }
 
 #endif
@@ -0,0 +1,44 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core-hooks.h"
+
+namespace {
+    core_hooks::message_fn message_hook = NULL;
+}
+
+namespace core_hooks {
+    span_begin_fn _span_begin = NULL;
+    span_end_fn _span_end = NULL;
+
+    void set(message_fn message, span_begin_fn span_begin, span_end_fn span_end) {
+        message_hook = message;
+        _span_begin = span_begin;
+        _span_end = span_end;
+    }
+
+    void _message(LEVEL level, const char* func, const char* format, ...) {
+        if (message_hook == NULL) {
+            return;
+        }
+        va_list args;
+        va_start(args, format);
+        message_hook(level, func, format, args);
+        va_end(args);
+    }
+}
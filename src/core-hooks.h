@@ -0,0 +1,76 @@
+#ifndef GRIDMGR_CORE_HOOKS_H
+#define GRIDMGR_CORE_HOOKS_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <stdarg.h>
+
+/* How gridmgr_core reports what it's doing, without depending on how the
+ * program using it logs or times things. The hooks start out NULL, in which
+ * case messages are dropped and spans aren't timed. gridmgr points them at its
+ * own logging and tracing on startup. */
+namespace core_hooks {
+    enum LEVEL { LEVEL_DEBUG, LEVEL_ERROR };
+
+    /* Receives a printf-style message from the function 'func'. */
+    typedef void (*message_fn)(LEVEL level, const char* func,
+            const char* format, va_list args);
+    /* Called as a stage begins. Returns a token to pass to span_end_fn, or 0
+     * if the stage shouldn't be timed. */
+    typedef unsigned long (*span_begin_fn)();
+    /* Called as the stage 'name' (a string literal) ends. */
+    typedef void (*span_end_fn)(const char* name, unsigned long token);
+
+    /* Sets all of the hooks at once. Should be called before any other thread
+     * uses the core. */
+    void set(message_fn message, span_begin_fn span_begin, span_end_fn span_end);
+
+    /* DONT USE THESE DIRECTLY, use CORE_DEBUG()/CORE_ERROR()/CORE_SPAN() instead. */
+    extern span_begin_fn _span_begin;
+    extern span_end_fn _span_end;
+    void _message(LEVEL level, const char* func, const char* format, ...);
+}
+
+#define CORE_DEBUG(...) core_hooks::_message(core_hooks::LEVEL_DEBUG, __FUNCTION__, __VA_ARGS__)
+#define CORE_ERROR(...) core_hooks::_message(core_hooks::LEVEL_ERROR, __FUNCTION__, __VA_ARGS__)
+
+/* Passes a stage to the span hooks from construction until destruction.
+ * 'name' must be a string literal. */
+class CoreSpan {
+public:
+    CoreSpan(const char* name)
+        : name(name), token((core_hooks::_span_begin != NULL) ? core_hooks::_span_begin() : 0) { }
+    ~CoreSpan() {
+        if (token != 0) {
+            core_hooks::_span_end(name, token);
+        }
+    }
+
+private:
+    CoreSpan(const CoreSpan&);
+    CoreSpan& operator=(const CoreSpan&);
+
+    const char* name;
+    const unsigned long token;
+};
+
+#define CORE_SPAN(name) CoreSpan _core_span(name)
+
+#endif
@@ -0,0 +1,178 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "core-hooks.h"
+#include "core.h"
+
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#define MAX(a,b) (((a) > (b)) ? (a) : (b))
+
+namespace {
+    long overlap(long a1, long a2, long b1, long b2) {
+        long ret = MIN(a2, b2) - MAX(a1, b1);
+        return (ret > 0) ? ret : 0;
+    }
+
+    double distance_sq(const Dimensions& a, const Dimensions& b) {
+        double dx = (a.x + a.width / 2.) - (b.x + b.width / 2.),
+            dy = (a.y + a.height / 2.) - (b.y + b.height / 2.);
+        return dx * dx + dy * dy;
+    }
+
+    /* Orders windows by their nearest cell, then by their original order. */
+    struct cell_order {
+        cell_order(const std::vector<size_t>& nearest) : nearest(nearest) { }
+        bool operator()(size_t a, size_t b) const {
+            return (nearest[a] != nearest[b]) ? nearest[a] < nearest[b] : a < b;
+        }
+        const std::vector<size_t>& nearest;
+    };
+}
+
+size_t core::active_viewport(const dim_list_t& viewports, const Dimensions& window) {
+    // the viewport with the most overlap is the 'active viewport'
+    size_t active = 0;
+    long active_overlap = 0;
+    for (size_t i = 0; i < viewports.size(); ++i) {
+        const Dimensions& v = viewports[i];
+        long area =
+            overlap(v.x, v.x + v.width, window.x, window.x + window.width) *
+            overlap(v.y, v.y + v.height, window.y, window.y + window.height);
+        if (area > active_overlap) {
+            active_overlap = area;
+            active = i;
+        }
+    }
+    return active;
+}
+
+bool core::place(const Dimensions& window,
+        const Dimensions& cur_viewport, const Dimensions& next_viewport,
+        const grid::pos_list_t& gridpos,
+        State& state_out, Dimensions& dim_out, const SizeHints& hints) {
+    PositionCalc pcalc(window, hints);
+
+    State cur_state;
+    /* cur_viewport + window -> cur_state */
+    if (!pcalc.CurState(cur_viewport, cur_state)) {
+        return false;
+    }
+    state_out = cur_state;
+    for (grid::pos_list_t::const_iterator iter = gridpos.begin();
+         iter != gridpos.end(); ++iter) {
+        /* cur_state + pos -> state_out (rotating through modes in memory
+           when the same position is repeated) */
+        cur_state = state_out;
+        if (!pcalc.NextState(cur_state, *iter, state_out)) {
+            return false;
+        }
+    }
+
+    if (state_out.pos == grid::POS_UNKNOWN && state_out.mode == grid::MODE_UNKNOWN) {
+        // window doesnt currently have a state, and user didn't specify one
+        pcalc.ViewportToDim(cur_viewport, next_viewport, dim_out);
+        return true;
+    }
+    // next_viewport + state_out -> dim_out
+    return pcalc.StateToDim(next_viewport, state_out, dim_out);
+}
+
+bool core::mode_cells(const Dimensions& viewport, grid::MODE mode, dim_list_t& out) {
+    static const grid::POS two_col[] = {
+        grid::POS_UP_LEFT, grid::POS_UP_RIGHT,
+        grid::POS_DOWN_LEFT, grid::POS_DOWN_RIGHT
+    };
+    static const grid::POS three_col[] = {
+        grid::POS_UP_LEFT, grid::POS_UP_CENTER, grid::POS_UP_RIGHT,
+        grid::POS_DOWN_LEFT, grid::POS_DOWN_CENTER, grid::POS_DOWN_RIGHT
+    };
+    const grid::POS* positions;
+    size_t count;
+    switch (mode) {
+    case grid::MODE_TWO_COL:
+        positions = two_col;
+        count = sizeof(two_col) / sizeof(grid::POS);
+        break;
+    case grid::MODE_THREE_COL_S:
+        positions = three_col;
+        count = sizeof(three_col) / sizeof(grid::POS);
+        break;
+    default:
+        CORE_ERROR("Can't tile with mode=%s", grid::mode_str(mode));
+        return false;
+    }
+
+    // the cells' sizes don't depend on the window
+    Dimensions none = { 0, 0, 0, 0 };
+    PositionCalc pcalc(none);
+    out.clear();
+    for (size_t i = 0; i < count; ++i) {
+        State state;
+        state.pos = positions[i];
+        state.mode = mode;
+        out.push_back(Dimensions());
+        if (!pcalc.StateToDim(viewport, state, out.back())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void core::grid_cells(const Dimensions& viewport, size_t cols, size_t rows,
+        dim_list_t& out) {
+    out.clear();
+    // same rounding as StateToDim, so that 2x2 and 3x2 match the grid positions
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t col = 0; col < cols; ++col) {
+            Dimensions cell;
+            cell.x = viewport.x + (long)(col * viewport.width / (double)cols);
+            cell.y = viewport.y + (long)(row * viewport.height / (double)rows);
+            cell.width = viewport.width / (double)cols;
+            cell.height = viewport.height / (double)rows;
+            out.push_back(cell);
+        }
+    }
+}
+
+void core::assign_cells(const dim_list_t& windows, const dim_list_t& cells,
+        std::vector<size_t>& cell_out) {
+    cell_out.assign(windows.size(), 0);
+    if (cells.empty()) {
+        return;
+    }
+
+    std::vector<size_t> nearest(windows.size(), 0), order(windows.size());
+    for (size_t w = 0; w < windows.size(); ++w) {
+        double best = distance_sq(windows[w], cells[0]);
+        for (size_t c = 1; c < cells.size(); ++c) {
+            double dist = distance_sq(windows[w], cells[c]);
+            if (dist < best) {
+                best = dist;
+                nearest[w] = c;
+            }
+        }
+        order[w] = w;
+    }
+    std::sort(order.begin(), order.end(), cell_order(nearest));
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        cell_out[order[i]] = i % cells.size();
+    }
+}
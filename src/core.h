@@ -0,0 +1,70 @@
+#ifndef GRIDMGR_CORE_H
+#define GRIDMGR_CORE_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The geometry behind gridmgr's commands, without any X dependency. Programs
+ * which already know their windows and monitors (window managers, bars, ...)
+ * may link against gridmgr_core and call these directly. */
+
+#include <cstddef>
+
+#include "bsp.h"
+#include "dimensions.h"
+#include "neighbor.h"
+#include "pos.h"
+#include "position.h"
+#include "strut.h"
+
+namespace core {
+    /* Returns the index of the viewport containing most of 'window'. */
+    size_t active_viewport(const dim_list_t& viewports, const Dimensions& window);
+
+    /* Calculates where 'window' ends up after 'gridpos' is applied to its
+     * current state on 'cur_viewport', when it's being moved to
+     * 'next_viewport' (which may be the same). Each position is applied in
+     * order, as if the command had been run once for each of them. If the
+     * window's size 'hints' are known, 'dim_out' follows them.
+     * Returns true on success, else false. */
+    bool place(const Dimensions& window,
+            const Dimensions& cur_viewport, const Dimensions& next_viewport,
+            const grid::pos_list_t& gridpos,
+            State& state_out, Dimensions& dim_out,
+            const SizeHints& hints = SizeHints());
+
+    /* Produces the cells of 'mode' within 'viewport', in rows from top left
+     * to bottom right, sized the same as the matching grid positions.
+     * Returns false if 'mode' isn't TWO_COL or THREE_COL_S. */
+    bool mode_cells(const Dimensions& viewport, grid::MODE mode, dim_list_t& out);
+
+    /* Splits 'viewport' into 'cols' x 'rows' equally sized cells, in rows
+     * from top left to bottom right. */
+    void grid_cells(const Dimensions& viewport, size_t cols, size_t rows,
+            dim_list_t& out);
+
+    /* Assigns each window to a cell, so that windows keep roughly the same
+     * order that they're already in: windows are ordered by the cell nearest
+     * their center, then given cells in that order. If there are more windows
+     * than cells, the extras start over from the first cell.
+     * 'cell_out[i]' is the index of the cell for 'windows[i]'. */
+    void assign_cells(const dim_list_t& windows, const dim_list_t& cells,
+            std::vector<size_t>& cell_out);
+}
+
+#endif
@@ -0,0 +1,285 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "desktop-cache.h"
+#include "x11-util.h"
+
+/* Reader generation which means 'not currently reading anything'. */
+#define QUIESCENT 0
+
+namespace {
+    /* Whether a change to this property affects what's in the snapshot. */
+    bool is_watched(Display* disp, Atom atom) {
+        static thread_local Atom watched[] = {
+            // root window
+            x11_util::intern_atom(disp, "_NET_CLIENT_LIST"),
+            x11_util::intern_atom(disp, "_NET_CURRENT_DESKTOP"),
+            x11_util::intern_atom(disp, "_NET_WORKAREA"),
+            // client windows
+            x11_util::intern_atom(disp, "_NET_WM_STATE"),
+            x11_util::intern_atom(disp, "_NET_WM_STRUT_PARTIAL"),
+            x11_util::intern_atom(disp, "_NET_WM_WINDOW_TYPE")
+        };
+        for (size_t i = 0; i < sizeof(watched) / sizeof(Atom); ++i) {
+            if (atom == watched[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Applies a frame's new geometry to the snapshot, without any round trips.
+       Returns whether the frame belonged to any known window. */
+    bool apply_configure(const XConfigureEvent& event, DesktopSnapshot& snapshot) {
+        for (win_list_t::iterator iter = snapshot.windows.begin();
+             iter != snapshot.windows.end(); ++iter) {
+            if (iter->frame == event.window) {
+                iter->exterior.x = event.x;
+                iter->exterior.y = event.y;
+                iter->exterior.width = event.width;
+                iter->exterior.height = event.height;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+DesktopCache::DesktopCache()
+    : disp(NULL), current(NULL), generation(0), reader_generation(QUIESCENT) {
+    stop_pipe[0] = stop_pipe[1] = -1;
+}
+
+DesktopCache::~DesktopCache() {
+    Stop();
+}
+
+void DesktopCache::AddListener(SnapshotListener* listener) {
+    listeners.push_back(listener);
+}
+
+bool DesktopCache::Start(const char* display_name) {
+    disp = XOpenDisplay(display_name);
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+    if (pipe(stop_pipe) != 0) {
+        ERROR("pipe failed: %s", strerror(errno));
+        XCloseDisplay(disp);
+        disp = NULL;
+        return false;
+    }
+
+    /* listen before fetching, so that nothing's missed in between.
+       - root property changes: client list, workareas
+       - root substructure changes: frames being moved or resized
+       - root structure changes: the screen being resized */
+    XSelectInput(disp, DefaultRootWindow(disp),
+            PropertyChangeMask | SubstructureNotifyMask | StructureNotifyMask);
+
+    // the first snapshot is fetched by the event thread, see loop()
+    thread = std::thread(&DesktopCache::loop, this);
+    return true;
+}
+
+void DesktopCache::Stop() {
+    if (thread.joinable()) {
+        char stop = 1;
+        if (write(stop_pipe[1], &stop, 1) != 1) {
+            ERROR("unable to stop event thread: %s", strerror(errno));
+        }
+        thread.join();
+    }
+    if (stop_pipe[0] >= 0) {
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        stop_pipe[0] = stop_pipe[1] = -1;
+    }
+    if (disp != NULL) {
+        XCloseDisplay(disp);
+        disp = NULL;
+    }
+    reclaim(true);
+    delete current.exchange(NULL);
+}
+
+const DesktopSnapshot* DesktopCache::Acquire() {
+    /* announce the generation we're about to see before looking at it. the
+       event thread won't free anything at or after this generation. */
+    reader_generation.store(generation.load());
+    return current.load();
+}
+
+void DesktopCache::Release() {
+    reader_generation.store(QUIESCENT);
+}
+
+void DesktopCache::loop() {
+    /* atoms are interned once per thread, so each display's lookups must stay
+       on its own thread. that includes the first one. */
+    Window root = DefaultRootWindow(disp);
+    Atom active_atom = x11_util::intern_atom(disp, "_NET_ACTIVE_WINDOW");
+    {
+        DesktopSnapshot* initial = new DesktopSnapshot;
+        if (desktop::fetch(disp, *initial)) {
+            select_clients(*initial);
+            desktop::classify(*initial);
+            predict::compute(*initial);
+            publish(initial);
+        } else {
+            // try again when something changes
+            delete initial;
+        }
+    }
+    for (;;) {
+        if (XPending(disp) == 0) {
+            struct pollfd fds[2];
+            fds[0].fd = ConnectionNumber(disp);
+            fds[0].events = POLLIN;
+            fds[1].fd = stop_pipe[0];
+            fds[1].events = POLLIN;
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ERROR("poll failed: %s", strerror(errno));
+                return;
+            }
+            if (fds[1].revents != 0) {
+                return;
+            }
+        }
+
+        /* drain everything that's queued, so that a storm of events only
+           results in a single update */
+        bool refetch = (current.load() == NULL), active_changed = false;
+        std::vector<XConfigureEvent> configures;
+        while (XPending(disp) > 0) {
+            XEvent event;
+            XNextEvent(disp, &event);
+            switch (event.type) {
+            case ConfigureNotify:
+                if (event.xconfigure.window == root) {
+                    refetch = true;// screen was resized
+                } else {
+                    configures.push_back(event.xconfigure);
+                }
+                break;
+            case PropertyNotify:
+                if (event.xproperty.atom == active_atom) {
+                    active_changed = true;
+                } else if (is_watched(disp, event.xproperty.atom)) {
+                    refetch = true;
+                }
+                break;
+            case ReparentNotify:
+                refetch = true;// frames changed
+                break;
+            case MapNotify:
+                refetch = true;// a new window may need placing
+                break;
+            default:
+                break;
+            }
+        }
+
+        DesktopSnapshot* next = NULL;
+        if (refetch) {
+            next = new DesktopSnapshot;
+            if (!desktop::fetch(disp, *next)) {
+                delete next;
+                continue;
+            }
+            select_clients(*next);
+        } else if (active_changed || !configures.empty()) {
+            // just focus changes or moves/resizes: update what we've already got
+            next = new DesktopSnapshot(*current.load());
+            bool changed = false;
+            if (active_changed) {
+                desktop::fetch_active(disp, *next);
+                changed = true;
+            }
+            for (size_t i = 0; i < configures.size(); ++i) {
+                changed |= apply_configure(configures[i], *next);
+            }
+            if (!changed) {
+                delete next;
+                continue;
+            }
+        } else {
+            continue;
+        }
+
+        /* we're otherwise idle, so get a head start on the next command.
+           it's most likely to be for the active window. */
+        desktop::classify(*next);
+        predict::compute(*next);
+        publish(next);
+    }
+}
+
+void DesktopCache::select_clients(const DesktopSnapshot& snapshot) {
+    /* get told about changes to the clients' types/states/struts.
+       repeat selections are harmless, as are ones for destroyed windows
+       (the resulting BadWindow errors are ignored by the daemon) */
+    for (win_list_t::const_iterator iter = snapshot.windows.begin();
+         iter != snapshot.windows.end(); ++iter) {
+        XSelectInput(disp, iter->id, PropertyChangeMask);
+    }
+    XFlush(disp);
+}
+
+void DesktopCache::publish(DesktopSnapshot* next) {
+    next->generation = generation.load() + 1;
+    DesktopSnapshot* prev = current.exchange(next);
+    /* only advance the generation after the new snapshot is visible: a reader
+       which sees this generation is guaranteed to get the new snapshot */
+    generation.store(next->generation);
+    DEBUG("published snapshot %lu: %lu windows, %lu viewports",
+            next->generation, next->windows.size(), next->viewports.size());
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        listeners[i]->Published(*next);
+    }
+
+    if (prev != NULL) {
+        retired.push_back(prev);
+    }
+    reclaim(false);
+}
+
+void DesktopCache::reclaim(bool all) {
+    unsigned long seen = reader_generation.load();
+    for (size_t i = 0; i < retired.size();) {
+        /* a reader that announced generation N is looking at generation N or
+           later, so anything older than N can't be in use */
+        if (all || seen == QUIESCENT || retired[i]->generation < seen) {
+            delete retired[i];
+            retired[i] = retired.back();
+            retired.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef GRIDMGR_DESKTOP_CACHE_H
+#define GRIDMGR_DESKTOP_CACHE_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "desktop.h"
+
+/* Gets told about each new snapshot, on the cache's event thread. */
+class SnapshotListener {
+public:
+    virtual ~SnapshotListener() { }
+    virtual void Published(const DesktopSnapshot& snapshot) = 0;
+};
+
+/* Keeps an up to date DesktopSnapshot using a separate X connection and
+ * thread, which listens for changes to windows and viewports.
+ *
+ * Each update produces a new immutable snapshot which replaces the previous
+ * one, so that reading a snapshot never waits on the event thread. Snapshots
+ * are freed once the reader is no longer using them. Only one thread may read
+ * from the cache. */
+class DesktopCache {
+public:
+    DesktopCache();
+    virtual ~DesktopCache();
+
+    /* Adds a listener to be told about new snapshots. Must be called before
+     * Start(). The listener must outlive the cache. */
+    void AddListener(SnapshotListener* listener);
+
+    /* Starts listening for changes to the named display (eg ":0.1"). The
+     * initial snapshot is fetched on the event thread, so Acquire() may
+     * return NULL for a moment. Returns false if it couldn't be opened. */
+    bool Start(const char* display_name);
+    void Stop();
+
+    /* Returns the latest snapshot, or NULL if none is available. The snapshot
+     * remains valid until Release() is called. */
+    const DesktopSnapshot* Acquire();
+    void Release();
+
+private:
+    DesktopCache(const DesktopCache&);
+    DesktopCache& operator=(const DesktopCache&);
+
+    void loop();
+    void select_clients(const DesktopSnapshot& snapshot);
+    void publish(DesktopSnapshot* next);
+    void reclaim(bool all);
+
+    Display* disp;
+    int stop_pipe[2];
+    std::thread thread;
+
+    std::atomic<DesktopSnapshot*> current;
+    // generation of the latest published snapshot
+    std::atomic<unsigned long> generation;
+    // generation seen by the reader in Acquire(), or 0 when not reading
+    std::atomic<unsigned long> reader_generation;
+    // replaced snapshots which may still be in use. only used by the event thread
+    std::vector<DesktopSnapshot*> retired;
+    std::vector<SnapshotListener*> listeners;
+};
+
+#endif
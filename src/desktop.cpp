@@ -0,0 +1,152 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "core.h"
+#include "desktop.h"
+#include "viewport.h"
+#include "window.h"
+#include "x11-util.h"
+
+bool desktop::fetch(Display* disp, DesktopSnapshot& out) {
+    out.windows.clear();
+    out.viewports.clear();
+    fetch_active(disp, out);
+    out.current_desktop = -1;
+    window::get_current_desktop(disp, out.current_desktop);// disregard failure
+
+    size_t win_count = 0;
+    static thread_local Atom clientlist_msg = x11_util::intern_atom(disp, "_NET_CLIENT_LIST");
+    Window* all_wins = (Window*)x11_util::get_property(disp, DefaultRootWindow(disp),
+            XA_WINDOW, clientlist_msg, &win_count);
+    if (all_wins == NULL) {
+        ERROR("unable to get list of windows");
+        return false;
+    }
+    // these don't depend on each other, so get them for all windows at once
+    std::vector<bool> ignored, hidden;
+    window::find_ignored(disp, all_wins, win_count, ignored, &hidden);
+    static thread_local Atom desktop_msg = x11_util::intern_atom(disp, "_NET_WM_DESKTOP");
+    prop_list_t desktops, size_hints;
+    x11_util::get_properties(disp, all_wins, win_count, XA_CARDINAL, desktop_msg, desktops);
+    x11_util::get_properties(disp, all_wins, win_count,
+            XA_WM_SIZE_HINTS, XA_WM_NORMAL_HINTS, size_hints);
+
+    out.windows.reserve(win_count);
+    for (size_t i = 0; i < win_count; ++i) {
+        WindowInfo info;
+        info.id = all_wins[i];
+        if (!window::get_size(disp, info.id, info.exterior,
+                        info.margin_width, info.margin_height, info.frame)) {
+            // probably went away while we were looking at it
+            continue;
+        }
+        info.managed = !ignored[i];
+        info.hidden = hidden[i];
+        info.hints.margin_width = info.margin_width;
+        info.hints.margin_height = info.margin_height;
+        if (size_hints[i].data != NULL) {
+            window::parse_size_hints((const unsigned long*)size_hints[i].data,
+                    size_hints[i].count, info.hints);
+        }
+
+        const unsigned long* desktop = (const unsigned long*)desktops[i].data;
+        if (desktop != NULL && desktops[i].count > 0) {
+            // 0xFFFFFFFF (all desktops) -> -1
+            info.desktop = (*desktop == 0xFFFFFFFF) ? -1 : (long)*desktop;
+        }
+
+        out.windows.push_back(info);
+    }
+    x11_util::free_properties(desktops);
+    x11_util::free_properties(size_hints);
+    x11_util::free_property(all_wins);
+
+    // no active window to speak of, it's looked up separately
+    Dimensions none = { 0, 0, 0, 0 };
+    size_t active;
+    if (!viewport::get_all(disp, none, out.viewports, active)) {
+        return false;
+    }
+
+    DEBUG("fetched %lu windows, %lu viewports",
+            out.windows.size(), out.viewports.size());
+    return true;
+}
+
+void desktop::fetch_active(Display* disp, DesktopSnapshot& out) {
+    if (!window::get_active(disp, out.active)) {
+        // eg nothing's active at the moment
+        out.active = 0;
+    }
+}
+
+void desktop::classify(DesktopSnapshot& snapshot) {
+    if (snapshot.viewports.empty()) {
+        return;
+    }
+    for (win_list_t::iterator iter = snapshot.windows.begin();
+         iter != snapshot.windows.end(); ++iter) {
+        iter->viewport = core::active_viewport(snapshot.viewports, iter->exterior);
+        PositionCalc pcalc(iter->exterior, iter->hints);
+        if (!pcalc.CurState(snapshot.viewports[iter->viewport], iter->state)) {
+            iter->state = State();
+        }
+    }
+    occupancy::build(snapshot);
+}
+
+bool desktop::fetch_classified(Display* disp, DesktopSnapshot& out) {
+    if (!fetch(disp, out)) {
+        return false;
+    }
+    classify(out);
+    return true;
+}
+
+bool desktop::neighbor(const DesktopSnapshot& snapshot, Window from, grid::POS dir,
+        Window& out) {
+    // reused, to avoid allocating per command
+    static thread_local std::vector<Window> wins;
+    static thread_local dim_list_t all_windows;
+    wins.clear();
+    all_windows.clear();
+    size_t from_window = 0;
+    for (win_list_t::const_iterator iter = snapshot.windows.begin();
+         iter != snapshot.windows.end(); ++iter) {
+        if (!iter->managed) {
+            continue;
+        }
+        if (iter->id == from) {
+            from_window = wins.size();
+            DEBUG("ACTIVE:");
+        }
+        DEBUG("  %ldx %ldy %luw %luh (cached)", iter->exterior.x, iter->exterior.y,
+                iter->exterior.width, iter->exterior.height);
+        wins.push_back(iter->id);
+        all_windows.push_back(iter->exterior);
+    }
+    if (wins.empty()) {
+        return false;
+    }
+
+    size_t next_window;
+    neighbor::select(dir, all_windows, from_window, next_window);
+    out = wins[next_window];
+    return true;
+}
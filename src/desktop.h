@@ -0,0 +1,118 @@
+#ifndef GRIDMGR_DESKTOP_H
+#define GRIDMGR_DESKTOP_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include <X11/Xlib.h>
+
+#include "dimensions.h"
+#include "occupancy.h"
+#include "position.h"
+#include "predict.h"
+
+typedef std::vector<Dimensions> dim_list_t;
+
+struct WindowInfo {
+    WindowInfo()
+        : id(0), frame(0), margin_width(0), margin_height(0), managed(false),
+          hidden(false), desktop(-1), viewport(0) { }
+
+    Window id;
+    // the WM's frame around the window (just before root), or id if unframed
+    Window frame;
+    // exterior size/position, including any frame
+    Dimensions exterior;
+    // difference between exterior and interior size
+    unsigned int margin_width, margin_height;
+    // WM_NORMAL_HINTS, with the margins above
+    SizeHints hints;
+    // false for docks, desktops, and menus, which gridmgr leaves alone
+    bool managed;
+    // minimized (_NET_WM_STATE_HIDDEN)
+    bool hidden;
+    // _NET_WM_DESKTOP, or -1 for all desktops/unknown
+    long desktop;
+    // the viewport containing most of the window, and its state there
+    size_t viewport;
+    State state;
+};
+
+typedef std::vector<WindowInfo> win_list_t;
+
+/* Everything that's needed to handle a command. */
+struct DesktopSnapshot {
+    DesktopSnapshot() : active(0), current_desktop(-1), generation(0) { }
+
+    /* Returns the window's info, or NULL if it isn't in the list. */
+    const WindowInfo* find(Window win) const {
+        for (win_list_t::const_iterator iter = windows.begin();
+             iter != windows.end(); ++iter) {
+            if (iter->id == win) {
+                return &*iter;
+            }
+        }
+        return NULL;
+    }
+
+    /* Returns the active window's info, or NULL if it isn't in the list. */
+    const WindowInfo* active_info() const {
+        return find(active);
+    }
+
+    // all clients, in _NET_CLIENT_LIST order
+    win_list_t windows;
+    // all viewports, with struts trimmed
+    dim_list_t viewports;
+    // the active window, or 0 if unknown
+    Window active;
+    // _NET_CURRENT_DESKTOP, or -1 if unknown
+    long current_desktop;
+    // which windows are in which grid cells, indexed by viewport
+    occupancy_list_t occupancy;
+    // precomputed commands for the active window
+    Prediction prediction;
+    // incremented each time a new snapshot is produced
+    unsigned long generation;
+};
+
+namespace desktop {
+    /* Fetches the current state of all windows and viewports.
+     * Returns true on success, else false. */
+    bool fetch(Display* disp, DesktopSnapshot& out);
+
+    /* Updates the snapshot's active window, or sets it to 0 if there isn't one. */
+    void fetch_active(Display* disp, DesktopSnapshot& out);
+
+    /* Updates each window's viewport and state to match its exterior, and
+     * rebuilds the occupancy index. */
+    void classify(DesktopSnapshot& snapshot);
+
+    /* fetch() followed by classify(), for commands which don't keep the
+     * snapshot around. Returns true on success, else false. */
+    bool fetch_classified(Display* disp, DesktopSnapshot& out);
+
+    /* Finds the nearest managed window in the given direction relative to
+     * 'from', using the windows in the snapshot.
+     * Returns false if the snapshot doesn't have any managed windows. */
+    bool neighbor(const DesktopSnapshot& snapshot, Window from, grid::POS dir,
+            Window& out);
+}
+
+#endif
@@ -28,4 +28,11 @@ struct Dimensions {
     unsigned long height;
 };
 
+inline bool operator==(const Dimensions& a, const Dimensions& b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+inline bool operator!=(const Dimensions& a, const Dimensions& b) {
+    return !(a == b);
+}
+
 #endif
@@ -17,22 +17,296 @@
 */
 
 #include "config.h"
+#include "core.h"
 #include "grid.h"
-#include "position.h"
+#include "history.h"
+#include "stats.h"
 #include "viewport.h"
 #include "window.h"
+#include "x11-util.h"
 
-bool grid::set_active(POS window) {
-    return window::select_activate(window);
+namespace {
+    /* The last move made while handling commands from a daemon snapshot.
+       Until the next snapshot shows it, the snapshot (and its prediction)
+       still has the window where it was, so later commands build on this
+       instead. */
+    struct LastMove {
+        LastMove() : generation(0), window(0) { }
+
+        unsigned long generation;// of the snapshot, 0 if none
+        Window window;
+        history::Entry to;
+    };
+    thread_local LastMove last_move;
+
+    /* Returns where the active window was last sent, if 'snapshot' doesn't
+       show it there yet, else NULL. */
+    const history::Entry* unseen_move(ActiveWindow& win, const DesktopSnapshot* snapshot) {
+        Window active;
+        if (snapshot == NULL || snapshot->generation == 0 ||
+                last_move.generation != snapshot->generation ||
+                !win.Id(active) || active != last_move.window) {
+            return NULL;
+        }
+        DEBUG("snapshot %lu doesn't show the last move yet", snapshot->generation);
+        return &last_move.to;
+    }
+
+    /* If 'from' is provided, the move is added to the window's history
+       (unless the window is already there, eg mright with one monitor). If
+       'snapshot' is provided, later commands using the same snapshot start
+       from where the window was sent. */
+    bool move(ActiveWindow& win, const State& next_state, const Dimensions& next_dim,
+            const history::Entry* from = NULL, const DesktopSnapshot* snapshot = NULL) {
+        if (!win.ReadyForResize()) {
+            /* the window is still redrawing from a previous resize. drop this one
+               rather than piling more work onto the client. */
+            LOG("Window is still redrawing. Ignoring move request.");
+            return true;
+        }
+
+        // move the window to next_dim
+        if (!win.DeShade() || !win.MoveResize(next_dim)) {
+            return false;
+        }
+        Window id;
+        if ((from != NULL || snapshot != NULL) && win.Id(id)) {
+            history::Entry to = { next_dim, next_state };
+            if (from != NULL && from->exterior != next_dim) {
+                history::record(id, *from, to);
+            }
+            if (snapshot != NULL && snapshot->generation != 0) {
+                last_move.generation = snapshot->generation;
+                last_move.window = id;
+                last_move.to = to;
+            }
+        }
+
+        if (next_state.pos == grid::POS_CENTER &&
+            next_state.mode == grid::MODE_THREE_COL_L) {
+            /* if we're going to be filling the screen anyway, just maximize
+               (do this after MoveResize so that viewport changes are respected) */
+            win.Maximize();// disregard failure
+        }
+        return true;
+    }
+
+    /* Returns the precomputed result for this command, or NULL if there isn't
+       one for the currently active window. */
+    const Target* predicted_target(ActiveWindow& win, const DesktopSnapshot& snapshot,
+            grid::POS gridpos, grid::POS monitor) {
+        const Prediction& prediction = snapshot.prediction;
+        Window active;
+        if (prediction.active == 0 || !win.Id(active) || active != prediction.active) {
+            return NULL;
+        }
+        const Target& target = prediction.targets[monitor][gridpos];
+        if (!target.valid) {
+            return NULL;
+        }
+        const WindowInfo* info = snapshot.active_info();
+        if (info != NULL) {
+            win.SetMargins(info->margin_width, info->margin_height);
+        }
+        DEBUG("predicted pos=%s monitor=%s -> %ldx %ldy %luw %luh",
+                pos_str(gridpos), pos_str(monitor),
+                target.dim.x, target.dim.y, target.dim.width, target.dim.height);
+        return &target;
+    }
+
+    /* Works out where an "undo" or "redo" command moves the window. */
+    bool history_target(Window win, grid::POS gridpos, history::Entry& out) {
+        bool redo = gridpos == grid::POS_REDO;
+        if (!(redo ? history::redo(win, out) : history::undo(win, out))) {
+            LOG("Nothing to %s for this window.", redo ? "redo" : "undo");
+            return false;
+        }
+        return true;
+    }
+
+    /* Moves the active window back (or forward) through its history, using
+       what's already known about it rather than asking X. */
+    bool move_history(ActiveWindow& win, grid::POS gridpos,
+            const DesktopSnapshot* snapshot) {
+        Window active;
+        history::Entry to;
+        if (!win.Id(active) || !history_target(active, gridpos, to)) {
+            return false;
+        }
+        const WindowInfo* info = (snapshot != NULL) ? snapshot->find(active) : NULL;
+        if (info != NULL) {
+            win.SetMargins(info->margin_width, info->margin_height);
+        }
+        win.DeFullscreen();// disregard failure
+        return move(win, to.state, to.exterior, NULL, snapshot);
+    }
+
+    /* Works out where a "gfree" command moves the window, and the index of
+       the viewport that it's moving to. */
+    bool free_target(const DesktopSnapshot& snapshot, const WindowInfo& info,
+            grid::POS monitor, State& state_out, Dimensions& dim_out,
+            size_t& viewport_out) {
+        const dim_list_t& viewports = snapshot.viewports;
+        if (info.viewport >= viewports.size()) {
+            return false;
+        }
+        neighbor::select(monitor, viewports, info.viewport, viewport_out);
+
+        // look for a cell near where the window would land on the new viewport
+        PositionCalc pcalc(info.exterior, info.hints);
+        Dimensions from = info.exterior;
+        if (viewport_out != info.viewport) {
+            pcalc.ViewportToDim(viewports[info.viewport], viewports[viewport_out], from);
+        }
+        if (!occupancy::nearest_free(snapshot, viewport_out, info, from, state_out)) {
+            LOG("No free cells left on this monitor. Ignoring move request.");
+            return false;
+        }
+        return pcalc.StateToDim(viewports[viewport_out], state_out, dim_out);
+    }
+
+    /* Activates the next window in the same cell as the active window. */
+    bool cycle_stack(const DesktopSnapshot* snapshot) {
+        Display* disp = x11_util::open_display();
+        if (disp == NULL) {
+            ERROR("unable to get display");
+            return false;
+        }
+        DesktopSnapshot fetched;
+        if (snapshot == NULL) {
+            if (!desktop::fetch_classified(disp, fetched)) {
+                x11_util::close_display(disp);
+                return false;
+            }
+            snapshot = &fetched;
+        }
+
+        Window active, next;
+        const WindowInfo* info;
+        bool ok = window::get_active(disp, active) &&
+            (info = snapshot->find(active)) != NULL;
+        if (ok && !occupancy::stack_next(*snapshot, *info, next)) {
+            LOG("No other windows share this window's cell.");
+            ok = false;
+        }
+        if (ok) {
+            ok = window::activate(disp, active, next);
+        }
+        x11_util::close_display(disp);
+        return ok;
+    }
+
+    /* Moves the active window to the nearest free cell. */
+    bool move_free(ActiveWindow& win, grid::POS monitor,
+            const DesktopSnapshot* snapshot) {
+        DesktopSnapshot fetched;
+        if (snapshot == NULL) {
+            Display* disp = x11_util::open_display();
+            if (disp == NULL) {
+                ERROR("unable to get display");
+                return false;
+            }
+            bool ok = desktop::fetch_classified(disp, fetched);
+            x11_util::close_display(disp);
+            if (!ok) {
+                return false;
+            }
+            snapshot = &fetched;
+        }
+
+        Window active;
+        if (!win.Id(active)) {
+            return false;
+        }
+        const WindowInfo* found = snapshot->find(active);
+        if (found == NULL || !found->managed) {
+            LOG("Active window is a desktop or dock. Ignoring move request.");
+            return false;
+        }
+        WindowInfo info = *found;
+        const history::Entry* unseen = unseen_move(win, snapshot);
+        if (unseen != NULL) {
+            info.exterior = unseen->exterior;
+            info.state = unseen->state;
+            info.viewport = core::active_viewport(snapshot->viewports, info.exterior);
+        }
+
+        State next_state;
+        Dimensions next_dim;
+        size_t next_viewport;
+        if (!free_target(*snapshot, info, monitor, next_state, next_dim, next_viewport)) {
+            return false;
+        }
+        win.SetMargins(info.margin_width, info.margin_height);
+        win.DeFullscreen();// disregard failure
+        history::Entry from = { info.exterior, info.state };
+        return move(win, next_state, next_dim, &from, snapshot);
+    }
+}
+
+bool grid::set_active(POS window, const DesktopSnapshot* snapshot) {
+    if (window == POS_STACK) {
+        return cycle_stack(snapshot);
+    }
+    return window::select_activate(window, snapshot);
 }
 
 bool grid::set_position(POS gridpos, POS monitor) {
+    return set_position(pos_list_t(1, gridpos), monitor);
+}
+
+bool grid::set_position(const pos_list_t& gridpos, POS monitor,
+        const DesktopSnapshot* snapshot) {
     // initializes to the currently active window
     ActiveWindow win;
 
+    if (gridpos.size() == 1 && gridpos[0] == POS_FREE) {
+        return move_free(win, monitor, snapshot);
+    }
+    if (gridpos.size() == 1 && (gridpos[0] == POS_UNDO || gridpos[0] == POS_REDO)) {
+        if (monitor != POS_CURRENT) {
+            ERROR("undo/redo can't be combined with a monitor");
+            return false;
+        }
+        return move_history(win, gridpos[0], snapshot);
+    }
+
+    // the prediction is out of date if we've already moved the window since
+    const history::Entry* unseen = unseen_move(win, snapshot);
+    if (snapshot != NULL && gridpos.size() == 1 && unseen == NULL) {
+        // if this command was already worked out, just do the move
+        const Target* target = predicted_target(win, *snapshot, gridpos[0], monitor);
+        if (target != NULL) {
+            stats::count(stats::COUNTER_CACHE_HITS);
+            win.DeFullscreen();// disregard failure
+            const WindowInfo* info = snapshot->active_info();
+            if (info == NULL) {
+                return move(win, target->state, target->dim, NULL, snapshot);
+            }
+            history::Entry from = { info->exterior, info->state };
+            return move(win, target->state, target->dim, &from, snapshot);
+        }
+    }
+    stats::count(stats::COUNTER_CACHE_MISSES);
+
     // get current window's dimensions
     Dimensions cur_window;
-    if (!win.Size(cur_window)) {
+    SizeHints hints;
+    /* whenever the snapshot knows the window, size it from there rather than
+       asking X, even without a prediction (eg it was activated by an earlier
+       command in the same run). predictions skip docks, so check for them */
+    Window active;
+    const WindowInfo* info = (snapshot != NULL && win.Id(active)) ? snapshot->find(active) : NULL;
+    if (info != NULL && !info->managed) {
+        LOG("Active window is a desktop or dock. Ignoring move request.");
+        return false;
+    }
+    if (info != NULL) {
+        // start from where the window was sent, rather than asking X mid-move
+        cur_window = (unseen != NULL) ? unseen->exterior : info->exterior;
+        hints = info->hints;
+        win.SetMargins(info->margin_width, info->margin_height);
+    } else if (!win.Size(cur_window, &hints)) {
         return false;
     }
 
@@ -44,7 +318,8 @@ bool grid::set_position(POS gridpos, POS monitor) {
 
     Dimensions cur_viewport, next_viewport;
     {
-        ViewportCalc vcalc(cur_window);
+        ViewportCalc vcalc(cur_window,
+                (snapshot != NULL) ? &snapshot->viewports : NULL);
         // cur_window + monitor -> cur_viewport + next_viewport
         if (!vcalc.Viewports(monitor, cur_viewport, next_viewport)) {
             return false;
@@ -53,37 +328,77 @@ bool grid::set_position(POS gridpos, POS monitor) {
 
     /* using the requested position and current dimensions,
        calculate and set new dimensions */
-    PositionCalc pcalc(cur_window);
+    State next_state;
+    Dimensions next_dim;
+    if (!core::place(cur_window, cur_viewport, next_viewport, gridpos,
+                    next_state, next_dim, hints)) {
+        return false;
+    }
+
+    history::Entry from = { cur_window, State() };
+    PositionCalc pcalc(cur_window, hints);
+    pcalc.CurState(cur_viewport, from.state);// left unknown on failure
+    return move(win, next_state, next_dim, &from, snapshot);
+}
 
-    State cur_state, next_state;
-    if (/* cur_viewport + cur_window -> cur_state */
-            !pcalc.CurState(cur_viewport, cur_state) ||
-            /* cur_state + pos -> next_state */
-            !pcalc.NextState(cur_state, gridpos, next_state)) {
+bool grid::set_position_cached(Display* disp, DesktopSnapshot& snapshot,
+        const pos_list_t& gridpos, POS monitor) {
+    win_list_t::iterator info = snapshot.windows.begin();
+    for (; info != snapshot.windows.end(); ++info) {
+        if (info->id == snapshot.active) {
+            break;
+        }
+    }
+    if (info == snapshot.windows.end() || snapshot.viewports.empty()) {
+        ERROR("active window %lu is unknown", snapshot.active);
+        return false;
+    }
+    if (!info->managed) {
+        LOG("Active window is a desktop or dock. Ignoring move request.");
         return false;
     }
 
+    State next_state;
     Dimensions next_dim;
-    if (next_state.pos == POS_UNKNOWN && next_state.mode == MODE_UNKNOWN) {
-        // window doesnt currently have a state, and user didn't specify one
-        pcalc.ViewportToDim(cur_viewport, next_viewport, next_dim);
+    size_t next_viewport;
+    // undo/redo only step through the history, they don't add to it
+    bool record = true;
+    if (gridpos.size() == 1 && (gridpos[0] == POS_UNDO || gridpos[0] == POS_REDO)) {
+        history::Entry to;
+        if (!history_target(info->id, gridpos[0], to)) {
+            return false;
+        }
+        next_state = to.state;
+        next_dim = to.exterior;
+        next_viewport = core::active_viewport(snapshot.viewports, next_dim);
+        record = false;
+    } else if (gridpos.size() == 1 && gridpos[0] == POS_FREE) {
+        if (!free_target(snapshot, *info, monitor, next_state, next_dim, next_viewport)) {
+            return false;
+        }
     } else {
-        // next_viewport + next_state -> next_dim
-        if (!pcalc.StateToDim(next_viewport, next_state, next_dim)) {
+        size_t cur_viewport = core::active_viewport(snapshot.viewports, info->exterior);
+        neighbor::select(monitor, snapshot.viewports, cur_viewport, next_viewport);
+        if (!core::place(info->exterior, snapshot.viewports[cur_viewport],
+                        snapshot.viewports[next_viewport], gridpos,
+                        next_state, next_dim, info->hints)) {
             return false;
         }
     }
 
-    // move the window to next_dim
-    if (!win.DeShade() || !win.MoveResize(next_dim)) {
+    ActiveWindow win(disp, info->id);
+    win.SetMargins(info->margin_width, info->margin_height);
+    win.DeFullscreen();// disregard failure
+    history::Entry from = { info->exterior, info->state };
+    if (!move(win, next_state, next_dim, record ? &from : NULL)) {
         return false;
     }
 
-    if (next_state.pos == POS_CENTER &&
-        next_state.mode == MODE_THREE_COL_L) {
-        /* if we're going to be filling the screen anyway, just maximize
-           (do this after MoveResize so that viewport changes are respected) */
-        win.Maximize();// disregard failure
-    }
+    // assume the WM goes along with it, so that later commands can build on it
+    WindowInfo before = *info;
+    info->exterior = next_dim;
+    info->viewport = next_viewport;
+    info->state = next_state;
+    occupancy::move(snapshot, before, *info);
     return true;
 }
@@ -19,17 +19,33 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "desktop.h"
 #include "pos.h"
 
 namespace grid {
     /* Selects and makes active the window in the specified direction relative
-     * to the currently active window. */
-    bool set_active(POS window);
+     * to the currently active window. If 'snapshot' is provided, windows and
+     * viewports are taken from it rather than being fetched. */
+    bool set_active(POS window, const DesktopSnapshot* snapshot = NULL);
 
     /* Selects the active window and moves/resizes it to the requested
      * position/monitor, according to its current state.
      * Returns true if successful, false otherwise. */
     bool set_position(POS gridpos, POS monitor);
+
+    /* Like set_position, except that each of the positions is applied in
+     * order to the window's state, and only the final result is moved to.
+     * Equivalent to calling set_position once for each position, but with
+     * a single move at the end. */
+    bool set_position(const pos_list_t& gridpos, POS monitor,
+            const DesktopSnapshot* snapshot = NULL);
+
+    /* Like set_position, except that the active window's size and the
+     * viewports are taken from 'snapshot' without any round trips, and the
+     * snapshot is updated to reflect the window's new position. The move is
+     * sent over 'disp' but not flushed. */
+    bool set_position_cached(Display* disp, DesktopSnapshot& snapshot,
+            const pos_list_t& gridpos, POS monitor);
 }
 
 #endif
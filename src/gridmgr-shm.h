@@ -0,0 +1,255 @@
+#ifndef GRIDMGR_SHM_H
+#define GRIDMGR_SHM_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* C API for reading the window table which a running gridmgr daemon publishes
+ * to shared memory. Readers never talk to X or to the daemon.
+ *
+ * Example:
+ *
+ *   const struct gridmgr_shm* shm = gridmgr_shm_open();
+ *   struct gridmgr_shm copy;
+ *   uint64_t seq;
+ *   do {
+ *       if (gridmgr_shm_read_begin(shm, &seq) != 0) {
+ *           ... nothing published yet, or the daemon is gone
+ *       }
+ *       memcpy(&copy, shm, sizeof(copy));
+ *   } while (gridmgr_shm_read_retry(shm, seq));
+ *   ...
+ *   gridmgr_shm_close(shm);
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GRIDMGR_SHM_MAGIC 0x47524d53 /* "GRMS" */
+#define GRIDMGR_SHM_VERSION 1
+
+#define GRIDMGR_SHM_MAX_VIEWPORTS 16
+#define GRIDMGR_SHM_MAX_WINDOWS 1024
+
+/* gridmgr_shm_window.flags */
+#define GRIDMGR_SHM_MANAGED 0x1 /* not a dock, desktop, or menu */
+#define GRIDMGR_SHM_ACTIVE 0x2 /* the active window */
+
+/* gridmgr_shm.flags */
+#define GRIDMGR_SHM_TRUNCATED 0x1 /* more windows/viewports than would fit */
+
+/* gridmgr_shm_window.pos: where the window is on its viewport's grid */
+#define GRIDMGR_SHM_POS_UNKNOWN 0 /* not on the grid */
+#define GRIDMGR_SHM_POS_UP_LEFT 2
+#define GRIDMGR_SHM_POS_UP_CENTER 3
+#define GRIDMGR_SHM_POS_UP_RIGHT 4
+#define GRIDMGR_SHM_POS_LEFT 5
+#define GRIDMGR_SHM_POS_CENTER 6
+#define GRIDMGR_SHM_POS_RIGHT 7
+#define GRIDMGR_SHM_POS_DOWN_LEFT 8
+#define GRIDMGR_SHM_POS_DOWN_CENTER 9
+#define GRIDMGR_SHM_POS_DOWN_RIGHT 10
+
+/* gridmgr_shm_window.mode: how the viewport's grid is divided */
+#define GRIDMGR_SHM_MODE_UNKNOWN 0 /* not on the grid */
+#define GRIDMGR_SHM_MODE_TWO_COL 1 /* 2x2 */
+#define GRIDMGR_SHM_MODE_THREE_COL_S 2 /* 3x2, each position filling one column */
+#define GRIDMGR_SHM_MODE_THREE_COL_L 3 /* 3x2, sides filling two columns and center filling all three */
+
+/* How long gridmgr_shm_read_begin() waits for an update to finish. */
+#define GRIDMGR_SHM_WAIT_MS 100
+
+struct gridmgr_shm_rect {
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct gridmgr_shm_window {
+    uint64_t id;
+    /* exterior size/position, including any frame */
+    struct gridmgr_shm_rect exterior;
+    /* _NET_WM_DESKTOP, or -1 for all desktops/unknown */
+    int32_t desktop;
+    /* grid position/mode on its viewport, see GRIDMGR_SHM_POS_* and
+       GRIDMGR_SHM_MODE_* */
+    uint16_t pos;
+    uint16_t mode;
+    uint32_t flags;
+    /* index into viewports */
+    uint32_t viewport;
+};
+
+struct gridmgr_shm {
+    uint32_t magic;
+    uint32_t version;
+    /* odd while the daemon is writing, see gridmgr_shm_read_begin() */
+    uint64_t seq;
+    /* incremented with each update */
+    uint64_t generation;
+    uint64_t active;
+    uint32_t flags;
+    uint32_t viewport_count;
+    uint32_t window_count;
+    /* the daemon's pid, for checking whether it's still around */
+    uint32_t pid;
+    /* with struts trimmed */
+    struct gridmgr_shm_rect viewports[GRIDMGR_SHM_MAX_VIEWPORTS];
+    /* in _NET_CLIENT_LIST order */
+    struct gridmgr_shm_window windows[GRIDMGR_SHM_MAX_WINDOWS];
+};
+
+/* Writes 'display' (eg ":0" or ":0.1", where ":0.0" is the same as ":0") into
+ * 'out' the way that it appears in the names of the daemon's socket and
+ * shared memory, with anything other than letters and digits replaced by
+ * '_'. Returns 0 on success, or -1 if 'display' is empty or 'out' is too
+ * small. */
+static inline int gridmgr_display_id(const char* display, char* out, size_t out_size) {
+    const char* end;
+    const char* colon;
+    size_t len = 0;
+    if (display == NULL || display[0] == '\0') {
+        return -1;
+    }
+    /* screen 0 is the default, leave it off */
+    end = display + strlen(display);
+    colon = strrchr(display, ':');
+    if (colon != NULL && end - display >= 2 && strcmp(end - 2, ".0") == 0 &&
+            strchr(colon, '.') == end - 2) {
+        end -= 2;
+    }
+    for (; display != end && len + 1 < out_size; ++display, ++len) {
+        char c = *display;
+        out[len] = ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                (c >= '0' && c <= '9')) ? c : '_';
+    }
+    if (display != end || len >= out_size) {
+        return -1;
+    }
+    out[len] = '\0';
+    return 0;
+}
+
+/* Writes the shm_open() name for the current user and the given display
+ * into 'out'. Returns 0 on success, or -1 if 'display' is empty or 'out' is
+ * too small. */
+static inline int gridmgr_shm_name_for(const char* display, char* out, size_t out_size) {
+    size_t len = snprintf(out, out_size, "/gridmgr-%u-", (unsigned int)getuid());
+    if (len >= out_size) {
+        return -1;
+    }
+    return gridmgr_display_id(display, out + len, out_size - len);
+}
+
+/* Like gridmgr_shm_name_for(), using $DISPLAY. */
+static inline int gridmgr_shm_name(char* out, size_t out_size) {
+    return gridmgr_shm_name_for(getenv("DISPLAY"), out, out_size);
+}
+
+/* Maps the daemon's table read-only. Returns NULL if no daemon is publishing
+ * one, or if it's an incompatible version. */
+static inline const struct gridmgr_shm* gridmgr_shm_open(void) {
+    char name[128];
+    int fd;
+    struct stat st;
+    void* ptr;
+    if (gridmgr_shm_name(name, sizeof(name)) != 0) {
+        return NULL;
+    }
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    /* Only trust a table the daemon made: owned by us, private, full size. */
+    if (fstat(fd, &st) != 0 || st.st_uid != getuid() ||
+            (st.st_mode & (S_IRWXG | S_IRWXO)) != 0 ||
+            st.st_size < (off_t)sizeof(struct gridmgr_shm)) {
+        close(fd);
+        return NULL;
+    }
+    ptr = mmap(NULL, sizeof(struct gridmgr_shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return NULL;
+    }
+    if (((const struct gridmgr_shm*)ptr)->magic != GRIDMGR_SHM_MAGIC ||
+            ((const struct gridmgr_shm*)ptr)->version != GRIDMGR_SHM_VERSION) {
+        munmap(ptr, sizeof(struct gridmgr_shm));
+        return NULL;
+    }
+    return (const struct gridmgr_shm*)ptr;
+}
+
+static inline void gridmgr_shm_close(const struct gridmgr_shm* shm) {
+    munmap((void*)shm, sizeof(struct gridmgr_shm));
+}
+
+/* Returns nonzero if the daemon which published the table is still running. */
+static inline int gridmgr_shm_alive(const struct gridmgr_shm* shm) {
+    return shm->pid != 0 && (kill((pid_t)shm->pid, 0) == 0 || errno == EPERM);
+}
+
+/* Seqlock read: call gridmgr_shm_read_begin(), copy out whatever's needed,
+ * then repeat if gridmgr_shm_read_retry() returns nonzero.
+ *
+ * Updates take microseconds, so this spins briefly and then sleeps. Returns
+ * 0 with the sequence number in 'seq_out', or -1 if the table has been
+ * mid-update for GRIDMGR_SHM_WAIT_MS: either the daemon hasn't published
+ * anything yet, or it stopped partway through an update. */
+static inline int gridmgr_shm_read_begin(const struct gridmgr_shm* shm, uint64_t* seq_out) {
+    struct timespec nap = { 0, 1000000 };/* 1ms */
+    int spins = 0, naps = 0;
+    while ((*seq_out = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE)) & 1) {
+        /* daemon is mid-update */
+        if (++spins < 1000) {
+            sched_yield();
+            continue;
+        }
+        if (naps++ >= GRIDMGR_SHM_WAIT_MS || !gridmgr_shm_alive(shm)) {
+            return -1;
+        }
+        nanosleep(&nap, NULL);
+    }
+    return 0;
+}
+
+static inline int gridmgr_shm_read_retry(const struct gridmgr_shm* shm, uint64_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&shm->seq, __ATOMIC_RELAXED) != seq;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "history.h"
+
+#define HISTORY_WINDOWS 32
+#define HISTORY_DEPTH 16
+
+namespace {
+    /* A ring buffer of one window's positions. */
+    struct Timeline {
+        Window win;// 0 if unused
+        unsigned long last_used;
+        history::Entry entries[HISTORY_DEPTH];
+        size_t first, count;
+        // offset from 'first' of where the window is now
+        size_t cursor;
+    };
+
+    struct Table {
+        Timeline timelines[HISTORY_WINDOWS];
+        unsigned long tick;
+    };
+
+    // zero-initialized, like any other static
+    thread_local Table table;
+
+    inline history::Entry& at(Timeline& timeline, size_t offset) {
+        return timeline.entries[(timeline.first + offset) % HISTORY_DEPTH];
+    }
+
+    /* Returns the window's timeline, or NULL if it doesn't have one and
+       'create' is false. New timelines replace the least recently used. */
+    Timeline* find(Window win, bool create) {
+        Timeline* oldest = &table.timelines[0];
+        for (size_t i = 0; i < HISTORY_WINDOWS; ++i) {
+            Timeline& timeline = table.timelines[i];
+            if (timeline.win == win && win != 0) {
+                timeline.last_used = ++table.tick;
+                return &timeline;
+            }
+            if (timeline.last_used < oldest->last_used) {
+                oldest = &timeline;
+            }
+        }
+        if (!create) {
+            return NULL;
+        }
+        if (oldest->win != 0) {
+            DEBUG("forgetting history of window %lu", oldest->win);
+        }
+        oldest->win = win;
+        oldest->last_used = ++table.tick;
+        oldest->first = 0;
+        oldest->count = 0;
+        oldest->cursor = 0;
+        return oldest;
+    }
+
+    void push(Timeline& timeline, const history::Entry& entry) {
+        // anything after the current position had been undone, drop it
+        if (timeline.count != 0) {
+            timeline.count = timeline.cursor + 1;
+        }
+        if (timeline.count == HISTORY_DEPTH) {
+            // full, drop the oldest
+            timeline.first = (timeline.first + 1) % HISTORY_DEPTH;
+            --timeline.count;
+        }
+        at(timeline, timeline.count) = entry;
+        timeline.cursor = timeline.count;
+        ++timeline.count;
+    }
+}
+
+void history::record(Window win, const Entry& from, const Entry& to) {
+    Timeline* timeline = find(win, true);
+    /* the window may have been moved by something else since gridmgr last
+       put it somewhere, in which case that's where an undo should go */
+    if (timeline->count == 0 ||
+            at(*timeline, timeline->cursor).exterior != from.exterior) {
+        push(*timeline, from);
+    }
+    push(*timeline, to);
+    DEBUG("window %lu has %lu positions in its history", win, timeline->count);
+}
+
+bool history::undo(Window win, Entry& out) {
+    Timeline* timeline = find(win, false);
+    if (timeline == NULL || timeline->count == 0 || timeline->cursor == 0) {
+        return false;
+    }
+    --timeline->cursor;
+    out = at(*timeline, timeline->cursor);
+    return true;
+}
+
+bool history::redo(Window win, Entry& out) {
+    Timeline* timeline = find(win, false);
+    if (timeline == NULL || timeline->cursor + 1 >= timeline->count) {
+        return false;
+    }
+    ++timeline->cursor;
+    out = at(*timeline, timeline->cursor);
+    return true;
+}
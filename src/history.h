@@ -0,0 +1,54 @@
+#ifndef GRIDMGR_HISTORY_H
+#define GRIDMGR_HISTORY_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <X11/Xlib.h>
+
+#include "dimensions.h"
+#include "position.h"
+
+/* Where gridmgr has recently put each window, so that its moves can be undone
+ * and redone without asking X where anything is.
+ *
+ * Each window has a short timeline of positions. Moving the window adds the
+ * position it came from (unless the timeline already ends there) and the one
+ * it went to, replacing anything that had been undone. Undo and redo step
+ * back and forth along the timeline. Only the most recently moved windows are
+ * kept, each with a fixed number of positions, so nothing is allocated.
+ *
+ * The history belongs to the calling thread: each screen served by the daemon
+ * has its own, and without the daemon it only lasts for one invocation. */
+namespace history {
+    struct Entry {
+        Dimensions exterior;
+        State state;
+    };
+
+    /* Notes that 'win' was moved from 'from' to 'to'. */
+    void record(Window win, const Entry& from, const Entry& to);
+
+    /* Steps back through the window's timeline, producing where it should be
+     * moved to. Returns false if there's nothing to undo. */
+    bool undo(Window win, Entry& out);
+    /* The opposite of undo(). Returns false if there's nothing to redo. */
+    bool redo(Window win, Entry& out);
+}
+
+#endif
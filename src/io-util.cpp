@@ -0,0 +1,39 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "io-util.h"
+
+bool io_util::write_all(int fd, const void* buf, size_t size, bool socket) {
+    const char* ptr = (const char*)buf;
+    while (size > 0) {
+        ssize_t wrote = socket ? send(fd, ptr, size, MSG_NOSIGNAL) : write(fd, ptr, size);
+        if (wrote < 0 && errno == EINTR) {
+            continue;
+        }
+        if (wrote <= 0) {
+            return false;
+        }
+        ptr += wrote;
+        size -= wrote;
+    }
+    return true;
+}
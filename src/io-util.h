@@ -0,0 +1,31 @@
+#ifndef GRIDMGR_IO_UTIL_H
+#define GRIDMGR_IO_UTIL_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+
+namespace io_util {
+    /* Writes all of 'buf' to 'fd', retrying on short writes and EINTR.
+     * Sockets should set 'socket', which sends with MSG_NOSIGNAL so that a
+     * closed peer is an error rather than a SIGPIPE. Returns false on error. */
+    bool write_all(int fd, const void* buf, size_t size, bool socket = false);
+}
+
+#endif
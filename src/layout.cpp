@@ -0,0 +1,307 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "desktop.h"
+#include "io-util.h"
+#include "layout.h"
+#include "window.h"
+#include "x11-util.h"
+
+namespace {
+    /* Gets the path to the named layout, creating its directory if 'create'. */
+    bool layout_path(const char* name, bool create, std::string& out) {
+        if (name[0] == '\0' || name[0] == '.' || strchr(name, '/') != NULL) {
+            ERROR("invalid layout name: '%s'", name);
+            return false;
+        }
+
+        std::string dir;
+        if (!config::user_dir("layouts", create, dir)) {
+            return false;
+        }
+        out = dir + "/" + name + ".layout";
+        return true;
+    }
+
+    void to_rect(const Dimensions& dim, struct layout_rect& out) {
+        out.x = dim.x;
+        out.y = dim.y;
+        out.width = dim.width;
+        out.height = dim.height;
+    }
+
+    void from_rect(const struct layout_rect& rect, Dimensions& out) {
+        out.x = rect.x;
+        out.y = rect.y;
+        out.width = rect.width;
+        out.height = rect.height;
+    }
+
+    void copy_str(const std::string& str, char* out, size_t out_size) {
+        strncpy(out, str.c_str(), out_size - 1);
+        out[out_size - 1] = '\0';
+    }
+
+    /* Matches a saved window with a current one. The fields may fill their
+     * whole arrays when read back from a file. */
+    std::string make_key(const char* wm_class, const char* role) {
+        return std::string(wm_class, strnlen(wm_class, GRIDMGR_LAYOUT_CLASS_LEN)) + '\0' +
+            std::string(role, strnlen(role, GRIDMGR_LAYOUT_ROLE_LEN));
+    }
+
+    /* Gets the managed windows which have a class, with each class as
+       "instance.class" and its role. Takes two round trips for all of them. */
+    void get_keys(Display* disp, const DesktopSnapshot& snapshot,
+            std::vector<const WindowInfo*>& out_wins,
+            std::vector<std::string>& out_classes, std::vector<std::string>& out_roles) {
+        std::vector<const WindowInfo*> managed;
+        std::vector<Window> ids;
+        for (win_list_t::const_iterator iter = snapshot.windows.begin();
+             iter != snapshot.windows.end(); ++iter) {
+            if (iter->managed) {
+                managed.push_back(&*iter);
+                ids.push_back(iter->id);
+            }
+        }
+        std::vector<window::Class> classes;
+        if (!ids.empty()) {
+            window::get_classes(disp, &ids[0], ids.size(), classes);
+        }
+        for (size_t i = 0; i < classes.size(); ++i) {
+            if (classes[i].found) {
+                out_wins.push_back(managed[i]);
+                out_classes.push_back(classes[i].instance + '.' + classes[i].wm_class);
+                out_roles.push_back(classes[i].role);
+            }
+        }
+    }
+
+    /* Works out where a saved window goes on the current viewports. */
+    bool saved_to_dim(const struct layout_window& saved,
+            const struct layout_rect* saved_viewports, size_t saved_viewport_count,
+            const dim_list_t& viewports, const SizeHints& hints, Dimensions& out) {
+        Dimensions exterior;
+        from_rect(saved.exterior, exterior);
+        if (saved.viewport >= saved_viewport_count) {
+            return false;
+        }
+        Dimensions saved_viewport;
+        from_rect(saved_viewports[saved.viewport], saved_viewport);
+        // the same monitor if it's still around, otherwise the first one
+        const Dimensions& viewport = (saved.viewport < viewports.size()) ?
+            viewports[saved.viewport] : viewports[0];
+
+        PositionCalc pcalc(exterior, hints);
+        State state((grid::POS)saved.pos, (grid::MODE)saved.mode);
+        if (state.pos != grid::POS_UNKNOWN && state.mode != grid::MODE_UNKNOWN &&
+                pcalc.StateToDim(viewport, state, out)) {
+            // was on the grid, keep it on the grid
+            return true;
+        }
+        if (saved_viewport == viewport) {
+            out = exterior;
+        } else {
+            pcalc.ViewportToDim(saved_viewport, viewport, out);
+        }
+        return true;
+    }
+}
+
+bool layout::save(const char* name) {
+    std::string path;
+    if (!layout_path(name, true, path)) {
+        return false;
+    }
+
+    Display* disp = x11_util::open_display();
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+    DesktopSnapshot snapshot;
+    if (!desktop::fetch_classified(disp, snapshot)) {
+        x11_util::close_display(disp);
+        return false;
+    }
+
+    std::vector<struct layout_rect> viewports(snapshot.viewports.size());
+    for (size_t i = 0; i < viewports.size(); ++i) {
+        to_rect(snapshot.viewports[i], viewports[i]);
+    }
+    std::vector<const WindowInfo*> infos;
+    std::vector<std::string> classes, roles;
+    get_keys(disp, snapshot, infos, classes, roles);
+    std::vector<struct layout_window> windows;
+    for (size_t i = 0; i < infos.size(); ++i) {
+        struct layout_window win;
+        memset(&win, 0, sizeof(win));
+        copy_str(classes[i], win.wm_class, sizeof(win.wm_class));
+        copy_str(roles[i], win.role, sizeof(win.role));
+        to_rect(infos[i]->exterior, win.exterior);
+        win.viewport = infos[i]->viewport;
+        win.pos = infos[i]->state.pos;
+        win.mode = infos[i]->state.mode;
+        win.desktop = infos[i]->desktop;
+        windows.push_back(win);
+    }
+    x11_util::close_display(disp);
+
+    struct layout_header header;
+    header.magic = GRIDMGR_LAYOUT_MAGIC;
+    header.version = GRIDMGR_LAYOUT_VERSION;
+    header.viewport_count = viewports.size();
+    header.window_count = windows.size();
+
+    // write to a temp file first, so that a failed save doesn't clobber the old one
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ERROR("unable to open %s: %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = io_util::write_all(fd, &header, sizeof(header)) &&
+        (viewports.empty() ||
+                io_util::write_all(fd, &viewports[0], viewports.size() * sizeof(viewports[0]))) &&
+        (windows.empty() ||
+                io_util::write_all(fd, &windows[0], windows.size() * sizeof(windows[0])));
+    if (close(fd) != 0 || !ok) {
+        ERROR("unable to write %s: %s", tmp_path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        ERROR("unable to replace %s: %s", path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    LOG("saved %lu windows to %s", windows.size(), path.c_str());
+    return true;
+}
+
+bool layout::restore(const char* name) {
+    std::string path;
+    if (!layout_path(name, false, path)) {
+        return false;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        ERROR("unable to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct layout_header)) {
+        ERROR("%s is too small to be a layout", path.c_str());
+        close(fd);
+        return false;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        ERROR("unable to map %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    const struct layout_header* header = (const struct layout_header*)map;
+    const struct layout_rect* saved_viewports = (const struct layout_rect*)(header + 1);
+    const struct layout_window* saved_windows =
+        (const struct layout_window*)(saved_viewports + header->viewport_count);
+    if (header->magic != GRIDMGR_LAYOUT_MAGIC || header->version != GRIDMGR_LAYOUT_VERSION ||
+            (size_t)st.st_size != sizeof(struct layout_header) +
+            header->viewport_count * sizeof(struct layout_rect) +
+            header->window_count * sizeof(struct layout_window)) {
+        ERROR("%s isn't a valid layout", path.c_str());
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    Display* disp = x11_util::open_display();
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        munmap(map, st.st_size);
+        return false;
+    }
+    DesktopSnapshot snapshot;
+    if (!desktop::fetch_classified(disp, snapshot) || snapshot.viewports.empty()) {
+        x11_util::close_display(disp);
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    /* look up every class first, then send all the moves together. the
+       classes are cut short the same way that save() cuts them. */
+    std::vector<const WindowInfo*> wins;
+    std::vector<std::string> classes, roles;
+    get_keys(disp, snapshot, wins, classes, roles);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < wins.size(); ++i) {
+        struct layout_window current;
+        copy_str(classes[i], current.wm_class, sizeof(current.wm_class));
+        copy_str(roles[i], current.role, sizeof(current.role));
+        keys.push_back(make_key(current.wm_class, current.role));
+    }
+
+    bool ok = true;
+    size_t restored = 0;
+    std::vector<bool> matched(wins.size(), false);
+    for (size_t s = 0; s < header->window_count; ++s) {
+        const struct layout_window& saved = saved_windows[s];
+        std::string key = make_key(saved.wm_class, saved.role);
+        for (size_t w = 0; w < wins.size(); ++w) {
+            if (matched[w] || keys[w] != key) {
+                continue;
+            }
+            matched[w] = true;
+
+            Dimensions dim;
+            if (!saved_to_dim(saved, saved_viewports, header->viewport_count,
+                            snapshot.viewports, wins[w]->hints, dim)) {
+                break;
+            }
+            ActiveWindow win(disp, wins[w]->id);
+            win.SetMargins(wins[w]->margin_width, wins[w]->margin_height);
+            win.DeFullscreen();// disregard failure
+            if (!win.DeShade() || !win.MoveResize(dim)) {
+                ok = false;
+            }
+            if (saved.desktop != wins[w]->desktop) {
+                window::set_desktop(disp, wins[w]->id, saved.desktop);
+            }
+            ++restored;
+            break;
+        }
+    }
+    // the header goes away with the mapping
+    unsigned int saved_count = header->window_count;
+    munmap(map, st.st_size);
+
+    x11_util::close_display(disp);// flushes the moves
+    LOG("restored %lu of %u saved windows", restored, saved_count);
+    return ok;
+}
@@ -0,0 +1,77 @@
+#ifndef GRIDMGR_LAYOUT_H
+#define GRIDMGR_LAYOUT_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+
+/* Saved layouts are a header, followed by 'viewport_count' rects, followed by
+ * 'window_count' windows. Everything is fixed size, so the file may be mapped
+ * and indexed directly. */
+
+#define GRIDMGR_LAYOUT_MAGIC 0x47524d4c // "GRML"
+#define GRIDMGR_LAYOUT_VERSION 1
+
+#define GRIDMGR_LAYOUT_CLASS_LEN 64
+#define GRIDMGR_LAYOUT_ROLE_LEN 32
+
+struct layout_rect {
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct layout_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t viewport_count;
+    uint32_t window_count;
+};
+
+struct layout_window {
+    // WM_CLASS as "instance.class" and WM_WINDOW_ROLE, nul-terminated
+    char wm_class[GRIDMGR_LAYOUT_CLASS_LEN];
+    char role[GRIDMGR_LAYOUT_ROLE_LEN];
+    // exterior size/position, including any frame
+    struct layout_rect exterior;
+    // index into the saved viewports
+    uint32_t viewport;
+    // grid::POS/grid::MODE on that viewport, see position.h
+    uint16_t pos;
+    uint16_t mode;
+    // _NET_WM_DESKTOP, or -1 for all desktops/unknown
+    int32_t desktop;
+};
+
+namespace layout {
+    /* Saves the size, position, and desktop of every window to a layout file
+     * named 'name', under $XDG_CONFIG_HOME/gridmgr/layouts/.
+     * Returns true on success, else false. */
+    bool save(const char* name);
+
+    /* Moves each window to where a window of the same class and role was
+     * when 'name' was saved. Windows are matched in order, so several windows
+     * of the same class each get their own spot. If the monitors have changed
+     * since then, windows are placed proportionally on the new monitors.
+     * Returns true on success, else false. */
+    bool restore(const char* name);
+}
+
+#endif
@@ -22,10 +22,26 @@
 #include <errno.h>
 #include <time.h>
 
+#include <string>
+#include <vector>
+
+#include "async-log.h"
+#include "backend-fake.h"
+#include "backend-replay.h"
+#include "batch.h"
+#include "command.h"
 #include "config.h"
-#include "grid.h"
+#include "core-hooks.h"
+#include "layout.h"
+#include "query.h"
+#include "runtime-cache.h"
+#include "server.h"
+#include "tile.h"
+#include "trace.h"
+#include "x11-util.h"
 
 #define TIMESTR_MAX 128 // arbitrarily large
+#define FAKE_MONITORS 2 // side by side, for --fake
 
 static void syntax(char* appname) {
     PRINT_HELP("");
@@ -75,46 +91,79 @@ static void syntax(char* appname) {
     PRINT_HELP(" | gdleft |  gdown  | gdright | ");
     PRINT_HELP("  -------- --------- ---------  ");
     PRINT_HELP("");
+    PRINT_HELP("Stacks and free space:");
+    PRINT_HELP("  wstack  Activate the next window in the same grid position.");
+    PRINT_HELP("  gfree   Move to the nearest grid position with no windows.");
+    PRINT_HELP("");
+    PRINT_HELP("Undo (needs --daemon, or within a --batch):");
+    PRINT_HELP("  undo    Put the active window back where it was before its last move.");
+    PRINT_HELP("  redo    Put it back where it was before the last undo.");
+    PRINT_HELP("");
     PRINT_HELP("Options:");
     PRINT_HELP("  -h/--help        This help text.");
     PRINT_HELP("  -v/--verbose     Show verbose output.");
+    PRINT_HELP("  --batch <file>   Run the commands in <file> (or - for stdin),");
+    PRINT_HELP("                   one per line, eg \"wright gleft\".");
+    PRINT_HELP("  --daemon         Stay running and handle the commands of other");
+    PRINT_HELP("                   gridmgr invocations, coalescing held keys.");
+    PRINT_HELP("  --display <name> Use display <name> rather than $DISPLAY. With --daemon,");
+    PRINT_HELP("                   may be repeated to serve several displays at once.");
     PRINT_HELP("  --log <file>     Append any output to <file>.");
+    PRINT_HELP("  --query          Print the windows and monitors as JSON.");
+    PRINT_HELP("  --stats          Print the running daemon's command/stage latencies");
+    PRINT_HELP("                   (p50/p99/max) and counters.");
+    PRINT_HELP("  --save <name>    Save where every window is, as layout <name>.");
+    PRINT_HELP("  --restore <name> Put windows back where they were in layout <name>.");
+    PRINT_HELP("  --bsp <op>       Add the active window to a recursively split layout");
+    PRINT_HELP("                   (insert, hsplit, vsplit), or remove it (remove).");
+    PRINT_HELP("  --trace <file>   Append how long each step took to <file>, for");
+    PRINT_HELP("                   viewing in Perfetto or chrome://tracing.");
+    PRINT_HELP("  --record <file>  Save every reply X gives the command to <file>.");
+    PRINT_HELP("  --replay <file>  Answer the command's queries from <file> instead of X,");
+    PRINT_HELP("                   to reproduce a --record run on another desktop.");
+    PRINT_HELP("  --fake <count>   Run against a simulated desktop with <count> windows");
+    PRINT_HELP("                   instead of X, eg to time --batch with many windows.");
+    PRINT_HELP("  --tile <layout>  Arrange all windows on the current monitor into");
+    PRINT_HELP("                   2col, 3col, <cols>x<rows> (eg 4x3), or auto.");
+#ifdef USE_XSYNC
+    PRINT_HELP("  --sync           Skip moves while the window is still redrawing.");
+#endif
+#ifdef COUNT_ALLOCS
+    PRINT_HELP("  --check-allocs <file>");
+    PRINT_HELP("                   Run the commands in <file> twice the way the daemon");
+    PRINT_HELP("                   would, failing if any allocate the second time.");
+#endif
     PRINT_HELP("");
 }
 
-static bool strsub_to_pos(const char* arg, grid::POS& out, bool center_is_valid) {
-    if (strcmp(arg, "uleft") == 0) {
-        out = grid::POS_UP_LEFT;
-    } else if (strcmp(arg, "up") == 0) {
-        out = grid::POS_UP_CENTER;
-    } else if (strcmp(arg, "uright") == 0) {
-        out = grid::POS_UP_RIGHT;
-
-    } else if (strcmp(arg, "left") == 0) {
-        out = grid::POS_LEFT;
-    } else if (center_is_valid && strcmp(arg, "center") == 0) {
-        out = grid::POS_CENTER;
-    } else if (strcmp(arg, "right") == 0) {
-        out = grid::POS_RIGHT;
-
-    } else if (strcmp(arg, "dleft") == 0) {
-        out = grid::POS_DOWN_LEFT;
-    } else if (strcmp(arg, "down") == 0) {
-        out = grid::POS_DOWN_CENTER;
-    } else if (strcmp(arg, "dright") == 0) {
-        out = grid::POS_DOWN_RIGHT;
-
-    } else {
-        return false;
-    }
-    return true;
-}
-
 namespace {
-    enum CMD { CMD_UNKNOWN, CMD_HELP, CMD_POSITION };
+    enum CMD { CMD_UNKNOWN, CMD_HELP, CMD_POSITION, CMD_DAEMON, CMD_QUERY, CMD_BATCH, CMD_TILE, CMD_BSP,
+        CMD_SAVE, CMD_RESTORE, CMD_STATS };
     CMD run_cmd = CMD_UNKNOWN;
-    grid::POS gridpos = grid::POS_CURRENT,
-        monitor = grid::POS_CURRENT, window = grid::POS_CURRENT;
+    Command cmd;
+    const char* batch_path = NULL;
+#ifdef COUNT_ALLOCS
+    bool check_allocs = false;// with CMD_BATCH
+#endif
+    tile::Layout tile_layout;
+    tile::BSP_OP bsp_op;
+    const char* layout_name = NULL;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    std::vector<std::string> displays;
+
+    /* Whether commands may go through (or be) the daemon, which always
+       uses the real display. */
+    bool use_daemon() {
+        return !x11_util::is_fake();
+    }
+
+    /* Whether a single command may be handed to the daemon. The daemon runs
+       with its own --sync and -v, so commands which ask for either are run
+       here instead, where they're honored. */
+    bool send_to_daemon() {
+        return use_daemon() && !config::sync_enabled && !config::debug_enabled;
+    }
 }
 
 static bool parse_config(int argc, char* argv[]) {
@@ -128,6 +177,25 @@ static bool parse_config(int argc, char* argv[]) {
             {"help", 0, NULL, 'h'},
             {"verbose", 0, NULL, 'v'},
             {"log", required_argument, NULL, 'l'},
+            {"batch", required_argument, NULL, 'b'},
+            {"daemon", 0, NULL, 'd'},
+            {"display", required_argument, NULL, 'D'},
+            {"query", 0, NULL, 'q'},
+            {"stats", 0, NULL, 'x'},
+            {"tile", required_argument, NULL, 't'},
+            {"trace", required_argument, NULL, 'T'},
+            {"bsp", required_argument, NULL, 'B'},
+            {"save", required_argument, NULL, 'S'},
+            {"restore", required_argument, NULL, 'R'},
+            {"record", required_argument, NULL, 'e'},
+            {"replay", required_argument, NULL, 'y'},
+            {"fake", required_argument, NULL, 'F'},
+#ifdef USE_XSYNC
+            {"sync", 0, NULL, 's'},
+#endif
+#ifdef COUNT_ALLOCS
+            {"check-allocs", required_argument, NULL, 'a'},
+#endif
             {0,0,0,0}
         };
 
@@ -143,30 +211,7 @@ static bool parse_config(int argc, char* argv[]) {
             for (int i = optind; i < argc; ++i) {
                 const char* arg = argv[i];
                 //DEBUG("%d %d %s", argc, i, arg);
-                grid::POS tmp_pos;
-                if (arg[0] == 'g' && strsub_to_pos(arg+1, tmp_pos, true)) {
-                    if (gridpos != grid::POS_CURRENT) {
-                        ERROR("%s: Multiple positions specified: '%s'", argv[0], argv[i]);
-                        syntax(argv[0]);
-                        return false;
-                    }
-                    gridpos = tmp_pos;
-                } else if (arg[0] == 'w' && strsub_to_pos(arg+1, tmp_pos, false)) {
-                    if (window != grid::POS_CURRENT) {
-                        ERROR("%s: Multiple windows specified: '%s'", argv[0], argv[i]);
-                        syntax(argv[0]);
-                        return false;
-                    }
-                    window = tmp_pos;
-                } else if (arg[0] == 'm' && strsub_to_pos(arg+1, tmp_pos, false)) {
-                    if (monitor != grid::POS_CURRENT) {
-                        ERROR("%s: Multiple monitors specified: '%s'", argv[0], argv[i]);
-                        syntax(argv[0]);
-                        return false;
-                    }
-                    monitor = tmp_pos;
-                } else {
-                    ERROR("%s: Unknown argument: '%s'", argv[0], argv[i]);
+                if (!command::parse_arg(arg, cmd)) {
                     syntax(argv[0]);
                     return false;
                 }
@@ -182,6 +227,82 @@ static bool parse_config(int argc, char* argv[]) {
         case 'v':
             config::debug_enabled = true;
             break;
+        case 'd':
+            run_cmd = CMD_DAEMON;
+            break;
+        case 'D':
+            displays.push_back(optarg);
+            break;
+        case 'q':
+            run_cmd = CMD_QUERY;
+            break;
+        case 'x':
+            run_cmd = CMD_STATS;
+            break;
+        case 't':
+            if (!tile::parse_layout(optarg, tile_layout)) {
+                ERROR("%s: Unknown tile layout: '%s'", argv[0], optarg);
+                syntax(argv[0]);
+                return false;
+            }
+            run_cmd = CMD_TILE;
+            break;
+        case 'T':
+            if (!trace::open(optarg)) {
+                return false;
+            }
+            break;
+        case 'B':
+            if (!tile::parse_bsp(optarg, bsp_op)) {
+                ERROR("%s: Unknown BSP operation: '%s'", argv[0], optarg);
+                syntax(argv[0]);
+                return false;
+            }
+            run_cmd = CMD_BSP;
+            break;
+        case 'S':
+            run_cmd = CMD_SAVE;
+            layout_name = optarg;
+            break;
+        case 'R':
+            run_cmd = CMD_RESTORE;
+            layout_name = optarg;
+            break;
+        case 'e':
+            record_path = optarg;
+            break;
+        case 'y':
+            replay_path = optarg;
+            break;
+        case 'F':
+            {
+                char* end;
+                long count = strtol(optarg, &end, 10);
+                if (*end != '\0' || count < 0) {
+                    ERROR("%s: Invalid window count: '%s'", argv[0], optarg);
+                    syntax(argv[0]);
+                    return false;
+                }
+                // lives until exit, like any other display
+                x11_util::set_backend(new FakeBackend(count, FAKE_MONITORS));
+            }
+            break;
+        case 'b':
+            run_cmd = CMD_BATCH;
+            batch_path = optarg;
+            break;
+#ifdef USE_XSYNC
+        case 's':
+            config::sync_enabled = true;
+            break;
+#endif
+#ifdef COUNT_ALLOCS
+        case 'a':
+            run_cmd = CMD_BATCH;
+            batch_path = optarg;
+            check_allocs = true;
+            break;
+#endif
         case 'l':
             {
                 FILE* logfile = fopen(optarg, "a");
@@ -209,6 +330,8 @@ static bool parse_config(int argc, char* argv[]) {
                     }
                 }
                 fprintf(logfile, "\n");
+                // from here on, don't let a slow disk hold up commands
+                async_log::start(logfile);
             }
             break;
         default:
@@ -217,28 +340,137 @@ static bool parse_config(int argc, char* argv[]) {
         }
     }
 
+    // both lasting until exit, like any other display
+    if (replay_path != NULL) {
+        if (x11_util::is_fake()) {
+            ERROR("%s: --replay can't be combined with --fake", argv[0]);
+            return false;
+        }
+        ReplayBackend* replay = new ReplayBackend;
+        if (!replay->Read(replay_path)) {
+            delete replay;
+            return false;
+        }
+        x11_util::set_backend(replay);
+    }
+    if (record_path != NULL) {
+        // wraps whatever else was chosen, so that --fake runs can be recorded too
+        RecordingBackend* recording = new RecordingBackend(x11_util::get_backend());
+        if (!recording->WriteAtExit(record_path)) {
+            delete recording;
+            return false;
+        }
+        x11_util::set_backend(recording);
+    }
+
+#ifdef USE_XSYNC
+    if (config::sync_enabled && x11_util::is_fake()) {
+        // sync requests and counters go straight to the X server
+        ERROR("%s: --sync can't be combined with --fake/--record/--replay", argv[0]);
+        return false;
+    }
+#endif
+
+    if (run_cmd != CMD_DAEMON && !displays.empty()) {
+        if (displays.size() > 1) {
+            ERROR("%s: only --daemon can use more than one --display", argv[0]);
+            return false;
+        }
+        // reaches the daemon for that display too
+        setenv("DISPLAY", displays[0].c_str(), 1);
+    }
+
     return true;
 }
 
 int main(int argc, char* argv[]) {
+    // the geometry in gridmgr_core logs and traces like everything else
+    core_hooks::set(config::core_message, trace::span_begin, trace::span_end);
     if (!parse_config(argc, argv)) {
         return EXIT_FAILURE;
     }
+    // covers the whole command, with each step nested inside it
+    TRACE_SPAN("gridmgr");
+    if (run_cmd != CMD_DAEMON && use_daemon()) {
+        // for when the command ends up being run here rather than by the daemon
+        runtime_cache::enable();
+    }
     switch (run_cmd) {
     case CMD_HELP:
         syntax(argv[0]);
         return EXIT_SUCCESS;
-    case CMD_POSITION:
-        // activate window (if specified)
-        if (window != grid::POS_CURRENT && !grid::set_active(window)) {
+    case CMD_DAEMON:
+        if (!use_daemon()) {
+            ERROR("%s: --record/--replay/--fake only apply to single commands", argv[0]);
             return EXIT_FAILURE;
         }
-        // move window (if specified)
-        if (gridpos != grid::POS_CURRENT || monitor != grid::POS_CURRENT) {
-            return grid::set_position(gridpos, monitor) ?
-                EXIT_SUCCESS : EXIT_FAILURE;
+        return server::run(displays) ? EXIT_SUCCESS : EXIT_FAILURE;
+    case CMD_POSITION:
+        {
+            // let the daemon handle it, if there's one running
+            bool ok;
+            if (!send_to_daemon() || !server::send(cmd, ok)) {
+                std::vector<bool> results;
+                command::run(cmd_list_t(1, cmd), results);
+                ok = results[0];
+            }
+            return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    case CMD_BATCH:
+        {
+            FILE* in = stdin;
+            if (strcmp(batch_path, "-") != 0) {
+                in = fopen(batch_path, "r");
+                if (in == NULL) {
+                    ERROR("Unable to open batch file %s: %s", batch_path, strerror(errno));
+                    return EXIT_FAILURE;
+                }
+            }
+#ifdef COUNT_ALLOCS
+            bool ok = check_allocs ? batch::check_allocs(in) : batch::run(in);
+#else
+            bool ok = batch::run(in);
+#endif
+            if (in != stdin) {
+                fclose(in);
+            }
+            return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    case CMD_TILE:
+        return tile::run(tile_layout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    case CMD_BSP:
+        return tile::bsp(bsp_op) ? EXIT_SUCCESS : EXIT_FAILURE;
+    case CMD_SAVE:
+        return layout::save(layout_name) ? EXIT_SUCCESS : EXIT_FAILURE;
+    case CMD_RESTORE:
+        return layout::restore(layout_name) ? EXIT_SUCCESS : EXIT_FAILURE;
+    case CMD_QUERY:
+        {
+            // the daemon can answer from its cache without touching X
+            std::string json;
+            bool ok;
+            if (!use_daemon() || !server::query(json, ok)) {
+                ok = query::fetch_json(json);
+            }
+            if (ok) {
+                fputs(json.c_str(), stdout);
+            }
+            return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    case CMD_STATS:
+        {
+            // only the daemon keeps stats, there's nothing to show otherwise
+            std::string text;
+            bool ok;
+            if (!server::fetch_stats(text, ok)) {
+                ERROR("no gridmgr daemon is running");
+                return EXIT_FAILURE;
+            }
+            if (ok) {
+                fputs(text.c_str(), stdout);
+            }
+            return ok ? EXIT_SUCCESS : EXIT_FAILURE;
         }
-        return EXIT_SUCCESS;
     default:
         ERROR("%s: no command specified", argv[0]);
         syntax(argv[0]);
@@ -18,8 +18,9 @@
 
 #include <math.h>
 
-#include "config.h"
+#include "core-hooks.h"
 #include "neighbor.h"
+#include "probes.h"
 
 #define MIDPOINT(min, size) ((size / 2.) + min)
 #define DISTANCE(a,b) ((a > b) ? (a - b) : (b - a))
@@ -40,7 +41,7 @@ namespace {
                 // p is on top of us, avoid getting stuck
                 return false;
             }
-            //DEBUG("%s: %f vs %f", grid::dir_str(dir), abs_atan(p), (M_PI_4));
+            //CORE_DEBUG("%s: %f vs %f", grid::dir_str(dir), abs_atan(p), (M_PI_4));
             switch (dir) {
             case grid::POS_UP_LEFT:
                 return (y > p.y && x > p.x);
@@ -68,7 +69,11 @@ namespace {
             case grid::POS_CENTER:
             case grid::POS_UNKNOWN:
             case grid::POS_CURRENT:
-                ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
+            case grid::POS_STACK:
+            case grid::POS_FREE:
+            case grid::POS_UNDO:
+            case grid::POS_REDO:
+                CORE_ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
                 break;
             }
             return false;//???
@@ -99,7 +104,11 @@ namespace {
             case grid::POS_CENTER:
             case grid::POS_UNKNOWN:
             case grid::POS_CURRENT:
-                ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
+            case grid::POS_STACK:
+            case grid::POS_FREE:
+            case grid::POS_UNDO:
+            case grid::POS_REDO:
+                CORE_ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
                 break;
             }
             return 0;//???
@@ -148,7 +157,11 @@ namespace {
             case grid::POS_CENTER:
             case grid::POS_UNKNOWN:
             case grid::POS_CURRENT:
-                ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
+            case grid::POS_STACK:
+            case grid::POS_FREE:
+            case grid::POS_UNDO:
+            case grid::POS_REDO:
+                CORE_ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
                 break;//???
             }
         }
@@ -175,24 +188,24 @@ namespace {
         double nearest_dist = 0;
         long nearest_i = -1;
         const point& active_pt = pts[active];
-        DEBUG("search %lu for points %s of %ld,%ld:",
+        CORE_DEBUG("search %lu for points %s of %ld,%ld:",
                 pts.size()-1, grid::pos_str(dir), active_pt.x, active_pt.y);
         for (size_t i = 0; i < pts.size(); ++i) {
             if (i == active) {
-                DEBUG("skip: %ld,%ld", pts[i].x, pts[i].y);
+                CORE_DEBUG("skip: %ld,%ld", pts[i].x, pts[i].y);
                 continue;
             }
 
             const point& pt = pts[i];
             if (active_pt.direction(dir, pt)) {
                 double dist = active_pt.distance(dir, pt);
-                DEBUG("match!: %ld,%ld (dist %.02f)", pts[i].x, pts[i].y, dist);
+                CORE_DEBUG("match!: %ld,%ld (dist %.02f)", pts[i].x, pts[i].y, dist);
                 if (nearest_i < 0 || dist < nearest_dist) {
                     nearest_i = i;
                     nearest_dist = dist;
                 }
             } else {
-                DEBUG("miss: %ld,%ld", pts[i].x, pts[i].y);
+                CORE_DEBUG("miss: %ld,%ld", pts[i].x, pts[i].y);
             }
         }
 
@@ -228,7 +241,11 @@ namespace {
         case grid::POS_CENTER:
         case grid::POS_UNKNOWN:
         case grid::POS_CURRENT:
-            ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
+        case grid::POS_STACK:
+        case grid::POS_FREE:
+        case grid::POS_UNDO:
+        case grid::POS_REDO:
+            CORE_ERROR("Internal error: invalid dir %s", grid::pos_str(dir));
             break;
         }
         return grid::POS_UP_CENTER;//???
@@ -238,43 +255,51 @@ namespace {
 #define MAX_X(dim) (dim.x + dim.width)
 #define MAX_Y(dim) (dim.y + dim.height)
 
-void neighbor::select(grid::POS dir, const dim_list_t& all, size_t active, size_t& select) {
-    if (all.size() <= 1) {
-        select = 0;
-        return;
-    }
-    if (dir == grid::POS_CURRENT) {
-        select = active;
-        return;
-    }
-
-    // dimension -> center point and max window dimensions
-    size_t bound_x = MAX_X(all[0]), bound_y = MAX_Y(all[0]);
-    std::vector<point> pts;
-    pts.reserve(all.size());
-    for (dim_list_t::const_iterator iter = all.begin();
-         iter != all.end(); ++iter) {
-        const Dimensions& d = *iter;
-        size_t d_x = MAX_X(d), d_y = MAX_Y(d);
-        if (d_x > bound_x) { bound_x = d_x; }
-        if (d_y > bound_y) { bound_y = d_y; }
-        pts.push_back(point(d));
-    }
-
-    for (size_t i = 0; i < 4; ++i) {//try each of the four directions
-        if (select_nearest_in_direction(dir, pts, active, select)) {
+namespace {
+    void select_imp(grid::POS dir, const dim_list_t& all, size_t active, size_t& select) {
+        if (all.size() <= 1) {
+            select = 0;
             return;
         }
-        // not found. try shifting active pt for a wraparound search
-        pts[active].shift_pos(dir, bound_x, bound_y);
-        if (select_nearest_in_direction(dir, pts, active, select)) {
+        if (dir == grid::POS_CURRENT) {
+            select = active;
             return;
         }
-        // still not found. undo shift and try next direction
-        pts[active].shift_pos(dir, -1 * bound_x, -1 * bound_y);
-        dir = fallback_direction(dir);
+
+        // dimension -> center point and max window dimensions
+        size_t bound_x = MAX_X(all[0]), bound_y = MAX_Y(all[0]);
+        static thread_local std::vector<point> pts;// reused, to avoid allocating per command
+        pts.clear();
+        for (dim_list_t::const_iterator iter = all.begin();
+             iter != all.end(); ++iter) {
+            const Dimensions& d = *iter;
+            size_t d_x = MAX_X(d), d_y = MAX_Y(d);
+            if (d_x > bound_x) { bound_x = d_x; }
+            if (d_y > bound_y) { bound_y = d_y; }
+            pts.push_back(point(d));
+        }
+
+        for (size_t i = 0; i < 4; ++i) {//try each of the four directions
+            if (select_nearest_in_direction(dir, pts, active, select)) {
+                return;
+            }
+            // not found. try shifting active pt for a wraparound search
+            pts[active].shift_pos(dir, bound_x, bound_y);
+            if (select_nearest_in_direction(dir, pts, active, select)) {
+                return;
+            }
+            // still not found. undo shift and try next direction
+            pts[active].shift_pos(dir, -1 * bound_x, -1 * bound_y);
+            dir = fallback_direction(dir);
+        }
+
+        // STILL not found. just give up!
+        select = active;
     }
+}
 
-    // STILL not found. just give up!
-    select = active;
+void neighbor::select(grid::POS dir, const dim_list_t& all, size_t active, size_t& select) {
+    CORE_SPAN("neighbor_select");
+    select_imp(dir, all, active, select);
+    PROBE4(neighbor_select, dir, all.size(), active, select);
 }
@@ -0,0 +1,211 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "core.h"
+#include "desktop.h"
+#include "occupancy.h"
+
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#define MAX(a,b) (((a) > (b)) ? (a) : (b))
+
+// the quarters are 0-3, the sixths are 4-9
+#define QUARTERS_BEGIN 0
+#define SIXTHS_BEGIN 4
+
+namespace {
+    const State CELLS[occupancy::CELL_COUNT] = {
+        // order matches core::mode_cells()
+        State(grid::POS_UP_LEFT, grid::MODE_TWO_COL),
+        State(grid::POS_UP_RIGHT, grid::MODE_TWO_COL),
+        State(grid::POS_DOWN_LEFT, grid::MODE_TWO_COL),
+        State(grid::POS_DOWN_RIGHT, grid::MODE_TWO_COL),
+        State(grid::POS_UP_LEFT, grid::MODE_THREE_COL_S),
+        State(grid::POS_UP_CENTER, grid::MODE_THREE_COL_S),
+        State(grid::POS_UP_RIGHT, grid::MODE_THREE_COL_S),
+        State(grid::POS_DOWN_LEFT, grid::MODE_THREE_COL_S),
+        State(grid::POS_DOWN_CENTER, grid::MODE_THREE_COL_S),
+        State(grid::POS_DOWN_RIGHT, grid::MODE_THREE_COL_S)
+    };
+
+    long overlap(long a1, long a2, long b1, long b2) {
+        long ret = MIN(a2, b2) - MAX(a1, b1);
+        return (ret > 0) ? ret : 0;
+    }
+
+    /* Whether 'win' covers more than half of 'cell'. */
+    bool covers(const Dimensions& win, const Dimensions& cell) {
+        long area =
+            overlap(cell.x, cell.x + cell.width, win.x, win.x + win.width) *
+            overlap(cell.y, cell.y + cell.height, win.y, win.y + win.height);
+        return area * 2 > (long)(cell.width * cell.height);
+    }
+
+    double distance_sq(const Dimensions& a, const Dimensions& b) {
+        double dx = (a.x + a.width / 2.) - (b.x + b.width / 2.),
+            dy = (a.y + a.height / 2.) - (b.y + b.height / 2.);
+        return dx * dx + dy * dy;
+    }
+
+    void init_cells(const Dimensions& viewport, ViewportOccupancy& occ) {
+        dim_list_t quarters, sixths;
+        core::mode_cells(viewport, grid::MODE_TWO_COL, quarters);
+        core::mode_cells(viewport, grid::MODE_THREE_COL_S, sixths);
+        for (size_t i = 0; i < quarters.size(); ++i) {
+            occ.cells[QUARTERS_BEGIN + i] = quarters[i];
+        }
+        for (size_t i = 0; i < sixths.size(); ++i) {
+            occ.cells[SIXTHS_BEGIN + i] = sixths[i];
+        }
+    }
+
+    bool has_state(const WindowInfo& info) {
+        return info.state.mode != grid::MODE_UNKNOWN &&
+            info.state.pos != grid::POS_UNKNOWN;
+    }
+
+    void add(ViewportOccupancy& occ, const WindowInfo& info) {
+        if (has_state(info)) {
+            occ.stacks[info.state.mode][info.state.pos].push_back(info.id);
+        }
+        for (size_t i = 0; i < occupancy::CELL_COUNT; ++i) {
+            if (covers(info.exterior, occ.cells[i])) {
+                occ.covered[i].push_back(info.id);
+            }
+        }
+    }
+
+    void erase(win_id_list_t& list, Window win) {
+        for (win_id_list_t::iterator iter = list.begin(); iter != list.end(); ++iter) {
+            if (*iter == win) {
+                list.erase(iter);
+                return;
+            }
+        }
+    }
+
+    void remove(ViewportOccupancy& occ, const WindowInfo& info) {
+        if (has_state(info)) {
+            erase(occ.stacks[info.state.mode][info.state.pos], info.id);
+        }
+        for (size_t i = 0; i < occupancy::CELL_COUNT; ++i) {
+            erase(occ.covered[i], info.id);
+        }
+    }
+
+    /* Whether the window can be seen, and so takes up its cells: not
+       minimized, and on the current desktop. */
+    bool visible(const DesktopSnapshot& snapshot, const WindowInfo& info) {
+        return !info.hidden && (info.desktop == -1 || snapshot.current_desktop == -1 ||
+                info.desktop == snapshot.current_desktop);
+    }
+
+    /* Whether nothing other than 'win' covers the cell. */
+    bool is_free(const win_id_list_t& covered, Window win) {
+        return covered.empty() || (covered.size() == 1 && covered[0] == win);
+    }
+
+    /* Finds the nearest free cell in [begin, end). Returns false if none. */
+    bool nearest_in(const ViewportOccupancy& occ, size_t begin, size_t end,
+            const WindowInfo& win, const Dimensions& from, size_t& out) {
+        bool found = false;
+        double best = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (!is_free(occ.covered[i], win.id) ||
+                    (CELLS[i].pos == win.state.pos && CELLS[i].mode == win.state.mode)) {
+                continue;
+            }
+            double dist = distance_sq(from, occ.cells[i]);
+            if (!found || dist < best) {
+                found = true;
+                best = dist;
+                out = i;
+            }
+        }
+        return found;
+    }
+}
+
+void occupancy::build(DesktopSnapshot& snapshot) {
+    snapshot.occupancy.assign(snapshot.viewports.size(), ViewportOccupancy());
+    for (size_t v = 0; v < snapshot.viewports.size(); ++v) {
+        init_cells(snapshot.viewports[v], snapshot.occupancy[v]);
+    }
+    for (win_list_t::const_iterator iter = snapshot.windows.begin();
+         iter != snapshot.windows.end(); ++iter) {
+        if (iter->managed && iter->viewport < snapshot.occupancy.size() &&
+                visible(snapshot, *iter)) {
+            add(snapshot.occupancy[iter->viewport], *iter);
+        }
+    }
+}
+
+void occupancy::move(DesktopSnapshot& snapshot, const WindowInfo& before,
+        const WindowInfo& after) {
+    if (before.viewport < snapshot.occupancy.size()) {
+        remove(snapshot.occupancy[before.viewport], before);
+    }
+    if (after.viewport < snapshot.occupancy.size() && visible(snapshot, after)) {
+        add(snapshot.occupancy[after.viewport], after);
+    }
+}
+
+bool occupancy::stack_next(const DesktopSnapshot& snapshot, const WindowInfo& win,
+        Window& out) {
+    if (!has_state(win) || win.viewport >= snapshot.occupancy.size()) {
+        return false;
+    }
+    const win_id_list_t& stack =
+        snapshot.occupancy[win.viewport].stacks[win.state.mode][win.state.pos];
+    for (size_t i = 0; i < stack.size(); ++i) {
+        if (stack[i] == win.id) {
+            if (stack.size() == 1) {
+                return false;
+            }
+            out = stack[(i + 1) % stack.size()];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool occupancy::nearest_free(const DesktopSnapshot& snapshot, size_t viewport,
+        const WindowInfo& win, const Dimensions& from, State& out) {
+    if (viewport >= snapshot.occupancy.size()) {
+        return false;
+    }
+    const ViewportOccupancy& occ = snapshot.occupancy[viewport];
+
+    // stick with thirds if that's what the window's using, otherwise halves
+    bool thirds = (win.state.mode == grid::MODE_THREE_COL_S ||
+            win.state.mode == grid::MODE_THREE_COL_L);
+    size_t cell;
+    if (thirds) {
+        if (!nearest_in(occ, SIXTHS_BEGIN, CELL_COUNT, win, from, cell) &&
+                !nearest_in(occ, QUARTERS_BEGIN, SIXTHS_BEGIN, win, from, cell)) {
+            return false;
+        }
+    } else {
+        if (!nearest_in(occ, QUARTERS_BEGIN, SIXTHS_BEGIN, win, from, cell) &&
+                !nearest_in(occ, SIXTHS_BEGIN, CELL_COUNT, win, from, cell)) {
+            return false;
+        }
+    }
+    out = CELLS[cell];
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef GRIDMGR_OCCUPANCY_H
+#define GRIDMGR_OCCUPANCY_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include <X11/Xlib.h>
+
+#include "dimensions.h"
+#include "position.h"
+
+struct DesktopSnapshot;
+struct WindowInfo;
+
+namespace occupancy {
+    // number of grid::MODE/grid::POS values, for indexing by MODE/POS
+    static const size_t MODE_COUNT = grid::MODE_THREE_COL_L + 1;
+    static const size_t POS_COUNT = grid::POS_DOWN_RIGHT + 1;
+
+    /* The smallest cells that windows are placed into: the four TWO_COL
+     * quarters followed by the six THREE_COL_S sixths. */
+    static const size_t CELL_COUNT = 10;
+}
+
+typedef std::vector<Window> win_id_list_t;
+
+/* Which windows are in which grid cells of a single viewport. */
+struct ViewportOccupancy {
+    // windows whose state is exactly [mode][pos], in _NET_CLIENT_LIST order
+    win_id_list_t stacks[occupancy::MODE_COUNT][occupancy::POS_COUNT];
+    // windows covering most of each of the cells, see CELL_COUNT
+    win_id_list_t covered[occupancy::CELL_COUNT];
+    // the cells themselves
+    Dimensions cells[occupancy::CELL_COUNT];
+};
+
+typedef std::vector<ViewportOccupancy> occupancy_list_t;
+
+namespace occupancy {
+    /* Rebuilds the index for every managed window on the snapshot's current
+     * desktop, whose viewports and states must already be classified.
+     * Windows on other desktops, or minimized, can't be seen, so they don't
+     * take up any cells. */
+    void build(DesktopSnapshot& snapshot);
+
+    /* Updates the index for a single window, after it's been moved from
+     * 'before' to 'after' (possibly on another desktop). */
+    void move(DesktopSnapshot& snapshot, const WindowInfo& before,
+            const WindowInfo& after);
+
+    /* Finds the window after 'win' among the windows stacked in the same
+     * cell, wrapping around. Returns false if 'win' isn't in a known cell or
+     * is alone there. */
+    bool stack_next(const DesktopSnapshot& snapshot, const WindowInfo& win,
+            Window& out);
+
+    /* Finds the cell on 'viewport' nearest to 'from' which has no windows
+     * other than 'win' in it, and which 'win' isn't already exactly in.
+     * Cells of the same size as the window's current mode are preferred.
+     * Returns false if every cell is taken. */
+    bool nearest_free(const DesktopSnapshot& snapshot, size_t viewport,
+            const WindowInfo& win, const Dimensions& from, State& out);
+}
+
+#endif
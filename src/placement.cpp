@@ -0,0 +1,127 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "config.h"
+#include "placement.h"
+#include "window.h"
+
+RulePlacer::~RulePlacer() {
+    Close();
+}
+
+bool RulePlacer::Open(const char* display_name) {
+    std::string path;
+    if (!config::user_dir(NULL, false, path)) {
+        return false;
+    }
+    path += "/rules";
+    FILE* in = fopen(path.c_str(), "r");
+    if (in == NULL) {
+        if (errno != ENOENT) {
+            ERROR("unable to open %s: %s", path.c_str(), strerror(errno));
+        }
+        return false;
+    }
+    matcher.Load(in);// bad lines are skipped
+    fclose(in);
+    if (matcher.Size() == 0) {
+        return false;
+    }
+
+    disp = XOpenDisplay(display_name);
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+    LOG("loaded %lu placement rules from %s", matcher.Size(), path.c_str());
+    return true;
+}
+
+void RulePlacer::Close() {
+    if (disp != NULL) {
+        XCloseDisplay(disp);
+        disp = NULL;
+    }
+}
+
+void RulePlacer::Published(const DesktopSnapshot& snapshot) {
+    std::set<Window> next;
+    bool moved = false;
+    for (win_list_t::const_iterator iter = snapshot.windows.begin();
+         iter != snapshot.windows.end(); ++iter) {
+        next.insert(iter->id);
+        // only place windows the first time they're seen
+        if (primed && iter->managed && known.find(iter->id) == known.end()) {
+            place(snapshot, *iter);
+            moved = true;
+        }
+    }
+    known.swap(next);
+    primed = true;
+    if (moved) {
+        XFlush(disp);
+    }
+}
+
+void RulePlacer::place(const DesktopSnapshot& snapshot, const WindowInfo& win) {
+    std::string names[RuleMatcher::FIELD_COUNT];
+    if (!window::get_class(disp, win.id, names[RuleMatcher::FIELD_INSTANCE],
+                    names[RuleMatcher::FIELD_CLASS], names[RuleMatcher::FIELD_ROLE])) {
+        DEBUG("window %lu lacks a class", win.id);
+    }
+    window::get_title(disp, win.id, names[RuleMatcher::FIELD_TITLE]);
+
+    const PlacementRule* rule = matcher.Match(names);
+    if (rule == NULL) {
+        DEBUG("no rule for window %lu (%s.%s)", win.id,
+                names[RuleMatcher::FIELD_INSTANCE].c_str(),
+                names[RuleMatcher::FIELD_CLASS].c_str());
+        return;
+    }
+
+    size_t viewport = win.viewport;
+    if (rule->monitor >= 0 && (size_t)rule->monitor < snapshot.viewports.size()) {
+        viewport = rule->monitor;
+    }
+    if (viewport >= snapshot.viewports.size()) {
+        return;
+    }
+
+    PositionCalc pcalc(win.exterior, win.hints);
+    State state(rule->pos, rule->mode);
+    if (state.mode == grid::MODE_UNKNOWN && !pcalc.NextState(State(), rule->pos, state)) {
+        return;
+    }
+    Dimensions dim;
+    if (!pcalc.StateToDim(snapshot.viewports[viewport], state, dim)) {
+        ERROR("rule for window %lu has an invalid position/mode: %s/%s", win.id,
+                grid::pos_str(state.pos), grid::mode_str(state.mode));
+        return;
+    }
+    DEBUG("placing window %lu (%s.%s) at %s/%s on viewport %lu", win.id,
+            names[RuleMatcher::FIELD_INSTANCE].c_str(),
+            names[RuleMatcher::FIELD_CLASS].c_str(),
+            grid::pos_str(state.pos), grid::mode_str(state.mode), viewport);
+
+    ActiveWindow active(disp, win.id);
+    active.SetMargins(win.margin_width, win.margin_height);
+    active.MoveResize(dim);
+}
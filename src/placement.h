@@ -0,0 +1,53 @@
+#ifndef GRIDMGR_PLACEMENT_H
+#define GRIDMGR_PLACEMENT_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <set>
+
+#include "desktop-cache.h"
+#include "rules.h"
+
+/* Places newly mapped windows according to the rules in
+ * $XDG_CONFIG_HOME/gridmgr/rules (see RuleMatcher for the format). Windows
+ * which were already around when the daemon started are left alone. */
+class RulePlacer : public SnapshotListener {
+public:
+    RulePlacer() : disp(NULL), primed(false) { }
+    virtual ~RulePlacer();
+
+    /* Loads the rules and opens a connection to the named display for moving
+     * windows. Returns false if there aren't any rules, in which case nothing
+     * needs placing. */
+    bool Open(const char* display_name);
+    void Close();
+
+    void Published(const DesktopSnapshot& snapshot);
+
+private:
+    void place(const DesktopSnapshot& snapshot, const WindowInfo& win);
+
+    Display* disp;
+    RuleMatcher matcher;
+    // windows in the last snapshot, to tell which ones are new
+    std::set<Window> known;
+    bool primed;
+};
+
+#endif
@@ -19,14 +19,21 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <vector>
+
 namespace grid {
     /* These are the various available positions which may be set.
-     * CURRENT is "use the current position", useful when only switching monitors */
+     * CURRENT is "use the current position", useful when only switching monitors
+     * STACK and FREE aren't directions: STACK is "the next window in the same
+     * grid cell" and FREE is "the nearest grid cell without any windows".
+     * Nor are UNDO and REDO, which step through where the window has been. */
     enum POS {
         POS_UNKNOWN, POS_CURRENT,
         POS_UP_LEFT, POS_UP_CENTER, POS_UP_RIGHT,
         POS_LEFT, POS_CENTER, POS_RIGHT,
-        POS_DOWN_LEFT, POS_DOWN_CENTER, POS_DOWN_RIGHT
+        POS_DOWN_LEFT, POS_DOWN_CENTER, POS_DOWN_RIGHT,
+        POS_STACK, POS_FREE,
+        POS_UNDO, POS_REDO
     };
 
     inline const char* pos_str(POS pos) {
@@ -53,9 +60,19 @@ namespace grid {
             return "DOWN_CENTER";
         case POS_DOWN_RIGHT:
             return "DOWN_RIGHT";
+        case POS_STACK:
+            return "STACK";
+        case POS_FREE:
+            return "FREE";
+        case POS_UNDO:
+            return "UNDO";
+        case POS_REDO:
+            return "REDO";
         }
         return "???";
     }
+
+    typedef std::vector<POS> pos_list_t;
 }
 
 #endif
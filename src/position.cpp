@@ -18,26 +18,11 @@
 
 #include <math.h> // round()
 
-#include "config.h"
+#include "core-hooks.h"
 #include "position.h"
+#include "probes.h"
 
 namespace {
-    inline const char* mode_str(grid::MODE mode) {
-        switch (mode) {
-        case grid::MODE_UNKNOWN:
-            return "UNKNOWN";
-        case grid::MODE_TWO_COL:
-            return "TWO_COL";
-        case grid::MODE_THREE_COL_S:
-            return "THREE_COL_S";
-        case grid::MODE_THREE_COL_L:
-            return "THREE_COL_L";
-        default:
-            break;
-        }
-        return "???";
-    }
-
 #define MAX(a,b) (((a) > (b)) ? (a) : (b))
     // whether two numbers are 'near' one another, according to a fudge factor.
     template <typename A, typename B>
@@ -45,22 +30,66 @@ namespace {
         // fudge factor: the greater of 5px or 5% of the greater number.
         double fudge = MAX(5, 0.05 * MAX(a,b));
         bool ret = (a + fudge) >= b && (a - fudge) <= b;
-        DEBUG("%s(%d) vs %s(%d): %s",
+        CORE_DEBUG("%s(%d) vs %s(%d): %s",
                 a_desc, (int)a, b_desc, (int)b,
                 (ret) ? "true" : "false");
         return ret;
     }
 #define NEAR(a,b) _near(a, b, #a, #b)
+
+    // whether the window manager would change any sizes because of these
+    inline bool constrains(const SizeHints& hints) {
+        return hints.min_width != 0 || hints.min_height != 0 ||
+            hints.max_width != 0 || hints.max_height != 0 ||
+            hints.width_inc > 1 || hints.height_inc > 1;
+    }
+
+    /* Applies one axis of WM_NORMAL_HINTS to an exterior size, the same way
+       that the window manager would (ICCCM 4.1.2.3): the client size is
+       kept within min/max, and rounded down to base + N*inc. */
+    unsigned long snap_size(unsigned long size, unsigned long margin,
+            unsigned long min, unsigned long max,
+            unsigned long base, unsigned long inc) {
+        unsigned long interior = (size > margin) ? size - margin : 1;
+        if (max != 0 && interior > max) {
+            interior = max;
+        }
+        if (inc > 1) {
+            // base size defaults to the min size
+            unsigned long from = (base != 0) ? base : min;
+            if (interior > from) {
+                interior = from + (interior - from) / inc * inc;
+            }
+        }
+        if (interior < min) {
+            interior = min;
+        }
+        return interior + margin;
+    }
+
+    // whether two coordinates match, give or take rounding
+    inline bool same(long a, long b) {
+        return a - b <= 1 && b - a <= 1;
+    }
 }
 
 /* given window's dimensions, estimate its state (or unknown+unknown)
    (inverse of StateToDim) */
 bool PositionCalc::CurState(const Dimensions& viewport, State& out) const {
+    CORE_SPAN("cur_state");
     //get window x/y relative to viewport x/y
     int rel_x = window.x - viewport.x,
         rel_y = window.y - viewport.y;
     out.pos = grid::POS_UNKNOWN;
     out.mode = grid::MODE_UNKNOWN;
+    if (constrains(hints) && snapped_state(viewport, out)) {
+        // the window is where StateToDim would've put it
+        CORE_DEBUG("%ldx %ldy %luw %luh -> pos=%s mode=%s (size hints)",
+                rel_x, rel_y, window.width, window.height,
+                pos_str(out.pos), mode_str(out.mode));
+        PROBE4(cur_state, rel_x, rel_y, out.pos, out.mode);
+        return true;
+    }
     if (NEAR(window.width, viewport.width / 2.)) {
         if (NEAR(window.height, viewport.height / 2.)) {
             if (NEAR(rel_x, 0)) {
@@ -200,15 +229,17 @@ bool PositionCalc::CurState(const Dimensions& viewport, State& out) const {
         }
     }
 
-    DEBUG("%ldx %ldy %luw %luh -> pos=%s mode=%s",
+    CORE_DEBUG("%ldx %ldy %luw %luh -> pos=%s mode=%s",
             rel_x, rel_y, window.width, window.height,
             pos_str(out.pos), mode_str(out.mode));
+    PROBE4(cur_state, rel_x, rel_y, out.pos, out.mode);
     return true;
 }
 
 bool PositionCalc::NextState(const State& cur, grid::POS req_pos, State& out) const {
+    CORE_SPAN("next_state");
     if (req_pos == grid::POS_UNKNOWN) {// nice to have
-        ERROR("Position '%s' was requested. Internal error?", pos_str(req_pos));
+        CORE_ERROR("Position '%s' was requested. Internal error?", pos_str(req_pos));
         return false;
     }
     if (req_pos == grid::POS_CURRENT) {
@@ -260,9 +291,10 @@ bool PositionCalc::NextState(const State& cur, grid::POS req_pos, State& out) co
             out.mode = grid::MODE_TWO_COL;
         }
     }
-    DEBUG("curpos=%s curmode=%s + reqpos=%s -> pos=%s mode=%s",
+    CORE_DEBUG("curpos=%s curmode=%s + reqpos=%s -> pos=%s mode=%s",
             pos_str(cur.pos), mode_str(cur.mode), pos_str(req_pos),
             pos_str(out.pos), mode_str(out.mode));
+    PROBE5(next_state, cur.pos, cur.mode, req_pos, out.pos, out.mode);
     return true;
 }
 
@@ -271,6 +303,22 @@ bool PositionCalc::NextState(const State& cur, grid::POS req_pos, State& out) co
    but there's a very finite number of possible positions (for now?) */
 bool PositionCalc::StateToDim(const Dimensions& viewport, const State& state,
         Dimensions& out) const {
+    CORE_SPAN("state_to_dim");
+    bool ret = cell(viewport, state, out);
+    if (ret) {
+        /* ask for a size that the window manager will take as-is, so that
+           it doesn't need to correct us (and the snapshot stays right) */
+        snap(viewport, out);
+        CORE_DEBUG("pos=%s mode=%s -> %ldx %ldy %luw %luh",
+                pos_str(state.pos), mode_str(state.mode),
+                out.x, out.y, out.width, out.height);
+    }
+    PROBE3(state_to_dim, state.pos, state.mode, ret);
+    return ret;
+}
+
+bool PositionCalc::cell(const Dimensions& viewport, const State& state,
+        Dimensions& out) const {
     bool ret = true;
     long rel_x = 0, rel_y = 0;//coordinates relative to viewport
     switch (state.mode) {
@@ -450,17 +498,67 @@ bool PositionCalc::StateToDim(const Dimensions& viewport, const State& state,
         //convert relative pos to absolute:
         out.x = rel_x + viewport.x;
         out.y = rel_y + viewport.y;
-        DEBUG("pos=%s mode=%s -> %ldx %ldy %luw %luh",
-                pos_str(state.pos), mode_str(state.mode),
-                out.x, out.y, out.width, out.height);
     } else {
-        ERROR("Bad pos=%s + mode=%s", pos_str(state.pos), mode_str(state.mode));
+        CORE_ERROR("Bad pos=%s + mode=%s", pos_str(state.pos), mode_str(state.mode));
     }
     return ret;
 }
 
+void PositionCalc::FitToHints(const Dimensions& viewport, Dimensions& area) const {
+    snap(viewport, area);
+}
+
+void PositionCalc::snap(const Dimensions& viewport, Dimensions& out) const {
+    if (!constrains(hints)) {
+        return;
+    }
+    const Dimensions cell = out;
+    out.width = snap_size(cell.width, hints.margin_width,
+            hints.min_width, hints.max_width, hints.base_width, hints.width_inc);
+    out.height = snap_size(cell.height, hints.margin_height,
+            hints.min_height, hints.max_height, hints.base_height, hints.height_inc);
+    /* cells along the right/bottom of the viewport stay against that edge,
+       unless they span the whole viewport */
+    long cell_right = cell.x + (long)cell.width,
+        cell_bottom = cell.y + (long)cell.height;
+    if (cell.x != viewport.x && same(cell_right, viewport.x + (long)viewport.width)) {
+        out.x = cell_right - (long)out.width;
+    }
+    if (cell.y != viewport.y && same(cell_bottom, viewport.y + (long)viewport.height)) {
+        out.y = cell_bottom - (long)out.height;
+    }
+}
+
+bool PositionCalc::snapped_state(const Dimensions& viewport, State& out) const {
+    static const grid::MODE modes[] = {
+        grid::MODE_TWO_COL, grid::MODE_THREE_COL_S, grid::MODE_THREE_COL_L
+    };
+    static const grid::POS positions[] = {
+        grid::POS_UP_LEFT, grid::POS_UP_CENTER, grid::POS_UP_RIGHT,
+        grid::POS_LEFT, grid::POS_CENTER, grid::POS_RIGHT,
+        grid::POS_DOWN_LEFT, grid::POS_DOWN_CENTER, grid::POS_DOWN_RIGHT
+    };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(grid::MODE); ++m) {
+        for (size_t p = 0; p < sizeof(positions) / sizeof(grid::POS); ++p) {
+            State state(positions[p], modes[m]);
+            Dimensions dim;
+            if (!cell(viewport, state, dim)) {
+                continue;// eg TWO_COL has no center
+            }
+            snap(viewport, dim);
+            if (same(window.x, dim.x) && same(window.y, dim.y) &&
+                    same(window.width, dim.width) && same(window.height, dim.height)) {
+                out = state;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void PositionCalc::ViewportToDim(const Dimensions& cur_viewport,
         const Dimensions& next_viewport, Dimensions& out) const {
+    CORE_SPAN("viewport_to_dim");
     // just do an exact scaling to the new viewport
     if (cur_viewport.width == 0 || cur_viewport.height == 0) {//nice to have, avoid div0
         out = next_viewport;//just throw something together and get out
@@ -474,4 +572,5 @@ void PositionCalc::ViewportToDim(const Dimensions& cur_viewport,
     out.y = round((window.y - cur_viewport.y) * ratio_y + next_viewport.y);
     out.width = round(window.width * ratio_x);
     out.height = round(window.height * ratio_y);
+    PROBE4(viewport_to_dim, out.x, out.y, out.width, out.height);
 }
@@ -29,19 +29,54 @@ namespace grid {
         MODE_THREE_COL_S,// 3x2 small: each position filling 1 column
         MODE_THREE_COL_L// 3x2 large: sides filling 2 columns and center filling full width
     };
+
+    inline const char* mode_str(MODE mode) {
+        switch (mode) {
+        case MODE_UNKNOWN:
+            return "UNKNOWN";
+        case MODE_TWO_COL:
+            return "TWO_COL";
+        case MODE_THREE_COL_S:
+            return "THREE_COL_S";
+        case MODE_THREE_COL_L:
+            return "THREE_COL_L";
+        }
+        return "???";
+    }
 }
 
 struct State {
     State() : pos(grid::POS_UNKNOWN), mode(grid::MODE_UNKNOWN) { }
+    State(grid::POS pos, grid::MODE mode) : pos(pos), mode(mode) { }
 
     grid::POS pos;
     grid::MODE mode;
 };
 
+/* A window's WM_NORMAL_HINTS, in the terms that the window manager applies
+ * them: sizes are of the client window, not including its frame. Unset
+ * values are 0. */
+struct SizeHints {
+    SizeHints()
+        : min_width(0), min_height(0), max_width(0), max_height(0),
+          base_width(0), base_height(0), width_inc(0), height_inc(0),
+          margin_width(0), margin_height(0) { }
+
+    unsigned long min_width, min_height;
+    unsigned long max_width, max_height;
+    unsigned long base_width, base_height;
+    unsigned long width_inc, height_inc;
+    // difference between the window's exterior and client sizes
+    unsigned long margin_width, margin_height;
+};
+
 class PositionCalc {
 public:
-    PositionCalc(const Dimensions& window)
-        : window(window) { }
+    /* If 'hints' are provided, the dimensions from StateToDim are adjusted
+     * to sizes that the window manager will accept as-is, and CurState
+     * recognizes windows which were adjusted that way. */
+    PositionCalc(const Dimensions& window, const SizeHints& hints = SizeHints())
+        : window(window), hints(hints) { }
 
     /* Produces an autodetected state of this window using its current
      * coordinates. Returns true on success, else false. */
@@ -63,8 +98,22 @@ public:
     void ViewportToDim(const Dimensions& cur_viewport,
             const Dimensions& next_viewport, Dimensions& out) const;
 
+    /* Adjusts an area of the viewport which isn't one of the grid's cells
+     * (eg from tiling) the same way that StateToDim adjusts its cells. */
+    void FitToHints(const Dimensions& viewport, Dimensions& area) const;
+
 private:
+    /* StateToDim without any size hints applied. */
+    bool cell(const Dimensions& viewport, const State& state,
+            Dimensions& out) const;
+    /* Shrinks (or grows) 'out' to the nearest size allowed by the hints,
+     * keeping it against the viewport's edges. */
+    void snap(const Dimensions& viewport, Dimensions& out) const;
+    /* Looks for a cell which matches the window after snapping. */
+    bool snapped_state(const Dimensions& viewport, State& out) const;
+
     const Dimensions window;
+    const SizeHints hints;
 };
 
 #endif
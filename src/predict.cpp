@@ -0,0 +1,112 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "core.h"
+#include "desktop.h"
+#include "predict.h"
+
+namespace {
+    // all valid window/monitor directions
+    const grid::POS DIRECTIONS[] = {
+        grid::POS_UP_LEFT, grid::POS_UP_CENTER, grid::POS_UP_RIGHT,
+        grid::POS_LEFT, grid::POS_RIGHT,
+        grid::POS_DOWN_LEFT, grid::POS_DOWN_CENTER, grid::POS_DOWN_RIGHT
+    };
+    const size_t DIRECTION_COUNT = sizeof(DIRECTIONS) / sizeof(grid::POS);
+
+    /* Same as window::select_activate, for each direction. */
+    void predict_neighbors(const DesktopSnapshot& snapshot, Prediction& out) {
+        std::vector<Window> wins;
+        dim_list_t all_windows;
+        size_t active_window = 0;
+        for (win_list_t::const_iterator iter = snapshot.windows.begin();
+             iter != snapshot.windows.end(); ++iter) {
+            if (!iter->managed) {
+                continue;
+            }
+            if (iter->id == snapshot.active) {
+                active_window = wins.size();
+            }
+            wins.push_back(iter->id);
+            all_windows.push_back(iter->exterior);
+        }
+
+        for (size_t i = 0; i < DIRECTION_COUNT; ++i) {
+            size_t next_window;
+            neighbor::select(DIRECTIONS[i], all_windows, active_window, next_window);
+            out.neighbors[DIRECTIONS[i]] = wins[next_window];
+        }
+    }
+
+    /* Same as grid::set_position, for each monitor + position. */
+    bool predict_targets(const DesktopSnapshot& snapshot,
+            const WindowInfo& active, Prediction& out) {
+        const dim_list_t& viewports = snapshot.viewports;
+        const Dimensions& cur_window = active.exterior;
+        size_t cur_viewport = core::active_viewport(viewports, cur_window);
+
+        PositionCalc pcalc(cur_window, active.hints);
+        State cur_state;
+        if (!pcalc.CurState(viewports[cur_viewport], cur_state)) {
+            return false;
+        }
+
+        for (size_t m = 0; m <= DIRECTION_COUNT; ++m) {
+            // POS_CURRENT, then each direction
+            grid::POS monitor = (m == 0) ? grid::POS_CURRENT : DIRECTIONS[m-1];
+            size_t next_viewport;
+            neighbor::select(monitor, viewports, cur_viewport, next_viewport);
+
+            for (size_t g = grid::POS_CURRENT; g < predict::POS_COUNT; ++g) {
+                Target& target = out.targets[monitor][g];
+                if (!pcalc.NextState(cur_state, (grid::POS)g, target.state)) {
+                    continue;
+                }
+                if (target.state.pos == grid::POS_UNKNOWN &&
+                        target.state.mode == grid::MODE_UNKNOWN) {
+                    pcalc.ViewportToDim(viewports[cur_viewport],
+                            viewports[next_viewport], target.dim);
+                } else if (!pcalc.StateToDim(viewports[next_viewport],
+                                target.state, target.dim)) {
+                    continue;
+                }
+                target.valid = true;
+            }
+        }
+        return true;
+    }
+}
+
+void predict::compute(DesktopSnapshot& snapshot) {
+    snapshot.prediction = Prediction();
+
+    const WindowInfo* active = snapshot.active_info();
+    if (active == NULL || !active->managed || snapshot.viewports.empty()) {
+        DEBUG("no managed active window, skipping prediction");
+        return;
+    }
+
+    predict_neighbors(snapshot, snapshot.prediction);
+    if (!predict_targets(snapshot, *active, snapshot.prediction)) {
+        snapshot.prediction = Prediction();
+        return;
+    }
+    snapshot.prediction.active = active->id;
+    DEBUG("predicted commands for window %lu", active->id);
+}
@@ -0,0 +1,66 @@
+#ifndef GRIDMGR_PREDICT_H
+#define GRIDMGR_PREDICT_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <X11/Xlib.h>
+
+#include "dimensions.h"
+#include "position.h"
+
+struct DesktopSnapshot;
+
+namespace predict {
+    // number of grid::POS values, for indexing by POS
+    static const size_t POS_COUNT = grid::POS_DOWN_RIGHT + 1;
+}
+
+/* Where the active window would end up for a given monitor + grid command. */
+struct Target {
+    Target() : valid(false) { }
+
+    bool valid;
+    State state;
+    Dimensions dim;
+};
+
+/* The results of every single-position command for one window, computed ahead
+ * of time so that a command only needs to look up its result. */
+struct Prediction {
+    Prediction() : active(0) {
+        for (size_t i = 0; i < predict::POS_COUNT; ++i) {
+            neighbors[i] = 0;
+        }
+    }
+
+    // the window these were computed for, or 0 if nothing was computed
+    Window active;
+    // window to activate, indexed by direction (0 if none)
+    Window neighbors[predict::POS_COUNT];
+    // where to move the window, indexed by [monitor][gridpos]
+    Target targets[predict::POS_COUNT][predict::POS_COUNT];
+};
+
+namespace predict {
+    /* Fills in the snapshot's prediction for its active window. Leaves the
+     * prediction empty if the active window isn't a managed window. */
+    void compute(DesktopSnapshot& snapshot);
+}
+
+#endif
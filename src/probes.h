@@ -0,0 +1,59 @@
+#ifndef GRIDMGR_PROBES_H
+#define GRIDMGR_PROBES_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+/* USDT probes for tracing each stage of a command with perf or bpftrace, eg:
+ *   bpftrace -e 'usdt:./gridmgr:gridmgr:move_resize { printf("%d\n", arg5); }'
+ *
+ * Only compiled in when built with -DUSE_USDT=ON. Otherwise the probes (and
+ * their arguments) compile to nothing. When enabled, an unused probe is a
+ * single nop. */
+
+#ifdef USE_USDT
+
+#include <sys/sdt.h>
+
+#define PROBE(name) DTRACE_PROBE(gridmgr, name)
+#define PROBE1(name, a) DTRACE_PROBE1(gridmgr, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(gridmgr, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(gridmgr, name, a, b, c)
+#define PROBE4(name, a, b, c, d) DTRACE_PROBE4(gridmgr, name, a, b, c, d)
+#define PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(gridmgr, name, a, b, c, d, e)
+#define PROBE6(name, a, b, c, d, e, f) DTRACE_PROBE6(gridmgr, name, a, b, c, d, e, f)
+
+#else
+
+#define PROBE(name) do { } while (0)
+#define PROBE1(name, a) do { } while (0)
+#define PROBE2(name, a, b) do { } while (0)
+#define PROBE3(name, a, b, c) do { } while (0)
+#define PROBE4(name, a, b, c, d) do { } while (0)
+#define PROBE5(name, a, b, c, d, e) do { } while (0)
+#define PROBE6(name, a, b, c, d, e, f) do { } while (0)
+
+#endif
+
+/* Number of requests sent on the connection so far. Most of a command's time
+ * goes to round trips, so this is passed to the X-facing probes. */
+#define PROBE_REQUESTS(disp) ((unsigned long)(NextRequest(disp) - 1))
+
+#endif
@@ -0,0 +1,83 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "query.h"
+#include "x11-util.h"
+
+namespace {
+    void append(std::string& out, const char* format, ...)
+        __attribute__((format(printf, 2, 3)));
+
+    void append(std::string& out, const char* format, ...) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        out += buf;
+    }
+
+    void append_dim(std::string& out, const Dimensions& dim) {
+        append(out, "\"x\": %ld, \"y\": %ld, \"width\": %lu, \"height\": %lu",
+                dim.x, dim.y, dim.width, dim.height);
+    }
+}
+
+void query::to_json(const DesktopSnapshot& snapshot, std::string& out) {
+    out.clear();
+    append(out, "{\n  \"active\": %lu,\n  \"viewports\": [", snapshot.active);
+    for (size_t i = 0; i < snapshot.viewports.size(); ++i) {
+        out += (i == 0) ? "\n    { " : ",\n    { ";
+        append_dim(out, snapshot.viewports[i]);
+        out += " }";
+    }
+    out += "\n  ],\n  \"windows\": [";
+    for (size_t i = 0; i < snapshot.windows.size(); ++i) {
+        const WindowInfo& info = snapshot.windows[i];
+        out += (i == 0) ? "\n    { " : ",\n    { ";
+        append(out, "\"id\": %lu, ", info.id);
+        append_dim(out, info.exterior);
+        append(out, ", \"desktop\": %ld, \"viewport\": %lu, "
+                "\"pos\": \"%s\", \"mode\": \"%s\", \"managed\": %s, \"active\": %s }",
+                info.desktop, info.viewport,
+                grid::pos_str(info.state.pos), grid::mode_str(info.state.mode),
+                info.managed ? "true" : "false",
+                (info.id == snapshot.active) ? "true" : "false");
+    }
+    out += "\n  ]\n}\n";
+}
+
+bool query::fetch_json(std::string& out) {
+    Display* disp = x11_util::open_display();
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+    DesktopSnapshot snapshot;
+    bool ok = desktop::fetch_classified(disp, snapshot);
+    x11_util::close_display(disp);
+    if (!ok) {
+        return false;
+    }
+    to_json(snapshot, out);
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef GRIDMGR_QUERY_H
+#define GRIDMGR_QUERY_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+
+#include "desktop.h"
+
+namespace query {
+    /* Describes the snapshot's windows and viewports as JSON. */
+    void to_json(const DesktopSnapshot& snapshot, std::string& out);
+
+    /* Fetches a snapshot from the display and describes it as JSON.
+     * Returns true on success, else false. */
+    bool fetch_json(std::string& out);
+}
+
+#endif
@@ -0,0 +1,227 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "rules.h"
+
+namespace {
+    const char* FIELD_NAMES[] = { "class", "instance", "role", "title" };
+
+    bool str_to_pos(const char* str, grid::POS& out) {
+        static const struct {
+            const char* name;
+            grid::POS pos;
+        } POS_NAMES[] = {
+            { "uleft", grid::POS_UP_LEFT },
+            { "up", grid::POS_UP_CENTER },
+            { "uright", grid::POS_UP_RIGHT },
+            { "left", grid::POS_LEFT },
+            { "center", grid::POS_CENTER },
+            { "right", grid::POS_RIGHT },
+            { "dleft", grid::POS_DOWN_LEFT },
+            { "down", grid::POS_DOWN_CENTER },
+            { "dright", grid::POS_DOWN_RIGHT }
+        };
+        for (size_t i = 0; i < sizeof(POS_NAMES) / sizeof(POS_NAMES[0]); ++i) {
+            if (strcmp(str, POS_NAMES[i].name) == 0) {
+                out = POS_NAMES[i].pos;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool str_to_mode(const char* str, grid::MODE& out) {
+        if (strcmp(str, "2col") == 0) {
+            out = grid::MODE_TWO_COL;
+        } else if (strcmp(str, "3col") == 0 || strcmp(str, "3col-s") == 0) {
+            out = grid::MODE_THREE_COL_S;
+        } else if (strcmp(str, "3col-l") == 0) {
+            out = grid::MODE_THREE_COL_L;
+        } else {
+            return false;
+        }
+        return true;
+    }
+}
+
+RuleMatcher::RuleMatcher() {
+    for (size_t i = 0; i < FIELD_COUNT; ++i) {
+        tries[i].push_back(Node());
+    }
+}
+
+bool RuleMatcher::Load(FILE* in) {
+    bool ok = true;
+    char line[1024];
+    for (size_t lineno = 1; fgets(line, sizeof(line), in) != NULL; ++lineno) {
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (!Add(line)) {
+            ERROR("skipping bad rule on line %lu", lineno);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool RuleMatcher::Add(char* line) {
+    PlacementRule rule;
+    const char* patterns[FIELD_COUNT] = { NULL };
+    size_t pattern_count = 0;
+
+    char* saveptr = NULL;
+    for (char* tok = strtok_r(line, " \t\r\n", &saveptr); tok != NULL;
+         tok = strtok_r(NULL, " \t\r\n", &saveptr)) {
+        char* val = strchr(tok, '=');
+        if (val == NULL || val[1] == '\0') {
+            ERROR("expected key=value: '%s'", tok);
+            return false;
+        }
+        *val++ = '\0';
+
+        bool found = false;
+        for (size_t i = 0; i < FIELD_COUNT; ++i) {
+            if (strcmp(tok, FIELD_NAMES[i]) == 0) {
+                if (patterns[i] == NULL) {
+                    ++pattern_count;
+                }
+                patterns[i] = val;
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            continue;
+        }
+
+        if (strcmp(tok, "pos") == 0) {
+            if (!str_to_pos(val, rule.pos)) {
+                ERROR("unknown position: '%s'", val);
+                return false;
+            }
+        } else if (strcmp(tok, "mode") == 0) {
+            if (!str_to_mode(val, rule.mode)) {
+                ERROR("unknown mode: '%s'", val);
+                return false;
+            }
+        } else if (strcmp(tok, "monitor") == 0) {
+            char* end = NULL;
+            rule.monitor = strtol(val, &end, 10);
+            if (*end != '\0' || rule.monitor < 0) {
+                ERROR("invalid monitor: '%s'", val);
+                return false;
+            }
+        } else {
+            ERROR("unknown key: '%s'", tok);
+            return false;
+        }
+    }
+
+    if (pattern_count == 0) {
+        ERROR("rule doesn't match anything (needs class/instance/role/title)");
+        return false;
+    }
+    if (rule.pos == grid::POS_UNKNOWN) {
+        ERROR("rule doesn't have a pos");
+        return false;
+    }
+
+    size_t index = rules.size();
+    rules.push_back(rule);
+    field_counts.push_back(pattern_count);
+    hits.push_back(0);
+    for (size_t i = 0; i < FIELD_COUNT; ++i) {
+        if (patterns[i] != NULL) {
+            insert((FIELD)i, patterns[i], index);
+        }
+    }
+    DEBUG("rule %lu: %lu patterns -> pos=%s mode=%s monitor=%ld", index, pattern_count,
+            grid::pos_str(rule.pos), grid::mode_str(rule.mode), rule.monitor);
+    return true;
+}
+
+void RuleMatcher::insert(FIELD field, const char* pattern, size_t rule) {
+    std::vector<Node>& trie = tries[field];
+    size_t node = 0;
+    for (const char* c = pattern; *c != '\0'; ++c) {
+        if (*c == '*' && c[1] == '\0') {
+            trie[node].prefix.push_back(rule);
+            return;
+        }
+        std::map<char, size_t>::const_iterator iter = trie[node].children.find(*c);
+        if (iter == trie[node].children.end()) {
+            size_t child = trie.size();
+            trie[node].children[*c] = child;
+            trie.push_back(Node());// invalidates references into trie
+            node = child;
+        } else {
+            node = iter->second;
+        }
+    }
+    trie[node].exact.push_back(rule);
+}
+
+const PlacementRule* RuleMatcher::Match(const std::string names[FIELD_COUNT]) {
+    /* walk each field's trie once, counting the fields matched by each rule.
+       only the rules which get touched need to be reset afterwards. */
+    std::vector<size_t> touched;
+    size_t best = rules.size();
+    for (size_t f = 0; f < FIELD_COUNT; ++f) {
+        const std::vector<Node>& trie = tries[f];
+        const std::string& name = names[f];
+        size_t node = 0;
+        for (size_t i = 0; ; ++i) {
+            const std::vector<size_t>* lists[2] = { &trie[node].prefix, NULL };
+            if (i == name.size()) {
+                lists[1] = &trie[node].exact;
+            }
+            for (size_t l = 0; l < 2 && lists[l] != NULL; ++l) {
+                for (size_t r = 0; r < lists[l]->size(); ++r) {
+                    size_t rule = (*lists[l])[r];
+                    if (hits[rule]++ == 0) {
+                        touched.push_back(rule);
+                    }
+                    if (hits[rule] == field_counts[rule] && rule < best) {
+                        best = rule;
+                    }
+                }
+            }
+            if (i == name.size()) {
+                break;
+            }
+            std::map<char, size_t>::const_iterator iter = trie[node].children.find(name[i]);
+            if (iter == trie[node].children.end()) {
+                break;
+            }
+            node = iter->second;
+        }
+    }
+    for (size_t i = 0; i < touched.size(); ++i) {
+        hits[touched[i]] = 0;
+    }
+    return (best < rules.size()) ? &rules[best] : NULL;
+}
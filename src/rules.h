@@ -0,0 +1,98 @@
+#ifndef GRIDMGR_RULES_H
+#define GRIDMGR_RULES_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "pos.h"
+#include "position.h"
+
+/* Where a newly mapped window should be placed. */
+struct PlacementRule {
+    PlacementRule()
+        : pos(grid::POS_UNKNOWN), mode(grid::MODE_UNKNOWN), monitor(-1) { }
+
+    grid::POS pos;
+    // MODE_UNKNOWN to use the position's first mode
+    grid::MODE mode;
+    // viewport index, or -1 for whichever viewport the window appeared on
+    long monitor;
+};
+
+/* Matches windows against a list of placement rules. Each rule has a pattern
+ * for any of a window's class, instance, role, and title. A pattern is either
+ * an exact string or a prefix followed by '*'.
+ *
+ * Patterns are compiled into one trie per field, so matching a window costs
+ * time proportional to the length of its names (plus the number of rules
+ * which partially match), regardless of how many rules there are. When
+ * several rules match, the first one in the file wins. */
+class RuleMatcher {
+public:
+    enum FIELD {
+        FIELD_CLASS,
+        FIELD_INSTANCE,
+        FIELD_ROLE,
+        FIELD_TITLE,
+        FIELD_COUNT
+    };
+
+    RuleMatcher();
+
+    /* Adds the rules in 'in', one per line, eg:
+     *   class=Firefox role=browser pos=left mode=3col-l monitor=1
+     *   title=Mail* pos=dright
+     * '#' starts a comment. Bad lines are reported and skipped.
+     * Returns false if any lines were bad. */
+    bool Load(FILE* in);
+
+    /* Adds a single rule, in the same format as Load(). 'line' is modified.
+     * Returns false if it couldn't be parsed. */
+    bool Add(char* line);
+
+    size_t Size() const { return rules.size(); }
+
+    /* Finds the first rule matching the window's names, which are indexed by
+     * FIELD. Returns NULL if none match. */
+    const PlacementRule* Match(const std::string names[FIELD_COUNT]);
+
+private:
+    struct Node {
+        std::map<char, size_t> children;
+        // rules whose pattern ends here exactly, or is a prefix ending here
+        std::vector<size_t> exact, prefix;
+    };
+
+    void insert(FIELD field, const char* pattern, size_t rule);
+
+    // each field's trie, stored as a node list with the root at 0
+    std::vector<Node> tries[FIELD_COUNT];
+    std::vector<PlacementRule> rules;
+    // number of fields each rule has patterns for
+    std::vector<unsigned char> field_counts;
+    // scratch space for Match(): fields matched so far for each rule
+    std::vector<unsigned char> hits;
+};
+
+#endif
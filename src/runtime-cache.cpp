@@ -0,0 +1,398 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "config.h"
+#include "gridmgr-shm.h"
+#include "runtime-cache.h"
+#include "x11-util.h"
+
+#define CACHE_MAGIC 0x47524d43 /* "GRMC" */
+#define CACHE_VERSION 2
+
+#define CACHE_MAX_ATOMS 64
+#define CACHE_ATOM_NAME_MAX 48
+#define CACHE_MAX_VIEWPORTS 16
+#define CACHE_FRAME_SLOTS 512 // power of two
+#define CACHE_FRAME_PROBES 8
+
+namespace {
+    struct cache_atom {
+        char name[CACHE_ATOM_NAME_MAX];
+        uint64_t atom;
+    };
+
+    struct cache_rect {
+        int32_t x;
+        int32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct cache_frame {
+        uint64_t win;// 0 = empty
+        uint64_t frame;
+        uint32_t margin_width;
+        uint32_t margin_height;
+    };
+
+    struct cache_file {
+        uint32_t magic;
+        uint32_t version;
+        /* matches the _GRIDMGR_CACHE property on the root window */
+        uint64_t token;
+        uint64_t token_atom;
+        /* of the _NET_WORKAREA and monitors which the viewports were found
+           for, 0 if none */
+        uint64_t layout_hash;
+        /* the window manager's _NET_SUPPORTING_WM_CHECK window, whose frames
+           are listed, 0 if none */
+        uint64_t wm_check;
+        uint32_t atom_count;
+        uint32_t viewport_count;
+        cache_atom atoms[CACHE_MAX_ATOMS];
+        cache_rect viewports[CACHE_MAX_VIEWPORTS];
+        cache_frame frames[CACHE_FRAME_SLOTS];
+    };
+
+    enum STATE {
+        STATE_DISABLED,
+        STATE_UNCHECKED,
+        STATE_READY,
+        STATE_FAILED
+    };
+
+    STATE state = STATE_DISABLED;
+    cache_file* cache = NULL;
+    int cache_fd = -1;// kept open to hold the lock
+    uint64_t layout_hash = 0;// as of this invocation, 0 if not fetched yet
+    bool wm_checked = false;// whether the frames were checked against the window manager
+
+    uint64_t new_token() {
+        uint64_t token = 0;
+        int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            if (read(fd, &token, sizeof(token)) != sizeof(token)) {
+                token = 0;
+            }
+            close(fd);
+        }
+        if (token == 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            token = ((uint64_t)ts.tv_sec << 32) ^ ts.tv_nsec ^ ((uint64_t)getpid() << 16);
+        }
+        return token;
+    }
+
+    /* Maps the file, creating it if needed. Returns false if it's in use. */
+    bool map_file() {
+        const char* dir = getenv("XDG_RUNTIME_DIR");
+        char name[128];
+        if (dir == NULL || dir[0] == '\0' || gridmgr_shm_name(name, sizeof(name)) != 0) {
+            DEBUG("no XDG_RUNTIME_DIR or DISPLAY, not caching");
+            return false;
+        }
+        std::string path = std::string(dir) + name + ".cache";
+
+        cache_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (cache_fd < 0) {
+            ERROR("unable to open %s: %s", path.c_str(), strerror(errno));
+            return false;
+        }
+        if (flock(cache_fd, LOCK_EX | LOCK_NB) != 0) {
+            // another invocation is using it, don't wait around
+            DEBUG("%s is in use, not caching", path.c_str());
+            close(cache_fd);
+            cache_fd = -1;
+            return false;
+        }
+        struct stat st;
+        if (fstat(cache_fd, &st) != 0 ||
+                (st.st_size != sizeof(cache_file) &&
+                        (ftruncate(cache_fd, 0) != 0 ||
+                                ftruncate(cache_fd, sizeof(cache_file)) != 0))) {
+            ERROR("unable to size %s: %s", path.c_str(), strerror(errno));
+            close(cache_fd);
+            cache_fd = -1;
+            return false;
+        }
+        void* ptr = mmap(NULL, sizeof(cache_file), PROT_READ | PROT_WRITE,
+                MAP_SHARED, cache_fd, 0);
+        if (ptr == MAP_FAILED) {
+            ERROR("unable to map %s: %s", path.c_str(), strerror(errno));
+            close(cache_fd);
+            cache_fd = -1;
+            return false;
+        }
+        cache = (cache_file*)ptr;
+        return true;
+    }
+
+    /* Throws everything out and claims the display with a new token. */
+    void reset(Display* disp) {
+        memset(cache, 0, sizeof(cache_file));
+        cache->magic = CACHE_MAGIC;
+        cache->version = CACHE_VERSION;
+        cache->token = new_token();
+        cache->token_atom = x11_util::intern_atom(disp, "_GRIDMGR_CACHE");
+        // format 32 properties only hold 32 bits per value
+        unsigned long values[2] = {
+            (unsigned long)(cache->token >> 32), (unsigned long)(cache->token & 0xffffffff) };
+        x11_util::set_property(disp, DefaultRootWindow(disp), XA_CARDINAL,
+                cache->token_atom, values, 2);
+    }
+
+    bool is_valid(Display* disp) {
+        if (cache->magic != CACHE_MAGIC || cache->version != CACHE_VERSION ||
+                cache->token_atom == 0) {
+            return false;
+        }
+        size_t count = 0;
+        unsigned long* values = (unsigned long*)x11_util::get_property(disp,
+                DefaultRootWindow(disp), XA_CARDINAL, cache->token_atom, &count);
+        if (values == NULL) {
+            return false;
+        }
+        bool ret = count == 2 &&
+            ((((uint64_t)values[0] & 0xffffffff) << 32) | (values[1] & 0xffffffff)) == cache->token;
+        x11_util::free_property(values);
+        return ret;
+    }
+
+    bool ready(Display* disp) {
+        if (state == STATE_UNCHECKED) {
+            // anything looked up while checking goes straight to the display
+            state = STATE_FAILED;
+            if (map_file()) {
+                if (!is_valid(disp)) {
+                    DEBUG("runtime cache is stale, starting over");
+                    reset(disp);
+                }
+                state = STATE_READY;
+            }
+        }
+        return state == STATE_READY;
+    }
+
+    inline uint64_t fnv1a(uint64_t hash, uint64_t value) {
+        return (hash ^ value) * 1099511628211ULL;
+    }
+
+    bool fetch_layout_hash(Display* disp) {
+        if (layout_hash != 0) {
+            return true;
+        }
+        static thread_local Atom workarea_msg = x11_util::intern_atom(disp, "_NET_WORKAREA");
+        size_t count = 0;
+        unsigned long* area = (unsigned long*)x11_util::get_property(disp,
+                DefaultRootWindow(disp), XA_CARDINAL, workarea_msg, &count);
+        if (area == NULL) {
+            return false;
+        }
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < count; ++i) {
+            hash = fnv1a(hash, area[i]);
+        }
+        x11_util::free_property(area);
+
+        // the workarea alone stays the same when a monitor is swapped for another
+        dim_list_t screens;
+        if (x11_util::query_screens(disp, screens)) {
+            for (size_t i = 0; i < screens.size(); ++i) {
+                hash = fnv1a(hash, screens[i].x);
+                hash = fnv1a(hash, screens[i].y);
+                hash = fnv1a(hash, screens[i].width);
+                hash = fnv1a(hash, screens[i].height);
+            }
+        } else {
+            Window root;
+            int x, y;
+            unsigned int width, height, border, depth;
+            if (x11_util::get_geometry(disp, DefaultRootWindow(disp), &root,
+                            &x, &y, &width, &height, &border, &depth) == 0) {
+                return false;
+            }
+            hash = fnv1a(hash, width);
+            hash = fnv1a(hash, height);
+        }
+        layout_hash = hash | 1;// never 0
+        return true;
+    }
+
+    /* Frames and margins belong to the window manager which made them, so
+     * they're thrown out when another one takes over. Returns false if
+     * there's no window manager to check against. */
+    bool check_wm(Display* disp) {
+        if (!wm_checked) {
+            wm_checked = true;
+            static thread_local Atom check_msg =
+                x11_util::intern_atom(disp, "_NET_SUPPORTING_WM_CHECK");
+            unsigned long wm = 0;
+            size_t count = 0;
+            if (!x11_util::get_values(disp, DefaultRootWindow(disp), XA_WINDOW, check_msg,
+                            &wm, 1, &count) || count != 1) {
+                wm = 0;
+            }
+            if (wm != cache->wm_check) {
+                DEBUG("window manager changed, forgetting frames");
+                memset(cache->frames, 0, sizeof(cache->frames));
+                cache->wm_check = wm;
+            }
+        }
+        return cache->wm_check != 0;
+    }
+
+    inline size_t frame_slot(Window win, size_t probe) {
+        return ((win * 0x9e3779b97f4a7c15ULL) >> 32) + probe;
+    }
+
+    cache_frame* find_frame_slot(Window win) {
+        for (size_t i = 0; i < CACHE_FRAME_PROBES; ++i) {
+            cache_frame& slot = cache->frames[frame_slot(win, i) & (CACHE_FRAME_SLOTS - 1)];
+            if (slot.win == win) {
+                return &slot;
+            }
+        }
+        return NULL;
+    }
+}
+
+void runtime_cache::enable() {
+    if (state == STATE_DISABLED) {
+        state = STATE_UNCHECKED;
+    }
+}
+
+bool runtime_cache::find_atom(Display* disp, const char* name, Atom& out) {
+    if (!ready(disp)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < cache->atom_count && i < CACHE_MAX_ATOMS; ++i) {
+        if (strncmp(cache->atoms[i].name, name, CACHE_ATOM_NAME_MAX) == 0) {
+            out = cache->atoms[i].atom;
+            return true;
+        }
+    }
+    return false;
+}
+
+void runtime_cache::save_atom(Display* disp, const char* name, Atom atom) {
+    if (!ready(disp) || cache->atom_count >= CACHE_MAX_ATOMS ||
+            strlen(name) >= CACHE_ATOM_NAME_MAX) {
+        return;
+    }
+    cache_atom& entry = cache->atoms[cache->atom_count];
+    strcpy(entry.name, name);
+    entry.atom = atom;
+    ++cache->atom_count;
+}
+
+bool runtime_cache::find_viewports(Display* disp, dim_list_t& out) {
+    if (!ready(disp) || cache->layout_hash == 0 || cache->viewport_count == 0 ||
+            cache->viewport_count > CACHE_MAX_VIEWPORTS ||
+            !fetch_layout_hash(disp) || layout_hash != cache->layout_hash) {
+        return false;
+    }
+    out.resize(cache->viewport_count);
+    for (size_t i = 0; i < out.size(); ++i) {
+        const cache_rect& r = cache->viewports[i];
+        out[i].x = r.x;
+        out[i].y = r.y;
+        out[i].width = r.width;
+        out[i].height = r.height;
+    }
+    DEBUG("using %lu cached viewports", out.size());
+    return true;
+}
+
+void runtime_cache::save_viewports(Display* disp, const dim_list_t& viewports) {
+    if (!ready(disp) || viewports.empty() || viewports.size() > CACHE_MAX_VIEWPORTS ||
+            !fetch_layout_hash(disp)) {
+        return;
+    }
+    for (size_t i = 0; i < viewports.size(); ++i) {
+        cache_rect& r = cache->viewports[i];
+        r.x = viewports[i].x;
+        r.y = viewports[i].y;
+        r.width = viewports[i].width;
+        r.height = viewports[i].height;
+    }
+    cache->viewport_count = viewports.size();
+    cache->layout_hash = layout_hash;
+}
+
+bool runtime_cache::find_frame(Display* disp, Window win, Window& out_frame,
+        unsigned int& out_margin_width, unsigned int& out_margin_height) {
+    if (win == 0 || !ready(disp) || !check_wm(disp)) {
+        return false;
+    }
+    const cache_frame* slot = find_frame_slot(win);
+    if (slot == NULL) {
+        return false;
+    }
+    out_frame = slot->frame;
+    out_margin_width = slot->margin_width;
+    out_margin_height = slot->margin_height;
+    return true;
+}
+
+void runtime_cache::save_frame(Display* disp, Window win, Window frame,
+        unsigned int margin_width, unsigned int margin_height) {
+    if (win == 0 || !ready(disp) || !check_wm(disp)) {
+        return;
+    }
+    cache_frame* slot = find_frame_slot(win);
+    if (slot == NULL) {
+        // take the first free slot, else evict the first one
+        slot = &cache->frames[frame_slot(win, 0) & (CACHE_FRAME_SLOTS - 1)];
+        for (size_t i = 0; i < CACHE_FRAME_PROBES; ++i) {
+            cache_frame& candidate = cache->frames[frame_slot(win, i) & (CACHE_FRAME_SLOTS - 1)];
+            if (candidate.win == 0) {
+                slot = &candidate;
+                break;
+            }
+        }
+    }
+    slot->win = win;
+    slot->frame = frame;
+    slot->margin_width = margin_width;
+    slot->margin_height = margin_height;
+}
+
+void runtime_cache::forget_frame(Display* disp, Window win) {
+    if (win == 0 || !ready(disp)) {
+        return;
+    }
+    cache_frame* slot = find_frame_slot(win);
+    if (slot != NULL) {
+        slot->win = 0;
+    }
+}
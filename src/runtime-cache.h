@@ -0,0 +1,66 @@
+#ifndef GRIDMGR_RUNTIME_CACHE_H
+#define GRIDMGR_RUNTIME_CACHE_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include <X11/Xlib.h>
+
+#include "dimensions.h"
+
+typedef std::vector<Dimensions> dim_list_t;
+
+/* Keeps what rarely changes between invocations in a file under
+ * $XDG_RUNTIME_DIR, so that commands run without the daemon can skip most
+ * of their setup round trips: interned atoms, the trimmed viewports, and
+ * each window's frame and margins.
+ *
+ * The file belongs to one X server, identified by a random token which is
+ * also stored in a property on its root window. If the property doesn't
+ * match (eg the server was restarted), everything is thrown out. Viewports
+ * are only reused while _NET_WORKAREA and the monitors are unchanged. Frames
+ * are thrown out when another window manager takes over, and a window's
+ * frame is forgotten as soon as it no longer holds the window. Invocations
+ * which run at the same time as another one skip the cache rather than
+ * waiting for it.
+ *
+ * Only for single commands: not thread-safe. Everything is a no-op until
+ * enable() is called. */
+namespace runtime_cache {
+    void enable();
+
+    /* Looks up a previously interned atom. */
+    bool find_atom(Display* disp, const char* name, Atom& out);
+    void save_atom(Display* disp, const char* name, Atom atom);
+
+    /* Looks up the viewports which were saved for the current _NET_WORKAREA
+     * and monitors. */
+    bool find_viewports(Display* disp, dim_list_t& out);
+    void save_viewports(Display* disp, const dim_list_t& viewports);
+
+    /* Looks up the frame which contains 'win', and the difference between
+     * their sizes. The caller checks that the frame still contains it. */
+    bool find_frame(Display* disp, Window win, Window& out_frame,
+            unsigned int& out_margin_width, unsigned int& out_margin_height);
+    void save_frame(Display* disp, Window win, Window frame,
+            unsigned int margin_width, unsigned int margin_height);
+    void forget_frame(Display* disp, Window win);
+}
+
+#endif
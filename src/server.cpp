@@ -0,0 +1,695 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <X11/Xlib.h>
+
+#include "alloc-count.h"
+#include "config.h"
+#include "desktop-cache.h"
+#include "gridmgr-shm.h"
+#include "io-util.h"
+#include "placement.h"
+#include "query.h"
+#include "server.h"
+#include "shm-export.h"
+#include "stats.h"
+#include "trace.h"
+#include "x11-util.h"
+
+/* Commands which keep arriving are coalesced for at most this long before
+   they're applied, so that a held key still produces visible movement. */
+#define FRAME_MS 16
+
+/* How long to wait for a newly connected client to send its command. */
+#define RECV_TIMEOUT_MS 100
+
+#define REQUEST_MAGIC 0x47524d32 // "GRM2"
+
+namespace {
+    enum REQUEST_TYPE {
+        REQUEST_COMMAND = 0,
+        REQUEST_QUERY = 1,
+        REQUEST_STATS = 2
+    };
+
+    /* What's sent over the socket by clients. The daemon replies with a single
+       byte: 1 for success, 0 for failure. For queries and stats, the reply
+       byte is followed by the JSON/text, up until the daemon closes the
+       connection. */
+    struct request {
+        uint32_t magic;
+        uint32_t type;
+        int32_t window;
+        int32_t monitor;
+        int32_t gridpos;
+    };
+
+    struct pending_cmd {
+        int fd;
+        Command cmd;
+        // when the command arrived, for stats
+        unsigned long received_us;
+    };
+
+    /* Written to on SIGINT/SIGTERM, and never read, so that it wakes up
+       every screen's thread. */
+    int stop_pipe[2] = { -1, -1 };
+
+    void stop_handler(int /*sig*/) {
+        char stop = 1;
+        if (write(stop_pipe[1], &stop, 1) != 1) {
+            // already full, which is just as good
+        }
+    }
+
+    int handle_x_error(Display* disp, XErrorEvent* error) {
+        /* the default handler exits the process. windows can disappear at any
+           time, so errors like BadWindow are expected in a long-lived process */
+        char msg[256];
+        XGetErrorText(disp, error->error_code, msg, sizeof(msg));
+        DEBUG("ignoring X error: %s (request %d)", msg, error->request_code);
+        return 0;
+    }
+
+    unsigned long now_ms() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+    }
+
+    unsigned long now_us() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+    }
+
+    /* Without $XDG_RUNTIME_DIR, sockets go in a directory under /tmp which
+       only this user can get into, so that nobody else can put their own
+       socket (or a symlink) where ours is expected. The daemon creates it,
+       clients only check it. Returns false if it's missing or isn't private. */
+    bool private_dir(bool create, std::string& out) {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/gridmgr-%u", (unsigned int)getuid());
+        if (create && mkdir(path, 0700) != 0 && errno != EEXIST) {
+            ERROR("unable to create %s: %s", path, strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (lstat(path, &st) != 0) {
+            DEBUG("%s doesn't exist: %s", path, strerror(errno));
+            return false;
+        }
+        if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077) != 0) {
+            ERROR("%s isn't a private directory belonging to this user, not using it", path);
+            return false;
+        }
+        out = path;
+        return true;
+    }
+
+    /* Each screen that the daemon is managing gets its own socket, named the
+       same way as its shared memory. */
+    bool socket_path(const char* display, bool create, struct sockaddr_un& addr) {
+        char id[64];
+        if (display == NULL || display[0] == '\0') {
+            ERROR("DISPLAY is not set");
+            return false;
+        }
+        if (gridmgr_display_id(display, id, sizeof(id)) != 0) {
+            ERROR("display name is too long: %s", display);
+            return false;
+        }
+        std::string name = std::string("gridmgr-") + id + ".sock";
+
+        std::string path;
+        const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+        if (runtime_dir != NULL && runtime_dir[0] != '\0') {
+            path = runtime_dir;
+        } else if (!private_dir(create, path)) {
+            return false;
+        }
+        path += "/" + name;
+
+        if (path.size() >= sizeof(addr.sun_path)) {
+            ERROR("socket path is too long: %s", path.c_str());
+            return false;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return true;
+    }
+
+    int connect_socket(const struct sockaddr_un& addr) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            ERROR("socket failed: %s", strerror(errno));
+            return -1;
+        }
+        if (connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int listen_socket(const struct sockaddr_un& addr) {
+        // only one daemon per display. clean up after any dead ones
+        int existing = connect_socket(addr);
+        if (existing >= 0) {
+            ERROR("gridmgr daemon is already running at %s", addr.sun_path);
+            close(existing);
+            return -1;
+        }
+        unlink(addr.sun_path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            ERROR("socket failed: %s", strerror(errno));
+            return -1;
+        }
+        mode_t prev_umask = umask(0077);// only accept commands from this user
+        int bind_ret = bind(fd, (const struct sockaddr*)&addr, sizeof(addr));
+        umask(prev_umask);
+        if (bind_ret != 0) {
+            ERROR("bind to %s failed: %s", addr.sun_path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        if (listen(fd, SOMAXCONN) != 0) {
+            ERROR("listen on %s failed: %s", addr.sun_path, strerror(errno));
+            close(fd);
+            unlink(addr.sun_path);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool read_all(int fd, void* buf, size_t size) {
+        char* ptr = (char*)buf;
+        while (size > 0) {
+            ssize_t got = read(fd, ptr, size);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                return false;
+            }
+            ptr += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    bool valid_pos(int32_t pos, int32_t special = grid::POS_UNKNOWN) {
+        return (pos >= grid::POS_CURRENT && pos <= grid::POS_DOWN_RIGHT) ||
+            (special != grid::POS_UNKNOWN && pos == special);
+    }
+
+    /* Answers a query from whatever's currently cached, without touching X. */
+    void answer_query(int fd, DesktopCache& cache) {
+        unsigned long start_us = now_us();
+        std::string json;
+        const DesktopSnapshot* snapshot = cache.Acquire();
+        if (snapshot != NULL) {
+            query::to_json(*snapshot, json);
+        }
+        cache.Release();
+
+        char reply = (snapshot != NULL) ? 1 : 0;
+        if (!io_util::write_all(fd, &reply, 1, true) ||
+                !io_util::write_all(fd, json.data(), json.size(), true)) {
+            DEBUG("client disconnected before reply");
+        }
+        close(fd);
+        stats::record_command(stats::COMMAND_QUERY, now_us() - start_us);
+    }
+
+    void answer_stats(int fd) {
+        std::string text;
+        stats::to_text(text);
+        char reply = 1;
+        if (!io_util::write_all(fd, &reply, 1, true) ||
+                !io_util::write_all(fd, text.data(), text.size(), true)) {
+            DEBUG("client disconnected before reply");
+        }
+        close(fd);
+    }
+
+    /* Records a command's latency under each kind of step it includes. */
+    void record_cmd(const pending_cmd& pending, unsigned long end_us) {
+        unsigned long us = end_us - pending.received_us;
+        if (pending.cmd.window != grid::POS_CURRENT) {
+            stats::record_command(stats::COMMAND_WINDOW, us);
+        }
+        if (pending.cmd.monitor != grid::POS_CURRENT) {
+            stats::record_command(stats::COMMAND_MONITOR, us);
+        }
+        if (pending.cmd.gridpos != grid::POS_CURRENT) {
+            stats::record_command(stats::COMMAND_GRID, us);
+        }
+    }
+
+    /* Accepts a pending client and reads its command into 'out'. Queries are
+       answered immediately. Returns false if there's nothing left to accept. */
+    bool accept_cmd(int listen_fd, std::vector<pending_cmd>& out, DesktopCache& cache) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                ERROR("accept failed: %s", strerror(errno));
+            }
+            return false;
+        }
+
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = RECV_TIMEOUT_MS * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        request req;
+        if (!read_all(fd, &req, sizeof(req)) || req.magic != REQUEST_MAGIC ||
+                req.type > REQUEST_STATS ||
+                !valid_pos(req.window, grid::POS_STACK) || !valid_pos(req.monitor) ||
+                !(valid_pos(req.gridpos, grid::POS_FREE) ||
+                        req.gridpos == grid::POS_UNDO || req.gridpos == grid::POS_REDO)) {
+            ERROR("got invalid request from client, disconnecting");
+            close(fd);
+            return true;
+        }
+        if (req.type == REQUEST_QUERY) {
+            answer_query(fd, cache);
+            return true;
+        }
+        if (req.type == REQUEST_STATS) {
+            answer_stats(fd);
+            return true;
+        }
+
+        pending_cmd pending;
+        pending.fd = fd;
+        pending.received_us = now_us();
+        pending.cmd.window = (grid::POS)req.window;
+        pending.cmd.monitor = (grid::POS)req.monitor;
+        pending.cmd.gridpos = (grid::POS)req.gridpos;
+        out.push_back(pending);
+        return true;
+    }
+
+    /* 'cmds' and 'results' are only passed in so that their buffers are
+       reused from one command to the next. */
+    void run_pending(std::vector<pending_cmd>& pending, cmd_list_t& cmds,
+            std::vector<bool>& results, DesktopCache& cache) {
+        TRACE_SPAN("run_commands");
+        unsigned long allocs = alloc_count::get();
+        cmds.clear();
+        for (size_t i = 0; i < pending.size(); ++i) {
+            cmds.push_back(pending[i].cmd);
+        }
+        DEBUG("running %lu queued commands", cmds.size());
+
+        command::run(cmds, results, cache.Acquire());
+        cache.Release();
+
+        for (size_t i = 0; i < pending.size(); ++i) {
+            char reply = results[i] ? 1 : 0;
+            if (!io_util::write_all(pending[i].fd, &reply, 1, true)) {
+                DEBUG("client disconnected before reply");
+            }
+            close(pending[i].fd);
+        }
+        unsigned long end_us = now_us();
+        for (size_t i = 0; i < pending.size(); ++i) {
+            record_cmd(pending[i], end_us);
+        }
+        stats::count(stats::COUNTER_ALLOCATIONS, alloc_count::get() - allocs);
+        pending.clear();
+    }
+}
+
+namespace {
+    /* Serves one screen of one display, with its own socket, connections,
+       caches, and thread, so that a busy screen never holds up another. */
+    class ScreenServer {
+    public:
+        explicit ScreenServer(const std::string& display)
+            : display(display), listen_fd(-1), disp(NULL) { }
+        ~ScreenServer() {
+            Stop();
+        }
+
+        /* Returns false if the screen couldn't be opened or is already being
+           served by another daemon. */
+        bool Start();
+        /* Waits for the thread to exit after stop_pipe is written to. */
+        void Stop();
+
+    private:
+        void loop();
+
+        const std::string display;
+        struct sockaddr_un addr;
+        int listen_fd;
+        Display* disp;
+        DesktopCache cache;
+        ShmExport shm;
+        RulePlacer placer;
+        std::thread thread;
+    };
+
+    bool ScreenServer::Start() {
+        if (!socket_path(display.c_str(), true, addr)) {
+            return false;
+        }
+
+        /* keep a connection open for the lifetime of the daemon. if the X server
+           goes away, Xlib exits the process for us. */
+        disp = XOpenDisplay(display.c_str());
+        if (disp == NULL) {
+            ERROR("unable to open display %s", display.c_str());
+            return false;
+        }
+
+        listen_fd = listen_socket(addr);
+        if (listen_fd < 0) {
+            return false;
+        }
+        {
+            int flags = fcntl(listen_fd, F_GETFL, 0);
+            fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK);
+        }
+
+        // the window table is also published for other programs to read
+        if (shm.Open(display.c_str())) {
+            cache.AddListener(&shm);
+        }
+        // new windows are placed as soon as they appear, if there are any rules
+        if (placer.Open(display.c_str())) {
+            cache.AddListener(&placer);
+        }
+        if (!cache.Start(display.c_str())) {
+            return false;
+        }
+
+        thread = std::thread(&ScreenServer::loop, this);
+        LOG("serving %s at %s", display.c_str(), addr.sun_path);
+        return true;
+    }
+
+    void ScreenServer::Stop() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+        cache.Stop();
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            unlink(addr.sun_path);
+            listen_fd = -1;
+        }
+        if (disp != NULL) {
+            XCloseDisplay(disp);
+            disp = NULL;
+        }
+    }
+
+    void ScreenServer::loop() {
+        // commands go to this screen rather than $DISPLAY, over the connection
+        // that's already open
+        x11_util::set_thread_display(display.c_str());
+        x11_util::set_thread_connection(disp);
+
+        // kept across commands, so that once they've grown nothing is allocated
+        std::vector<pending_cmd> pending;
+        cmd_list_t cmds;
+        std::vector<bool> results;
+        unsigned long first_pending_ms = 0;
+        for (;;) {
+            struct pollfd fds[3];
+            fds[0].fd = listen_fd;
+            fds[0].events = POLLIN;
+            fds[1].fd = ConnectionNumber(disp);
+            fds[1].events = POLLIN;
+            fds[2].fd = stop_pipe[0];
+            fds[2].events = POLLIN;
+
+            /* if commands are queued, just check for more before running them,
+               otherwise wait indefinitely */
+            int ready = poll(fds, 3, pending.empty() ? -1 : 0);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ERROR("poll failed: %s", strerror(errno));
+                break;
+            }
+            if (fds[2].revents != 0) {
+                break;
+            }
+
+            if (fds[1].revents != 0) {
+                // nothing is selected yet, but keep the queue clear
+                while (XPending(disp) > 0) {
+                    XEvent event;
+                    XNextEvent(disp, &event);
+                }
+            }
+
+            bool got_cmd = false;
+            if (fds[0].revents & POLLIN) {
+                size_t prev_count = pending.size();
+                while (accept_cmd(listen_fd, pending, cache)) { }
+                got_cmd = pending.size() > prev_count;
+                if (prev_count == 0 && got_cmd) {
+                    first_pending_ms = now_ms();
+                }
+            }
+
+            /* run commands once the queue has drained, or once they've waited
+               for a full frame while more commands kept arriving */
+            if (!pending.empty() &&
+                    (!got_cmd || now_ms() - first_pending_ms >= FRAME_MS)) {
+                run_pending(pending, cmds, results, cache);
+                trace::flush();
+            }
+        }
+
+        for (size_t i = 0; i < pending.size(); ++i) {
+            close(pending[i].fd);
+        }
+        x11_util::set_thread_connection(NULL);
+    }
+
+    /* Expands a display without a screen (":0") into each of its screens
+       (":0.0", ":0.1", ...), which are each served separately. */
+    bool expand_screens(const std::string& name, std::vector<std::string>& out) {
+        size_t colon = name.rfind(':');
+        if (colon == std::string::npos) {
+            ERROR("invalid display name: %s", name.c_str());
+            return false;
+        }
+        if (name.find('.', colon) != std::string::npos) {
+            out.push_back(name);
+            return true;
+        }
+        Display* disp = XOpenDisplay(name.c_str());
+        if (disp == NULL) {
+            ERROR("unable to open display %s", name.c_str());
+            return false;
+        }
+        int count = ScreenCount(disp);
+        XCloseDisplay(disp);
+        for (int i = 0; i < count; ++i) {
+            char screen[16];
+            snprintf(screen, sizeof(screen), ".%d", i);
+            out.push_back(name + screen);
+        }
+        return true;
+    }
+}
+
+bool server::run(const std::vector<std::string>& displays) {
+    std::vector<std::string> screens;
+    if (displays.empty()) {
+        const char* display = getenv("DISPLAY");
+        if (display == NULL || display[0] == '\0') {
+            ERROR("DISPLAY is not set");
+            return false;
+        }
+        if (!expand_screens(display, screens)) {
+            return false;
+        }
+    } else {
+        for (size_t i = 0; i < displays.size(); ++i) {
+            if (!expand_screens(displays[i], screens)) {
+                return false;
+            }
+        }
+    }
+
+    // each screen has an event thread and a command thread
+    XInitThreads();
+    stats::enable();
+    XSetErrorHandler(handle_x_error);
+
+    if (pipe(stop_pipe) != 0) {
+        ERROR("pipe failed: %s", strerror(errno));
+        return false;
+    }
+    {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = stop_handler;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    std::vector<ScreenServer*> servers;
+    for (size_t i = 0; i < screens.size(); ++i) {
+        ScreenServer* server = new ScreenServer(screens[i]);
+        if (server->Start()) {
+            servers.push_back(server);
+        } else {
+            // keep serving the others
+            delete server;
+        }
+    }
+
+    if (!servers.empty()) {
+        // the screens' threads do all the work, just wait to be stopped
+        struct pollfd fd;
+        fd.fd = stop_pipe[0];
+        fd.events = POLLIN;
+        while (poll(&fd, 1, -1) < 0 && errno == EINTR) { }
+        LOG("shutting down");
+    }
+
+    for (size_t i = 0; i < servers.size(); ++i) {
+        delete servers[i];
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    stop_pipe[0] = stop_pipe[1] = -1;
+    return !servers.empty();
+}
+
+namespace {
+    /* Connects to the daemon and sends it a request.
+       Returns the connection, or -1 if no daemon is running. */
+    int send_request(const request& req) {
+        struct sockaddr_un addr;
+        if (!socket_path(getenv("DISPLAY"), false, addr)) {
+            return -1;
+        }
+        int fd = connect_socket(addr);
+        if (fd < 0) {
+            DEBUG("no daemon at %s, running locally", addr.sun_path);
+            return -1;
+        }
+        if (!io_util::write_all(fd, &req, sizeof(req), true)) {
+            DEBUG("unable to send to daemon at %s, running locally", addr.sun_path);
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /* Sends a request whose reply is a result byte followed by text. */
+    bool request_text(uint32_t type, std::string& out, bool& ok_out) {
+        request req;
+        req.magic = REQUEST_MAGIC;
+        req.type = type;
+        req.window = req.monitor = req.gridpos = grid::POS_CURRENT;
+        int fd = send_request(req);
+        if (fd < 0) {
+            return false;
+        }
+
+        char reply;
+        if (!read_all(fd, &reply, 1)) {
+            ERROR("daemon didn't reply");
+            ok_out = false;
+            close(fd);
+            return true;
+        }
+        out.clear();
+        char buf[4096];
+        for (;;) {
+            ssize_t got = read(fd, buf, sizeof(buf));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                break;
+            }
+            out.append(buf, got);
+        }
+        ok_out = (reply == 1);
+        close(fd);
+        return true;
+    }
+}
+
+bool server::send(const Command& cmd, bool& ok_out) {
+    request req;
+    req.magic = REQUEST_MAGIC;
+    req.type = REQUEST_COMMAND;
+    req.window = cmd.window;
+    req.monitor = cmd.monitor;
+    req.gridpos = cmd.gridpos;
+    int fd = send_request(req);
+    if (fd < 0) {
+        return false;
+    }
+
+    char reply;
+    if (!read_all(fd, &reply, 1)) {
+        ERROR("daemon didn't reply");
+        ok_out = false;
+    } else {
+        ok_out = (reply == 1);
+    }
+    close(fd);
+    return true;
+}
+
+bool server::query(std::string& out, bool& ok_out) {
+    return request_text(REQUEST_QUERY, out, ok_out);
+}
+
+bool server::fetch_stats(std::string& out, bool& ok_out) {
+    return request_text(REQUEST_STATS, out, ok_out);
+}
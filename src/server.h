@@ -0,0 +1,55 @@
+#ifndef GRIDMGR_SERVER_H
+#define GRIDMGR_SERVER_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+#include "command.h"
+
+namespace server {
+    /* Runs the gridmgr daemon in the foreground, handling commands sent by
+     * other gridmgr invocations until killed. Commands which arrive while
+     * earlier ones are still being handled are coalesced.
+     *
+     * Each screen of each display in 'displays' (or of $DISPLAY, if empty)
+     * is served separately, with its own socket, connections, caches, and
+     * thread. A display name without a screen (":0") covers all of its
+     * screens. Invocations reach the daemon for their $DISPLAY.
+     * Returns false if no screen could be served. */
+    bool run(const std::vector<std::string>& displays);
+
+    /* Sends a command to a running daemon and waits for it to be handled.
+     * Returns false if no daemon is running, in which case the command should
+     * be run locally. Otherwise 'ok_out' is set to the command's result. */
+    bool send(const Command& cmd, bool& ok_out);
+
+    /* Asks a running daemon for its cached window table, as JSON.
+     * Returns false if no daemon is running, in which case the table should
+     * be fetched locally. Otherwise 'ok_out' is set to whether 'out' was filled. */
+    bool query(std::string& out, bool& ok_out);
+
+    /* Asks a running daemon for its latency histograms and counters, as text.
+     * Returns false if no daemon is running. Otherwise 'ok_out' is set to
+     * whether 'out' was filled. */
+    bool fetch_stats(std::string& out, bool& ok_out);
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "shm-export.h"
+
+namespace {
+    void to_rect(const Dimensions& dim, struct gridmgr_shm_rect& out) {
+        out.x = dim.x;
+        out.y = dim.y;
+        out.width = dim.width;
+        out.height = dim.height;
+    }
+}
+
+// the C header spells these out for readers which can't include pos.h/position.h
+static_assert(GRIDMGR_SHM_POS_UNKNOWN == grid::POS_UNKNOWN &&
+        GRIDMGR_SHM_POS_UP_LEFT == grid::POS_UP_LEFT &&
+        GRIDMGR_SHM_POS_DOWN_RIGHT == grid::POS_DOWN_RIGHT,
+        "GRIDMGR_SHM_POS_* out of sync with grid::POS");
+static_assert(GRIDMGR_SHM_MODE_UNKNOWN == grid::MODE_UNKNOWN &&
+        GRIDMGR_SHM_MODE_TWO_COL == grid::MODE_TWO_COL &&
+        GRIDMGR_SHM_MODE_THREE_COL_S == grid::MODE_THREE_COL_S &&
+        GRIDMGR_SHM_MODE_THREE_COL_L == grid::MODE_THREE_COL_L,
+        "GRIDMGR_SHM_MODE_* out of sync with grid::MODE");
+
+ShmExport::~ShmExport() {
+    Close();
+}
+
+bool ShmExport::Open(const char* display_name) {
+    if (gridmgr_shm_name_for(display_name, name, sizeof(name)) != 0) {
+        ERROR("unable to get shared memory name for %s", display_name);
+        return false;
+    }
+    /* Never reuse an existing object: another user could have created it
+     * first, readable or writable by them. Drop any leftover from an earlier
+     * run and create a fresh one, failing if someone races us to the name. */
+    if (shm_unlink(name) != 0 && errno != ENOENT) {
+        ERROR("unable to remove stale shared memory %s: %s", name, strerror(errno));
+        return false;
+    }
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        ERROR("unable to create shared memory %s: %s", name, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_uid != getuid() ||
+            (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+        ERROR("refusing to use shared memory %s: not private to this user", name);
+        close(fd);
+        return false;
+    }
+    if (ftruncate(fd, sizeof(struct gridmgr_shm)) != 0) {
+        ERROR("unable to size shared memory %s: %s", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    void* ptr = mmap(NULL, sizeof(struct gridmgr_shm),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        ERROR("unable to map shared memory %s: %s", name, strerror(errno));
+        shm_unlink(name);
+        return false;
+    }
+    shm = (struct gridmgr_shm*)ptr;
+
+    // mark it mid-update until there's a snapshot to show
+    memset(shm, 0, sizeof(struct gridmgr_shm));
+    shm->seq = 1;
+    shm->pid = getpid();
+    shm->version = GRIDMGR_SHM_VERSION;
+    __atomic_store_n(&shm->magic, GRIDMGR_SHM_MAGIC, __ATOMIC_RELEASE);
+    DEBUG("exporting windows to shared memory %s", name);
+    return true;
+}
+
+void ShmExport::Close() {
+    if (shm != NULL) {
+        munmap(shm, sizeof(struct gridmgr_shm));
+        shm_unlink(name);
+        shm = NULL;
+    }
+}
+
+void ShmExport::Published(const DesktopSnapshot& snapshot) {
+    if (shm == NULL) {
+        return;
+    }
+
+    // seqlock write: odd while updating, even once done
+    uint64_t seq = shm->seq | 1;
+    __atomic_store_n(&shm->seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    shm->generation = snapshot.generation;
+    shm->active = snapshot.active;
+    shm->flags = 0;
+
+    size_t viewport_count = snapshot.viewports.size();
+    if (viewport_count > GRIDMGR_SHM_MAX_VIEWPORTS) {
+        viewport_count = GRIDMGR_SHM_MAX_VIEWPORTS;
+        shm->flags |= GRIDMGR_SHM_TRUNCATED;
+    }
+    for (size_t i = 0; i < viewport_count; ++i) {
+        to_rect(snapshot.viewports[i], shm->viewports[i]);
+    }
+    shm->viewport_count = viewport_count;
+
+    size_t window_count = snapshot.windows.size();
+    if (window_count > GRIDMGR_SHM_MAX_WINDOWS) {
+        window_count = GRIDMGR_SHM_MAX_WINDOWS;
+        shm->flags |= GRIDMGR_SHM_TRUNCATED;
+    }
+    for (size_t i = 0; i < window_count; ++i) {
+        const WindowInfo& info = snapshot.windows[i];
+        struct gridmgr_shm_window& out = shm->windows[i];
+        out.id = info.id;
+        to_rect(info.exterior, out.exterior);
+        out.desktop = info.desktop;
+        out.pos = info.state.pos;
+        out.mode = info.state.mode;
+        out.flags = 0;
+        if (info.managed) {
+            out.flags |= GRIDMGR_SHM_MANAGED;
+        }
+        if (info.id == snapshot.active) {
+            out.flags |= GRIDMGR_SHM_ACTIVE;
+        }
+        out.viewport = info.viewport;
+    }
+    shm->window_count = window_count;
+
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELEASE);
+}
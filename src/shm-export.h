@@ -0,0 +1,44 @@
+#ifndef GRIDMGR_SHM_EXPORT_H
+#define GRIDMGR_SHM_EXPORT_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "desktop-cache.h"
+#include "gridmgr-shm.h"
+
+/* Copies each snapshot into a shared memory segment, for other programs to
+ * read without talking to X. See gridmgr-shm.h for the format. */
+class ShmExport : public SnapshotListener {
+public:
+    ShmExport() : shm(NULL) { }
+    virtual ~ShmExport();
+
+    /* Creates the segment for the named display (see gridmgr_shm_name_for()).
+     * Returns false if it couldn't be created. */
+    bool Open(const char* display_name);
+    void Close();
+
+    void Published(const DesktopSnapshot& snapshot);
+
+private:
+    struct gridmgr_shm* shm;
+    char name[128];
+};
+
+#endif
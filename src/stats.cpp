@@ -0,0 +1,204 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "stats.h"
+
+/* Number of distinct stage names which may be tracked. Stages past this are
+   ignored. Must be a power of two. */
+#define STAGE_SLOTS 64
+
+namespace {
+    struct StageSlot {
+        std::atomic<const char*> name;
+        Histogram hist;
+    };
+
+    Histogram command_hists[stats::COMMAND_TYPE_COUNT];
+    StageSlot stage_slots[STAGE_SLOTS];
+
+    const char* COMMAND_NAMES[] = { "w", "m", "g", "query" };
+    const char* COUNTER_NAMES[] = { "round_trips", "cache_hits", "cache_misses", "coalesced",
+        "allocations" };
+
+    /* Finds (or claims) the slot for a stage. Names are string literals, so
+       the pointer is used as the key: no hashing of the string, and no
+       allocation. The same name from different files may get separate
+       slots, which to_text() merges. */
+    Histogram* stage_hist(const char* name) {
+        size_t start = ((size_t)name >> 3) & (STAGE_SLOTS - 1);
+        for (size_t i = 0; i < STAGE_SLOTS; ++i) {
+            StageSlot& slot = stage_slots[(start + i) & (STAGE_SLOTS - 1)];
+            const char* cur = slot.name.load(std::memory_order_acquire);
+            if (cur == NULL) {
+                if (slot.name.compare_exchange_strong(cur, name)) {
+                    return &slot.hist;
+                }
+                // another thread just claimed it. 'cur' is now its name
+            }
+            if (cur == name) {
+                return &slot.hist;
+            }
+        }
+        return NULL;
+    }
+
+    void append_hist(const char* kind, const char* name, const Histogram& hist,
+            std::string& out) {
+        char line[256];
+        snprintf(line, sizeof(line), "%s %s count=%lu p50=%luus p99=%luus max=%luus\n",
+                kind, name, hist.Count(), hist.Percentile(50), hist.Percentile(99), hist.Max());
+        out += line;
+    }
+}
+
+Histogram::Histogram() : count(0), max(0) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t Histogram::bucket(unsigned long value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    // exponent of the highest set bit, >= 4
+    size_t exponent = (sizeof(unsigned long) * 8 - 1) - __builtin_clzl(value);
+    if (exponent >= MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+    size_t sub = (value >> (exponent - 4)) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS * (exponent - 3) + sub;
+}
+
+unsigned long Histogram::bucket_max(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    size_t exponent = bucket / SUB_BUCKETS + 3, sub = bucket % SUB_BUCKETS;
+    unsigned long width = 1UL << (exponent - 4);
+    return ((SUB_BUCKETS + sub) * width) + width - 1;
+}
+
+void Histogram::Record(unsigned long value) {
+    buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    unsigned long cur = max.load(std::memory_order_relaxed);
+    while (value > cur && !max.compare_exchange_weak(cur, value, std::memory_order_relaxed)) { }
+}
+
+unsigned long Histogram::Percentile(double percentile) const {
+    unsigned long total = Count();
+    if (total == 0) {
+        return 0;
+    }
+    // the rank of the value we're looking for, 1-based
+    unsigned long rank = (unsigned long)((percentile / 100.) * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    unsigned long seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            unsigned long val = bucket_max(i), cur_max = Max();
+            return (val < cur_max) ? val : cur_max;
+        }
+    }
+    return Max();
+}
+
+void Histogram::Merge(const Histogram& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        buckets[i].fetch_add(other.buckets[i].load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+    }
+    count.fetch_add(other.Count(), std::memory_order_relaxed);
+    unsigned long other_max = other.Max(), cur = max.load(std::memory_order_relaxed);
+    while (other_max > cur &&
+            !max.compare_exchange_weak(cur, other_max, std::memory_order_relaxed)) { }
+}
+
+namespace stats {
+    bool active = false;
+    std::atomic<unsigned long> counters[COUNTER_COUNT];
+}
+
+void stats::enable() {
+    for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+        counters[i].store(0);
+    }
+    active = true;
+}
+
+void stats::record_command(COMMAND_TYPE type, unsigned long us) {
+    if (active) {
+        command_hists[type].Record(us);
+    }
+}
+
+void stats::record_stage(const char* name, unsigned long us) {
+    if (!active) {
+        return;
+    }
+    Histogram* hist = stage_hist(name);
+    if (hist != NULL) {
+        hist->Record(us);
+    }
+}
+
+void stats::to_text(std::string& out) {
+    out.clear();
+    for (size_t i = 0; i < COMMAND_TYPE_COUNT; ++i) {
+        append_hist("command", COMMAND_NAMES[i], command_hists[i], out);
+    }
+
+    // merge any stages which share a name, and list them in first-seen order
+    bool printed[STAGE_SLOTS] = { false };
+    for (size_t i = 0; i < STAGE_SLOTS; ++i) {
+        const char* name = stage_slots[i].name.load(std::memory_order_acquire);
+        if (name == NULL || printed[i]) {
+            continue;
+        }
+        Histogram merged;
+        for (size_t j = i; j < STAGE_SLOTS; ++j) {
+            const char* other = stage_slots[j].name.load(std::memory_order_acquire);
+            if (other != NULL && strcmp(other, name) == 0) {
+                merged.Merge(stage_slots[j].hist);
+                printed[j] = true;
+            }
+        }
+        append_hist("stage", name, merged, out);
+    }
+
+    char line[128];
+    for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+#ifndef COUNT_ALLOCS
+        if (i == COUNTER_ALLOCATIONS) {
+            // always 0, which would be misleading
+            continue;
+        }
+#endif
+        snprintf(line, sizeof(line), "counter %s %lu\n",
+                COUNTER_NAMES[i], counters[i].load(std::memory_order_relaxed));
+        out += line;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef GRIDMGR_STATS_H
+#define GRIDMGR_STATS_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <string>
+
+/* A latency histogram with roughly 6% precision (HDR-style: 16 linear
+ * sub-buckets per power of two). Recording is lock-free and never allocates,
+ * so it's safe from any thread. Values are in microseconds. */
+class Histogram {
+public:
+    Histogram();
+
+    void Record(unsigned long value);
+
+    unsigned long Count() const { return count.load(std::memory_order_relaxed); }
+    unsigned long Max() const { return max.load(std::memory_order_relaxed); }
+    /* Returns the value which 'percentile' (0-100) of recorded values are
+     * at or below, rounded up to its bucket's upper bound. */
+    unsigned long Percentile(double percentile) const;
+
+    /* Adds the other histogram's values to this one. */
+    void Merge(const Histogram& other);
+
+private:
+    Histogram(const Histogram&);
+    Histogram& operator=(const Histogram&);
+
+    static const size_t SUB_BUCKETS = 16;
+    // values up to 2^36us (~19 hours), anything longer is counted as that
+    static const size_t MAX_EXPONENT = 36;
+    static const size_t BUCKETS = SUB_BUCKETS * (MAX_EXPONENT - 3);
+
+    static size_t bucket(unsigned long value);
+    static unsigned long bucket_max(size_t bucket);
+
+    std::atomic<unsigned long> buckets[BUCKETS];
+    std::atomic<unsigned long> count, max;
+};
+
+/* Latency and event counts for a long-running daemon. Nothing is recorded
+ * until stats::enable() is called. */
+namespace stats {
+    enum COMMAND_TYPE {
+        COMMAND_WINDOW,// w*
+        COMMAND_MONITOR,// m*
+        COMMAND_GRID,// g*
+        COMMAND_QUERY,
+        COMMAND_TYPE_COUNT
+    };
+
+    enum COUNTER {
+        // X requests which waited for a reply
+        COUNTER_ROUND_TRIPS,
+        // commands answered from/without a precomputed prediction
+        COUNTER_CACHE_HITS,
+        COUNTER_CACHE_MISSES,
+        // grid positions folded into a previous move of the same window
+        COUNTER_COALESCED,
+        // heap allocations while running commands, if built with COUNT_ALLOCS
+        COUNTER_ALLOCATIONS,
+        COUNTER_COUNT
+    };
+
+    void enable();
+
+    /* Records how long a command took, from being received to being answered. */
+    void record_command(COMMAND_TYPE type, unsigned long us);
+
+    /* Records how long a stage took. Called by TraceSpan with its name, which
+     * must be a string literal. */
+    void record_stage(const char* name, unsigned long us);
+
+    /* Formats everything recorded so far as text, one histogram or counter
+     * per line. */
+    void to_text(std::string& out);
+
+    /* DONT USE THESE DIRECTLY, use count() instead. */
+    extern bool active;
+    extern std::atomic<unsigned long> counters[COUNTER_COUNT];
+
+    inline void count(COUNTER counter, unsigned long n = 1) {
+        if (active) {
+            counters[counter].fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+}
+
+#endif
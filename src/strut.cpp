@@ -0,0 +1,94 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core-hooks.h"
+#include "strut.h"
+
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#define MAX(a,b) (((a) > (b)) ? (a) : (b))
+
+static int INTERSECTION(int a1, int a2, int b1, int b2) {
+    int ret = (a2 < b1 || b2 < a1) ? 0 :
+        (a1 >= b1) ?
+        ((a2 >= b2) ? (b2 - a1) : (a2 - a1)) :
+        ((a2 >= b2) ? (b2 - b1) : (a2 - b1));
+    CORE_DEBUG("%d-%d x %d-%d = %d", a1, a2, b1, b2, ret);
+    return ret;
+}
+
+void strut::parse_partial(const unsigned long values[12], strut_list_t& out) {
+    //left
+    if (values[0] > 0) {
+        out.push_back(Strut(Strut::LEFT, values[0], values[4], values[5]));
+    }
+    //right
+    if (values[1] > 0) {
+        out.push_back(Strut(Strut::RIGHT, values[1], values[6], values[7]));
+    }
+    //top
+    if (values[2] > 0) {
+        out.push_back(Strut(Strut::TOP, values[2], values[8], values[9]));
+    }
+    //bot
+    if (values[3] > 0) {
+        out.push_back(Strut(Strut::BOTTOM, values[3], values[10], values[11]));
+    }
+}
+
+void strut::trim(const Dimensions& bound, const strut_list_t& struts,
+        Dimensions& screen) {
+    //for simpler math, operate on things in terms of min/max
+    long screen_max_x = screen.x + screen.width,
+        screen_max_y = screen.y + screen.height;
+
+    for (strut_list_t::const_iterator iter = struts.begin();
+         iter != struts.end(); ++iter) {
+        switch (iter->type) {
+        case Strut::LEFT:
+            // first check if it intersects our screen's min/max y
+            if (INTERSECTION(screen.y, screen_max_y, iter->min, iter->max) != 0) {
+                //then check if the strut (relative to the bounding box) actually exceeds our min x
+                screen.x = MAX(screen.x, (long)iter->width - bound.x);
+            }
+            break;
+        case Strut::RIGHT:
+            if (INTERSECTION(screen.y, screen_max_y, iter->min, iter->max) != 0) {
+                long bound_max_x = bound.x + bound.width;
+                screen_max_x = MIN(screen_max_x, bound_max_x - (long)iter->width);
+            }
+            break;
+        case Strut::TOP:
+            if (INTERSECTION(screen.x, screen_max_x, iter->min, iter->max) != 0) {
+                screen.y = MAX(screen.y, (long)iter->width - bound.y);
+            }
+            break;
+        case Strut::BOTTOM:
+            if (INTERSECTION(screen.x, screen_max_x, iter->min, iter->max) != 0) {
+                long bound_max_y = bound.y + bound.height;
+                screen_max_y = MIN(screen_max_y, bound_max_y - (long)iter->width);
+            }
+            break;
+        }
+    }
+
+    screen.width = screen_max_x - screen.x;
+    screen.height = screen_max_y - screen.y;
+
+    CORE_DEBUG("trimmed: %ldx %ldy %ldw %ldh",
+            screen.x, screen.y, screen.width, screen.height);
+}
@@ -0,0 +1,54 @@
+#ifndef GRIDMGR_STRUT_H
+#define GRIDMGR_STRUT_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+
+#include "dimensions.h"
+
+/* A reserved area along one edge of the desktop, eg a panel.
+ * See _NET_WM_STRUT_PARTIAL in the EWMH spec. */
+struct Strut {
+    enum TYPE {
+        LEFT, RIGHT, TOP, BOTTOM
+    };
+
+    Strut(TYPE type, unsigned long width, unsigned long min, unsigned long max)
+        : type(type), width(width), min(min), max(max) { }
+
+    TYPE type;
+    // thickness, and the range along the edge which is covered
+    unsigned long width, min, max;
+};
+
+typedef std::vector<Strut> strut_list_t;
+
+namespace strut {
+    /* Appends any nonzero struts from the 12 values of a _NET_WM_STRUT_PARTIAL
+     * property to 'out'. */
+    void parse_partial(const unsigned long values[12], strut_list_t& out);
+
+    /* Trims any struts which intersect 'screen' from its edges. Struts are
+     * relative to 'bound', the bounding box of all screens. */
+    void trim(const Dimensions& bound, const strut_list_t& struts,
+            Dimensions& screen);
+}
+
+#endif
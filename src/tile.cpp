@@ -0,0 +1,306 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <X11/Xlib.h>
+
+#include "bsp.h"
+#include "config.h"
+#include "core.h"
+#include "desktop.h"
+#include "tile.h"
+#include "viewport.h"
+#include "window.h"
+#include "x11-util.h"
+
+/* Arbitrarily large, to catch typos like "40x30". */
+#define MAX_CELLS_PER_SIDE 16
+
+namespace {
+    bool on_desktop(const WindowInfo& info, long desktop) {
+        return info.desktop == -1 || desktop == -1 || info.desktop == desktop;
+    }
+
+    /* Produces the cells for 'window_count' windows, which must be nonzero. */
+    void get_cells(const tile::Layout& layout, const Dimensions& viewport,
+            size_t window_count, dim_list_t& cells) {
+        if (layout.mode != grid::MODE_UNKNOWN &&
+                core::mode_cells(viewport, layout.mode, cells)) {
+            return;
+        }
+        size_t cols = layout.cols, rows = layout.rows;
+        if (cols == 0 || rows == 0) {
+            // as square as possible, favoring extra columns on wide screens
+            cols = (size_t)ceil(sqrt((double)window_count));
+            rows = (window_count + cols - 1) / cols;
+        }
+        core::grid_cells(viewport, cols, rows, cells);
+    }
+
+    /* Each desktop's viewports have their own trees, each stored on the root
+     * window in its own property. */
+    Atom bsp_atom(Display* disp, long desktop, size_t viewport) {
+        char name[64];
+        if (desktop < 0) {
+            // no window manager to ask, assume there's one desktop
+            desktop = 0;
+        }
+        snprintf(name, sizeof(name), "_GRIDMGR_BSP_%ld_%lu", desktop, viewport);
+        return x11_util::intern_atom(disp, name);
+    }
+
+    void load_tree(Display* disp, Atom atom, BspTree& tree) {
+        size_t count = 0;
+        unsigned long* values = (unsigned long*)x11_util::get_property(disp,
+                DefaultRootWindow(disp), XA_CARDINAL, atom, &count);
+        if (values == NULL) {
+            // nothing's been tiled yet
+            return;
+        }
+        if (!tree.Deserialize(values, count)) {
+            ERROR("discarding invalid BSP layout");
+        }
+        x11_util::free_property(values);
+    }
+
+    void save_tree(Display* disp, Atom atom, const BspTree& tree) {
+        if (tree.Empty()) {
+            x11_util::set_property(disp, DefaultRootWindow(disp), XA_CARDINAL, atom, NULL, 0);
+            return;
+        }
+        std::vector<unsigned long> values;
+        tree.Serialize(values);
+        x11_util::set_property(disp, DefaultRootWindow(disp), XA_CARDINAL, atom,
+                &values[0], values.size());
+    }
+
+    /* Drops any windows which have been closed since the tree was saved. */
+    void prune_tree(Display* disp, BspTree& tree, BspTree::change_list_t& changes) {
+        size_t count = 0;
+        static thread_local Atom clientlist_msg = x11_util::intern_atom(disp, "_NET_CLIENT_LIST");
+        Window* clients = (Window*)x11_util::get_property(disp, DefaultRootWindow(disp),
+                XA_WINDOW, clientlist_msg, &count);
+        if (clients == NULL) {
+            return;
+        }
+        std::set<unsigned long> alive(clients, clients + count);
+        x11_util::free_property(clients);
+
+        std::vector<unsigned long> wins;
+        tree.Windows(wins);
+        for (size_t i = 0; i < wins.size(); ++i) {
+            if (alive.find(wins[i]) == alive.end()) {
+                DEBUG("window %lu went away, removing from layout", wins[i]);
+                tree.Remove(wins[i], changes);
+            }
+        }
+    }
+}
+
+bool tile::parse_layout(const char* arg, Layout& out) {
+    out = Layout();
+    if (strcmp(arg, "2col") == 0) {
+        out.mode = grid::MODE_TWO_COL;
+        return true;
+    } else if (strcmp(arg, "3col") == 0) {
+        out.mode = grid::MODE_THREE_COL_S;
+        return true;
+    } else if (strcmp(arg, "auto") == 0) {
+        return true;
+    }
+
+    char* end;
+    out.cols = strtoul(arg, &end, 10);
+    if (end == arg || *end != 'x') {
+        return false;
+    }
+    const char* rows = end + 1;
+    out.rows = strtoul(rows, &end, 10);
+    if (end == rows || *end != '\0') {
+        return false;
+    }
+    return out.cols > 0 && out.rows > 0 &&
+        out.cols <= MAX_CELLS_PER_SIDE && out.rows <= MAX_CELLS_PER_SIDE;
+}
+
+bool tile::parse_bsp(const char* arg, BSP_OP& out) {
+    if (strcmp(arg, "insert") == 0) {
+        out = BSP_INSERT;
+    } else if (strcmp(arg, "hsplit") == 0) {
+        out = BSP_HSPLIT;
+    } else if (strcmp(arg, "vsplit") == 0) {
+        out = BSP_VSPLIT;
+    } else if (strcmp(arg, "remove") == 0) {
+        out = BSP_REMOVE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool tile::run(const Layout& layout) {
+    Display* disp = x11_util::open_display();
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+
+    DesktopSnapshot snapshot;
+    if (!desktop::fetch_classified(disp, snapshot) || snapshot.viewports.empty()) {
+        x11_util::close_display(disp);
+        return false;
+    }
+
+    const WindowInfo* active = snapshot.active_info();
+    if (active == NULL || !active->managed) {
+        LOG("Active window is a desktop or dock. Ignoring tile request.");
+        x11_util::close_display(disp);
+        return false;
+    }
+
+    // everything on the same viewport and desktop as the active window
+    std::vector<const WindowInfo*> wins;
+    dim_list_t exteriors;
+    for (win_list_t::const_iterator iter = snapshot.windows.begin();
+         iter != snapshot.windows.end(); ++iter) {
+        if (!iter->managed || iter->viewport != active->viewport ||
+                !on_desktop(*iter, active->desktop) || iter->hidden) {
+            continue;
+        }
+        wins.push_back(&*iter);
+        exteriors.push_back(iter->exterior);
+    }
+    if (wins.empty()) {
+        // eg the active window is minimized
+        LOG("No windows to tile.");
+        x11_util::close_display(disp);
+        return false;
+    }
+
+    dim_list_t cells;
+    get_cells(layout, snapshot.viewports[active->viewport], wins.size(), cells);
+    std::vector<size_t> assigned;
+    core::assign_cells(exteriors, cells, assigned);
+    DEBUG("tiling %lu windows into %lu cells", wins.size(), cells.size());
+
+    // nothing needs a reply from here on, so all the moves go out together
+    bool ok = true;
+    for (size_t i = 0; i < wins.size(); ++i) {
+        Dimensions dim = cells[assigned[i]];
+        PositionCalc(wins[i]->exterior, wins[i]->hints).FitToHints(
+                snapshot.viewports[active->viewport], dim);
+        ActiveWindow win(disp, wins[i]->id);
+        win.SetMargins(wins[i]->margin_width, wins[i]->margin_height);
+        win.DeFullscreen();// disregard failure
+        if (!win.DeShade() || !win.MoveResize(dim)) {
+            ok = false;
+        }
+    }
+
+    x11_util::close_display(disp);// flushes the moves
+    return ok;
+}
+
+bool tile::bsp(BSP_OP op) {
+    Display* disp = x11_util::open_display();
+    if (disp == NULL) {
+        ERROR("unable to get display");
+        return false;
+    }
+
+    Window active, frame;
+    Dimensions active_dim;
+    unsigned int margin_width, margin_height;
+    if (!window::get_active(disp, active) ||
+            !window::get_size(disp, active, active_dim,
+                    margin_width, margin_height, frame)) {
+        x11_util::close_display(disp);
+        return false;
+    }
+    if (window::is_ignored(disp, active)) {
+        LOG("Active window is a desktop or dock. Ignoring tile request.");
+        x11_util::close_display(disp);
+        return false;
+    }
+
+    dim_list_t viewports;
+    size_t viewport;
+    if (!viewport::get_all(disp, active_dim, viewports, viewport)) {
+        x11_util::close_display(disp);
+        return false;
+    }
+
+    long desktop = -1;
+    window::get_current_desktop(disp, desktop);// disregard failure
+    Atom atom = bsp_atom(disp, desktop, viewport);
+    BspTree tree;
+    load_tree(disp, atom, tree);
+
+    BspTree::change_list_t changes;
+    const Dimensions& area = viewports[viewport];
+    const Dimensions& prev_area = tree.Area();
+    if (area.x != prev_area.x || area.y != prev_area.y ||
+            area.width != prev_area.width || area.height != prev_area.height) {
+        // eg the resolution or a panel changed
+        tree.SetArea(area, changes);
+    }
+    prune_tree(disp, tree, changes);
+
+    bool ok = true;
+    switch (op) {
+    case BSP_INSERT:
+    case BSP_HSPLIT:
+    case BSP_VSPLIT:
+        if (tree.Contains(active)) {
+            LOG("Active window is already tiled.");
+            break;
+        } else {
+            BspTree::SPLIT split = (op == BSP_HSPLIT) ? BspTree::SPLIT_HORIZONTAL :
+                ((op == BSP_VSPLIT) ? BspTree::SPLIT_VERTICAL : BspTree::SPLIT_AUTO);
+            // split whatever's under the middle of the window
+            unsigned long at = tree.WindowNear(active_dim.x + active_dim.width / 2,
+                    active_dim.y + active_dim.height / 2);
+            ok = tree.Insert(active, at, split, changes);
+        }
+        break;
+    case BSP_REMOVE:
+        if (!tree.Remove(active, changes)) {
+            LOG("Active window isn't tiled.");
+        }
+        break;
+    }
+
+    DEBUG("%lu windows changed", changes.size());
+    for (size_t i = 0; i < changes.size(); ++i) {
+        ActiveWindow win(disp, changes[i].window);
+        if (changes[i].window == active) {
+            win.SetMargins(margin_width, margin_height);
+        }
+        win.DeFullscreen();// disregard failure
+        if (!win.DeShade() || !win.MoveResize(changes[i].dim)) {
+            ok = false;
+        }
+    }
+    save_tree(disp, atom, tree);
+
+    x11_util::close_display(disp);// flushes the moves
+    return ok;
+}
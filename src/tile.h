@@ -0,0 +1,64 @@
+#ifndef GRIDMGR_TILE_H
+#define GRIDMGR_TILE_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+
+#include "position.h"
+
+namespace tile {
+    /* The cells to tile windows into: either the positions of a grid::MODE,
+     * or an arbitrary grid of cols x rows. If none of these are set, a grid
+     * is picked to fit the number of windows. */
+    struct Layout {
+        Layout() : mode(grid::MODE_UNKNOWN), cols(0), rows(0) { }
+
+        grid::MODE mode;
+        size_t cols, rows;
+    };
+
+    /* Parses "2col", "3col", "<cols>x<rows>" (eg "4x3"), or "auto".
+     * Returns false if 'arg' isn't any of these. */
+    bool parse_layout(const char* arg, Layout& out);
+
+    /* Moves every unminimized window which shares the active window's
+     * viewport and desktop into the cells of 'layout', keeping them in
+     * roughly the same order. Returns true on success, else false. */
+    bool run(const Layout& layout);
+
+    enum BSP_OP {
+        BSP_INSERT,// split whichever window the active window is over
+        BSP_HSPLIT,// same, but always side by side
+        BSP_VSPLIT,// same, but always stacked
+        BSP_REMOVE// give the active window's space back to its neighbors
+    };
+
+    /* Parses "insert", "hsplit", "vsplit", or "remove".
+     * Returns false if 'arg' isn't any of these. */
+    bool parse_bsp(const char* arg, BSP_OP& out);
+
+    /* Adds the active window to, or removes it from, the BSP layout of its
+     * viewport. The layout is kept on the root window between runs. Only the
+     * windows whose space changes are moved.
+     * Returns true on success, else false. */
+    bool bsp(BSP_OP op);
+}
+
+#endif
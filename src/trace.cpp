@@ -0,0 +1,147 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "io-util.h"
+#include "trace.h"
+
+/* Size at which the trace file is moved aside. */
+#define ROTATE_BYTES (8 * 1024 * 1024)
+
+namespace {
+    struct Event {
+        const char* name;
+        unsigned long start_us, dur_us;
+        long tid;
+    };
+
+    std::mutex events_mutex;
+    std::vector<Event> events;
+    std::string trace_path;
+
+    long thread_id() {
+        return syscall(SYS_gettid);
+    }
+
+    void append_escaped(const char* str, std::string& out) {
+        for (; *str != '\0'; ++str) {
+            if (*str == '"' || *str == '\\') {
+                out += '\\';
+            }
+            out += ((unsigned char)*str < 0x20) ? ' ' : *str;
+        }
+    }
+
+    void flush_at_exit() {
+        trace::flush();
+    }
+}
+
+namespace trace {
+    bool active = false;
+}
+
+bool trace::open(const char* path) {
+    int fd = ::open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        ERROR("unable to open trace file %s: %s", path, strerror(errno));
+        return false;
+    }
+    close(fd);
+    if (!active) {
+        atexit(flush_at_exit);
+    }
+    trace_path = path;
+    active = true;
+    return true;
+}
+
+unsigned long trace::now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+void trace::record(const char* name, unsigned long start_us, unsigned long end_us) {
+    Event event;
+    event.name = name;
+    event.start_us = start_us;
+    event.dur_us = end_us - start_us;
+    event.tid = thread_id();
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.push_back(event);
+}
+
+void trace::flush() {
+    std::vector<Event> flushing;
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        flushing.swap(events);
+    }
+    if (flushing.empty() || trace_path.empty()) {
+        return;
+    }
+
+    struct stat st;
+    if (stat(trace_path.c_str(), &st) == 0 && st.st_size > ROTATE_BYTES) {
+        std::string old_path = trace_path + ".1";
+        if (rename(trace_path.c_str(), old_path.c_str()) != 0) {
+            ERROR("unable to rotate trace file %s: %s", trace_path.c_str(), strerror(errno));
+        }
+    }
+    int fd = ::open(trace_path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        ERROR("unable to open trace file %s: %s", trace_path.c_str(), strerror(errno));
+        return;
+    }
+
+    /* the JSON array format allows leaving off the closing ']', which lets
+       each process just append its events */
+    std::string out;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        out += "[\n";
+    }
+    long pid = getpid();
+    char buf[128];
+    for (size_t i = 0; i < flushing.size(); ++i) {
+        const Event& event = flushing[i];
+        out += "{\"name\":\"";
+        append_escaped(event.name, out);
+        snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%lu,\"pid\":%ld,\"tid\":%ld},\n",
+                event.start_us, event.dur_us, pid, event.tid);
+        out += buf;
+    }
+    // a single write, so that concurrent gridmgrs don't interleave their events
+    if (!io_util::write_all(fd, out.data(), out.size())) {
+        ERROR("unable to write trace file %s: %s", trace_path.c_str(), strerror(errno));
+    }
+    close(fd);
+}
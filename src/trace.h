@@ -0,0 +1,82 @@
+#ifndef GRIDMGR_TRACE_H
+#define GRIDMGR_TRACE_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stats.h"
+
+/* Records how long each stage of a command takes, as nested spans in Chrome's
+ * trace event format. The resulting file can be opened in Perfetto
+ * (ui.perfetto.dev) or chrome://tracing.
+ *
+ * Spans are only recorded after trace::open(). The same spans also feed the
+ * daemon's per-stage histograms once stats::enable() is called. Until either
+ * is called, a span costs a check of two flags. */
+namespace trace {
+    /* Starts recording spans, which are appended to 'path' by flush() and at
+     * exit. Once the file grows past a few MB it's moved to '<path>.1' and a
+     * new one is started, so tracing may be left on indefinitely.
+     * Returns false if 'path' can't be written to. */
+    bool open(const char* path);
+
+    /* Appends any spans recorded so far to the file. */
+    void flush();
+
+    /* DONT USE THESE DIRECTLY, use TraceSpan/TRACE_SPAN() instead. */
+    extern bool active;
+    unsigned long now_us();
+    void record(const char* name, unsigned long start_us, unsigned long end_us);
+
+    /* The two halves of a span, also used for gridmgr_core's spans (see
+     * core-hooks.h). span_begin() returns 0 if nothing is being recorded. */
+    inline unsigned long span_begin() {
+        return (active || stats::active) ? now_us() : 0;
+    }
+    inline void span_end(const char* name, unsigned long start_us) {
+        unsigned long end_us = now_us();
+        if (active) {
+            record(name, start_us, end_us);
+        }
+        stats::record_stage(name, end_us - start_us);
+    }
+}
+
+/* Records a span from construction until destruction. 'name' must be a
+ * string literal. */
+class TraceSpan {
+public:
+    TraceSpan(const char* name)
+        : name(name), start_us(trace::span_begin()) { }
+    ~TraceSpan() {
+        if (start_us != 0) {
+            trace::span_end(name, start_us);
+        }
+    }
+
+private:
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+
+    const char* name;
+    const unsigned long start_us;
+};
+
+#define TRACE_SPAN(name) TraceSpan _trace_span(name)
+
+#endif
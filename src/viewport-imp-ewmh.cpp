@@ -26,7 +26,7 @@ bool viewport::ewmh::get_viewports(Display* disp, const Dimensions& /*activewin*
     unsigned long cur_workspace;
     {
         unsigned long* cur_ptr;
-        static Atom curdesk_msg = XInternAtom(disp, "_NET_CURRENT_DESKTOP", False);
+        static thread_local Atom curdesk_msg = x11_util::intern_atom(disp, "_NET_CURRENT_DESKTOP");
         if (!(cur_ptr = (unsigned long *)x11_util::get_property(disp, DefaultRootWindow(disp),
                                 XA_CARDINAL, curdesk_msg, NULL))) {
             ERROR("unable to retrieve current desktop");
@@ -38,7 +38,7 @@ bool viewport::ewmh::get_viewports(Display* disp, const Dimensions& /*activewin*
 
     unsigned long* area;
     size_t area_count = 0;//number of areas returned, one per workspace. each area contains 4 ulongs.
-    static Atom workarea_msg = XInternAtom(disp, "_NET_WORKAREA", False);
+    static thread_local Atom workarea_msg = x11_util::intern_atom(disp, "_NET_WORKAREA");
     if (!(area = (unsigned long*)x11_util::get_property(disp, DefaultRootWindow(disp),
                             XA_CARDINAL, workarea_msg, &area_count))) {
         ERROR("unable to retrieve spanning workarea");
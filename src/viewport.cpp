@@ -19,8 +19,12 @@
 #include <cstddef>
 
 #include "config.h"
-#include "neighbor.h"
+#include "core.h"
+#include "probes.h"
+#include "runtime-cache.h"
+#include "trace.h"
 #include "viewport.h"
+#include "x11-util.h"
 
 #include "viewport-imp-ewmh.h"
 #ifdef USE_XINERAMA
@@ -28,48 +32,78 @@
 #endif
 
 namespace {
-    bool get_all(const Dimensions& activewin,
+    bool get_all_disp(const Dimensions& activewin,
             dim_list_t& viewports, size_t& active) {
-        Display* disp = XOpenDisplay(NULL);
+        PROBE(display_open_start);
+        Display* disp;
+        {
+            TRACE_SPAN("display_open");
+            disp = x11_util::open_display();
+        }
+        PROBE1(display_open_done, disp != NULL);
         if (disp == NULL) {
             ERROR("unable to get display");
             return false;
         }
+        bool ok = viewport::get_all(disp, activewin, viewports, active);
+        PROBE2(viewports_fetched, viewports.size(), PROBE_REQUESTS(disp));
+        x11_util::close_display(disp);
+        return ok;
+    }
+}
+
+bool viewport::get_all(Display* disp, const Dimensions& activewin,
+        dim_list_t& viewports, size_t& active) {
+    TRACE_SPAN("get_viewports");
+    if (runtime_cache::find_viewports(disp, viewports)) {
+        active = core::active_viewport(viewports, activewin);
+        return true;
+    }
 
 #ifdef USE_XINERAMA
-        //try xinerama, fall back to ewmh if xinerama is unavailable
-        bool ok = viewport::xinerama::get_viewports(disp, activewin, viewports, active) ||
-            viewport::ewmh::get_viewports(disp, activewin, viewports, active);
+    //try xinerama, fall back to ewmh if xinerama is unavailable
+    bool ok = viewport::xinerama::get_viewports(disp, activewin, viewports, active) ||
+        viewport::ewmh::get_viewports(disp, activewin, viewports, active);
 #else
-        //xinerama disabled; just do ewmh
-        bool ok = viewport::ewmh::get_viewports(disp, activewin, viewports, active);
+    //xinerama disabled; just do ewmh
+    bool ok = viewport::ewmh::get_viewports(disp, activewin, viewports, active);
 #endif
 
-        if (config::debug_enabled) {
-            for (size_t i = 0; i < viewports.size(); ++i) {
-                const Dimensions& v = viewports[i];
-                DEBUG("viewport %lu: %dx %dy %luw %luh",
-                        i, v.x, v.y, v.width, v.height);
-            }
+    if (config::debug_enabled) {
+        for (size_t i = 0; i < viewports.size(); ++i) {
+            const Dimensions& v = viewports[i];
+            DEBUG("viewport %lu: %dx %dy %luw %luh",
+                    i, v.x, v.y, v.width, v.height);
         }
+    }
 
-        XCloseDisplay(disp);
-        return ok;
+    if (ok) {
+        runtime_cache::save_viewports(disp, viewports);
     }
+
+    return ok;
 }
 
 bool ViewportCalc::Viewports(grid::POS monitor,
         Dimensions& cur_viewport, Dimensions& next_viewport) const {
-    dim_list_t viewports;
+    TRACE_SPAN("viewports");
+    dim_list_t fetched;
+    const dim_list_t* viewports_ptr = &fetched;
     size_t active, neighbor;
-    if (!get_all(activewin, viewports, active)) {
+    if (cached_viewports != NULL && !cached_viewports->empty()) {
+        // read in place: copying them would allocate on every daemon command
+        viewports_ptr = cached_viewports;
+        active = core::active_viewport(*viewports_ptr, activewin);
+    } else if (!get_all_disp(activewin, fetched, active)) {
         return false;
     }
+    const dim_list_t& viewports = *viewports_ptr;
 
     neighbor::select(monitor, viewports, active, neighbor);
 
     cur_viewport = viewports[active];
     next_viewport = viewports[neighbor];
+    PROBE4(viewports, viewports.size(), active, neighbor, cached_viewports != NULL);
 
     DEBUG("cur viewport: %dx %dy %dw %dh",
             cur_viewport.x, cur_viewport.y, cur_viewport.width, cur_viewport.height);
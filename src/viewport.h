@@ -19,19 +19,35 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <vector>
+#include <X11/Xlib.h>
+
 #include "dimensions.h"
 #include "pos.h"
 
+typedef std::vector<Dimensions> dim_list_t;
+
+namespace viewport {
+    /* Gets all viewports with struts trimmed, and the index of the viewport
+     * containing most of 'activewin'. Returns true on success, else false. */
+    bool get_all(Display* disp, const Dimensions& activewin,
+            dim_list_t& viewports, size_t& active);
+}
+
 class ViewportCalc {
 public:
-    ViewportCalc(const Dimensions& activewin)
-        : activewin(activewin) { }
+    /* If 'cached_viewports' is provided and non-empty, it's used instead of
+     * fetching the viewports from the display. */
+    ViewportCalc(const Dimensions& activewin,
+            const dim_list_t* cached_viewports = NULL)
+        : activewin(activewin), cached_viewports(cached_viewports) { }
 
     bool Viewports(grid::POS monitor,
             Dimensions& cur_viewport, Dimensions& next_viewport) const;
 
 private:
     const Dimensions activewin;
+    const dim_list_t* cached_viewports;
 };
 
 #endif
@@ -0,0 +1,180 @@
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/sync.h>
+
+#include "config.h"
+#include "window-sync.h"
+#include "x11-util.h"
+
+/* How long to wait for a client to catch up before giving up on it. Clients
+   which hang or ignore the request shouldn't block all future moves. */
+#define SYNC_TIMEOUT_MS 200
+
+namespace {
+    typedef long long sync_value_t;
+
+    unsigned long now_ms() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+    }
+
+    bool init_sync(Display* disp) {
+        static thread_local int init = -1;// per-thread: each daemon thread has its own display
+        if (init < 0) {
+            int event_base, error_base, major, minor;
+            init = (XSyncQueryExtension(disp, &event_base, &error_base) &&
+                    XSyncInitialize(disp, &major, &minor)) ? 1 : 0;
+            if (init == 0) {
+                DEBUG("xsync not loaded or unavailable");
+            }
+        }
+        return init == 1;
+    }
+
+    bool supports_sync(Display* disp, Window win) {
+        Atom* protocols;
+        int count = 0;
+        if (XGetWMProtocols(disp, win, &protocols, &count) == 0) {
+            return false;
+        }
+        static thread_local Atom sync_msg = x11_util::intern_atom(disp, "_NET_WM_SYNC_REQUEST");
+        bool ret = false;
+        for (int i = 0; i < count; ++i) {
+            if (protocols[i] == sync_msg) {
+                ret = true;
+                break;
+            }
+        }
+        XFree(protocols);
+        return ret;
+    }
+
+    /* Gets the window's current counter value, or returns false if the window
+       doesn't support sync requests. */
+    bool get_counter(Display* disp, Window win,
+            XSyncCounter& counter_out, sync_value_t& value_out) {
+        if (!init_sync(disp) || !supports_sync(disp, win)) {
+            return false;
+        }
+
+        // may have 1 (basic) or 2 (basic + extended) counters, we want the first
+        size_t count = 0;
+        static thread_local Atom counter_msg = x11_util::intern_atom(disp, "_NET_WM_SYNC_REQUEST_COUNTER");
+        unsigned long* counters = (unsigned long*)x11_util::get_property(disp, win,
+                XA_CARDINAL, counter_msg, &count);
+        if (counters == NULL) {
+            DEBUG("window %lu lacks a sync counter", win);
+            return false;
+        }
+        if (count == 0) {
+            x11_util::free_property(counters);
+            return false;
+        }
+        counter_out = counters[0];
+        x11_util::free_property(counters);
+
+        XSyncValue value;
+        if (!XSyncQueryCounter(disp, counter_out, &value)) {
+            ERROR("unable to query sync counter %lu", counter_out);
+            return false;
+        }
+        value_out = ((sync_value_t)XSyncValueHigh32(value) << 32) |
+            XSyncValueLow32(value);
+        return true;
+    }
+
+    Atom pending_atom(Display* disp) {
+        static thread_local Atom pending_msg = x11_util::intern_atom(disp, "_GRIDMGR_SYNC_PENDING");
+        return pending_msg;
+    }
+}
+
+bool window::sync::ready(Display* disp, Window win) {
+    // pending = {value_hi, value_lo, request time in ms}
+    size_t count = 0;
+    unsigned long* pending = (unsigned long*)x11_util::get_property(disp, win,
+            XA_CARDINAL, pending_atom(disp), &count);
+    if (pending == NULL) {
+        // no outstanding request
+        return true;
+    }
+    if (count != 3) {//nice to have
+        ERROR("incorrect number of pending sync values: got %lu, expected 3", count);
+        x11_util::free_property(pending);
+        return true;
+    }
+    sync_value_t pending_value = ((sync_value_t)pending[0] << 32) | (pending[1] & 0xffffffff);
+    unsigned long elapsed_ms = (now_ms() - pending[2]) & 0xffffffff;
+    x11_util::free_property(pending);
+
+    if (elapsed_ms > SYNC_TIMEOUT_MS) {
+        DEBUG("sync request %lld timed out after %lums", pending_value, elapsed_ms);
+        return true;
+    }
+
+    XSyncCounter counter;
+    sync_value_t value;
+    if (!get_counter(disp, win, counter, value)) {
+        return true;
+    }
+    DEBUG("sync counter %lu: %lld of %lld (%lums elapsed)",
+            counter, value, pending_value, elapsed_ms);
+    return value >= pending_value;
+}
+
+bool window::sync::request(Display* disp, Window win) {
+    XSyncCounter counter;
+    sync_value_t value;
+    if (!get_counter(disp, win, counter, value)) {
+        return false;
+    }
+    ++value;
+
+    static thread_local Atom protocols_msg = x11_util::intern_atom(disp, "WM_PROTOCOLS"),
+        sync_msg = x11_util::intern_atom(disp, "_NET_WM_SYNC_REQUEST");
+    XEvent event;
+    event.xclient.type = ClientMessage;
+    event.xclient.serial = 0;
+    event.xclient.send_event = True;
+    event.xclient.message_type = protocols_msg;
+    event.xclient.window = win;
+    event.xclient.format = 32;
+    event.xclient.data.l[0] = sync_msg;
+    event.xclient.data.l[1] = CurrentTime;
+    event.xclient.data.l[2] = value & 0xffffffff;
+    event.xclient.data.l[3] = (value >> 32) & 0xffffffff;
+    event.xclient.data.l[4] = 0;
+
+    DEBUG("send sync request %lld to window %lu", value, win);
+    if (!XSendEvent(disp, win, False, NoEventMask, &event)) {
+        ERROR("Cannot send sync request to window %lu.", win);
+        return false;
+    }
+
+    unsigned long pending[3];
+    pending[0] = (value >> 32) & 0xffffffff;
+    pending[1] = value & 0xffffffff;
+    pending[2] = now_ms() & 0xffffffff;
+    XChangeProperty(disp, win, pending_atom(disp), XA_CARDINAL, 32,
+            PropModeReplace, (unsigned char*)pending, 3);
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef GRIDMGR_WINDOW_SYNC_H
+#define GRIDMGR_WINDOW_SYNC_H
+
+/*
+  gridmgr - Organizes windows according to a grid.
+  Copyright (C) 2012  Nicholas Parker
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <X11/Xlib.h>
+
+#include "config.h"
+
+#ifndef USE_XSYNC
+#error "Build configuration error:"
+#error " Shouldn't be building this file if USE_XSYNC is disabled."
+#endif
+
+namespace window {
+    namespace sync {
+        /* Returns whether the window has finished redrawing after the last
+         * resize we sent it. Windows which don't support _NET_WM_SYNC_REQUEST
+         * are always ready. */
+        bool ready(Display* disp, Window win);
+
+        /* Sends a _NET_WM_SYNC_REQUEST to the window, to be followed by a
+         * resize. The request is stored on the window itself so that it's
+         * visible to later invocations. Returns false if the window doesn't
+         * support sync requests, or if sending the request failed. */
+        bool request(Display* disp, Window win);
+    }
+}
+
+#endif
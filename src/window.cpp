@@ -16,37 +16,40 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <X11/Xutil.h>
+
 #include "config.h"
 #include "neighbor.h"
+#include "probes.h"
+#include "runtime-cache.h"
+#include "stats.h"
+#include "trace.h"
 #include "window.h"
 #include "x11-util.h"
+#ifdef USE_XSYNC
+#include "window-sync.h"
+#endif
 
 #define SOURCE_INDICATION 2 //say that we're a pager or taskbar
 
 namespace {
+    Display* open_display() {
+        TRACE_SPAN("display_open");
+        return x11_util::open_display();
+    }
+
     int _client_msg(Display* disp, Window win, Atom msg,
             unsigned long data0, unsigned long data1,
             unsigned long data2, unsigned long data3,
             unsigned long data4) {
-        XEvent event;
-        long mask = SubstructureRedirectMask | SubstructureNotifyMask;
-
-        event.xclient.type = ClientMessage;
-        event.xclient.serial = 0;
-        event.xclient.send_event = True;
-        event.xclient.message_type = msg;
-        event.xclient.window = win;
-        event.xclient.format = 32;
-        event.xclient.data.l[0] = data0;
-        event.xclient.data.l[1] = data1;
-        event.xclient.data.l[2] = data2;
-        event.xclient.data.l[3] = data3;
-        event.xclient.data.l[4] = data4;
-
-        DEBUG("send message_type=%s, data=(%lu,%lu,%lu,%lu,%lu)",
-                XGetAtomName(disp, msg), data0, data1, data2, data3, data4);
-
-        if (XSendEvent(disp, DefaultRootWindow(disp), False, mask, &event)) {
+        if (config::debug_enabled) {
+            // the name is a round trip, skip it unless it's being printed
+            DEBUG("send message_type=%s, data=(%lu,%lu,%lu,%lu,%lu)",
+                    x11_util::atom_name(disp, msg).c_str(),
+                    data0, data1, data2, data3, data4);
+        }
+
+        if (x11_util::send_message(disp, win, msg, data0, data1, data2, data3, data4)) {
             return true;
         } else {
             ERROR("Cannot send %s event.", msg);
@@ -59,7 +62,7 @@ namespace {
         Window root;
         int x, y;
         unsigned int width, height, border, depth;
-        if (XGetGeometry(disp, win, &root, &x, &y, &width,
+        if (x11_util::get_geometry(disp, win, &root, &x, &y, &width,
                         &height, &border, &depth) == 0) {
             ERROR("get geometry failed");
             return;
@@ -67,84 +70,180 @@ namespace {
         DEBUG("  %dx %dy %uw %uh %ub", x, y, width, height, border);
     }
 
-    Window* get_active_window(Display* disp) {
-        static Atom actwin_msg = XInternAtom(disp, "_NET_ACTIVE_WINDOW", False);
-        Window* ret = (Window*)x11_util::get_property(disp, DefaultRootWindow(disp),
-                XA_WINDOW, actwin_msg, NULL);
-        if (ret == NULL) {
+    bool get_active_window(Display* disp, Window& out) {
+        static thread_local Atom actwin_msg = x11_util::intern_atom(disp, "_NET_ACTIVE_WINDOW");
+        TRACE_SPAN("get_active_window");
+        // run on every command, so skip the allocation
+        size_t count = 0;
+        bool ok = x11_util::get_values(disp, DefaultRootWindow(disp),
+                XA_WINDOW, actwin_msg, &out, 1, &count) && count == 1;
+        if (!ok) {
             ERROR("unable to get active window");
         }
+        PROBE2(active_window, ok ? out : 0, PROBE_REQUESTS(disp));
+        return ok;
+    }
+
+    /* disallow moving/selecting this window if it has type DESKTOP or DOCK.
+       (avoid messing with the user's desktop components, eg taskbars) */
+    bool has_dock_type(Display* disp, Window win, const Atom* types, size_t count) {
+        static thread_local Atom desktop_type = x11_util::intern_atom(disp, "_NET_WM_WINDOW_TYPE_DESKTOP"),
+            dock_type = x11_util::intern_atom(disp, "_NET_WM_WINDOW_TYPE_DOCK");
+        bool ret = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (config::debug_enabled) {
+                DEBUG("%d type %lu: %d %s",
+                        win, i, types[i], x11_util::atom_name(disp, types[i]).c_str());
+            }
+            if (types[i] == desktop_type || types[i] == dock_type) {
+                ret = true;
+                if (!config::debug_enabled) {
+                    break;
+                }
+            }
+        }
+        return ret;
+    }
+
+    /* also disallow moving/selecting this window if it has SKIP_PAGER or SKIP_TASKBAR.
+       (avoid messing with auxiliary panels and menus) */
+    bool has_menu_state(Display* disp, Window win, const Atom* states, size_t count) {
+        static thread_local Atom skip_pager = x11_util::intern_atom(disp, "_NET_WM_STATE_SKIP_PAGER"),
+            skip_taskbar = x11_util::intern_atom(disp, "_NET_WM_STATE_SKIP_TASKBAR");
+        bool ret = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (config::debug_enabled) {
+                DEBUG("%d state %lu: %d %s",
+                        win, i, states[i], x11_util::atom_name(disp, states[i]).c_str());
+            }
+            if (states[i] == skip_pager || states[i] == skip_taskbar) {
+                ret = true;
+                if (!config::debug_enabled) {
+                    break;
+                }
+            }
+        }
         return ret;
     }
 
+    bool has_hidden_state(Display* disp, const Atom* states, size_t count) {
+        static thread_local Atom hidden = x11_util::intern_atom(disp, "_NET_WM_STATE_HIDDEN");
+        for (size_t i = 0; i < count; ++i) {
+            if (states[i] == hidden) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool is_dock_window(Display* disp, Window win) {
-        /* disallow moving/selecting this window if it has type DESKTOP or DOCK.
-           (avoid messing with the user's desktop components, eg taskbars) */
         bool ret = false;
         size_t count = 0;
-        static Atom wintype_msg = XInternAtom(disp, "_NET_WM_WINDOW_TYPE", False);
+        static thread_local Atom wintype_msg = x11_util::intern_atom(disp, "_NET_WM_WINDOW_TYPE");
         Atom* types = (Atom*)x11_util::get_property(disp, win, XA_ATOM, wintype_msg, &count);
         if (types == NULL) {
             ERROR("couldn't get window types");
             //assume window types are fine, keep going
         } else {
-            static Atom desktop_type = XInternAtom(disp, "_NET_WM_WINDOW_TYPE_DESKTOP", False),
-                dock_type = XInternAtom(disp, "_NET_WM_WINDOW_TYPE_DOCK", False);
-            for (size_t i = 0; i < count; ++i) {
-                DEBUG("%d type %lu: %d %s",
-                        win, i, types[i], XGetAtomName(disp, types[i]));
-                if (types[i] == desktop_type || types[i] == dock_type) {
-                    ret = true;
-                    if (!config::debug_enabled) {
-                        break;
-                    }
-                }
-            }
+            ret = has_dock_type(disp, win, types, count);
             x11_util::free_property(types);
         }
         return ret;
     }
 
     bool is_menu_window(Display* disp, Window win) {
-        /* also disallow moving/selecting this window if it has SKIP_PAGER or SKIP_TASKBAR.
-           (avoid messing with auxiliary panels and menus) */
         bool ret = false;
         size_t count = 0;
-        static Atom state_msg = XInternAtom(disp, "_NET_WM_STATE", False);
+        static thread_local Atom state_msg = x11_util::intern_atom(disp, "_NET_WM_STATE");
         Atom* states = (Atom*)x11_util::get_property(disp, win, XA_ATOM, state_msg, &count);
         if (states == NULL) {
             ERROR("couldn't get window states");
             //assume window states are fine, keep going
         } else {
-            static Atom skip_pager = XInternAtom(disp, "_NET_WM_STATE_SKIP_PAGER", False),
-                skip_taskbar = XInternAtom(disp, "_NET_WM_STATE_SKIP_TASKBAR", False);
-            for (size_t i = 0; i < count; ++i) {
-                DEBUG("%d state %lu: %d %s",
-                        win, i, states[i], XGetAtomName(disp, states[i]));
-                if (states[i] == skip_pager || states[i] == skip_taskbar) {
-                    ret = true;
-                    if (!config::debug_enabled) {
-                        break;
-                    }
-                }
-            }
+            ret = has_menu_state(disp, win, states, count);
             x11_util::free_property(states);
         }
         return ret;
     }
 
+    /* Returns whether 'frame' is a child of the root window, and is either
+     * 'win' itself or its parent. */
+    bool is_frame_of(Display* disp, Window frame, Window win, Window* out_root) {
+        Window parent;
+        Window* children;
+        unsigned int children_count;
+        if (x11_util::query_tree(disp, frame, out_root,
+                        &parent, &children, &children_count) == 0) {
+            return false;
+        }
+        bool ret = false;
+        if (parent == *out_root) {
+            ret = frame == win;
+            for (unsigned int i = 0; !ret && i < children_count; ++i) {
+                ret = children[i] == win;
+            }
+        }
+        if (children != NULL) {
+            XFree(children);
+        }
+        return ret;
+    }
+
     bool get_window_size(Display* disp, Window win,
             Dimensions* out_exterior = NULL,
             unsigned int* out_margin_width = NULL,
-            unsigned int* out_margin_height = NULL) {
+            unsigned int* out_margin_height = NULL,
+            Window* out_frame = NULL) {
+        TRACE_SPAN("get_window_size");
         Window root;
+        {
+            // if we've seen this window before, only its frame needs checking
+            Window frame;
+            unsigned int margin_width, margin_height;
+            if (runtime_cache::find_frame(disp, win, frame, margin_width, margin_height)) {
+                /* the frame may have been destroyed and its id reused since,
+                   so make sure that it's still a top-level window holding
+                   this one, without letting errors end the process */
+                int x, y;
+                unsigned int width, height, border, depth;
+                x11_util::trap_errors(disp);
+                bool ok = is_frame_of(disp, frame, win, &root) &&
+                    x11_util::get_geometry(disp, frame, &root, &x, &y, &width,
+                            &height, &border, &depth) != 0;
+                if (x11_util::untrap_errors(disp)) {
+                    ok = false;
+                }
+                if (ok) {
+                    if (out_exterior != NULL) {
+                        out_exterior->x = x;
+                        out_exterior->y = y;
+                        out_exterior->width = width;
+                        out_exterior->height = height;
+                    }
+                    if (out_margin_width != NULL) {
+                        *out_margin_width = margin_width;
+                    }
+                    if (out_margin_height != NULL) {
+                        *out_margin_height = margin_height;
+                    }
+                    if (out_frame != NULL) {
+                        *out_frame = frame;
+                    }
+                    return true;
+                }
+                // frame is gone (window was reparented?), look it up again
+                DEBUG("cached frame %lu no longer holds window %lu", frame, win);
+                runtime_cache::forget_frame(disp, win);
+            }
+        }
+
         unsigned int internal_width, internal_height;
         {
             /* first, get the interior width/height from this window
                (so that we can calculate margins) */
             int x, y;
             unsigned int border, depth;
-            if (XGetGeometry(disp, win, &root, &x, &y, &internal_width,
+            if (x11_util::get_geometry(disp, win, &root, &x, &y, &internal_width,
                             &internal_height, &border, &depth) == 0) {
                 ERROR("get geometry failed");
                 return false;
@@ -158,7 +257,7 @@ namespace {
 
         /* now traverse up the parents until we reach the one JUST BEFORE root,
            and get the external width/height and x/y from that. */
-        Window just_before_root;
+        Window just_before_root, first_parent = None;
         {
             int count = 1;
             Window parent = win;
@@ -166,11 +265,14 @@ namespace {
             unsigned int children_count;
             do {
                 just_before_root = parent;
-                if (XQueryTree(disp, just_before_root, &root,
+                if (x11_util::query_tree(disp, just_before_root, &root,
                                 &parent, &children, &children_count) == 0) {
                     ERROR("get query tree failed");
                     return false;
                 }
+                if (count == 1) {
+                    first_parent = parent;
+                }
                 if (children != NULL) {
                     XFree(children);
                 }
@@ -184,7 +286,7 @@ namespace {
         unsigned int external_width, external_height;
         {
             unsigned int border, depth;
-            if (XGetGeometry(disp, just_before_root, &root, &x, &y, &external_width,
+            if (x11_util::get_geometry(disp, just_before_root, &root, &x, &y, &external_width,
                             &external_height, &border, &depth) == 0) {
                 ERROR("get geometry failed");
                 return false;
@@ -204,6 +306,15 @@ namespace {
         if (out_margin_height != NULL) {
             *out_margin_height = external_height - internal_height;
         }
+        if (out_frame != NULL) {
+            *out_frame = just_before_root;
+        }
+
+        if (just_before_root == win || just_before_root == first_parent) {
+            // deeper frames would take as long to check as to look up again
+            runtime_cache::save_frame(disp, win, just_before_root,
+                    external_width - internal_width, external_height - internal_height);
+        }
 
         DEBUG("size: exterior %uw %uh - interior %uw %uh = margins %dw %dh",
                 external_width, external_height,
@@ -214,7 +325,7 @@ namespace {
     }
 
     bool activate_window(Display* disp, Window curactive, Window newactive) {
-        static Atom active_msg = XInternAtom(disp, "_NET_ACTIVE_WINDOW", False);
+        static thread_local Atom active_msg = x11_util::intern_atom(disp, "_NET_ACTIVE_WINDOW");
         if (!_client_msg(disp, newactive, active_msg,
                         SOURCE_INDICATION, CurrentTime, curactive, 0, 0)) {
             ERROR("couldn't activate");
@@ -231,66 +342,249 @@ namespace {
         */
 
         int val = (enable) ? 1 : 0;// just to be explicit
-        static Atom state_msg = XInternAtom(disp, "_NET_WM_STATE", False);
+        static thread_local Atom state_msg = x11_util::intern_atom(disp, "_NET_WM_STATE");
         return _client_msg(disp, win, state_msg,
                 val, state1, state2, SOURCE_INDICATION, 0);
     }
 
     bool maximize_window(Display* disp, Window win, bool enable) {
-        static Atom max_vert = XInternAtom(disp, "_NET_WM_STATE_MAXIMIZED_VERT", False),
-            max_horiz = XInternAtom(disp, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
+        static thread_local Atom max_vert = x11_util::intern_atom(disp, "_NET_WM_STATE_MAXIMIZED_VERT"),
+            max_horiz = x11_util::intern_atom(disp, "_NET_WM_STATE_MAXIMIZED_HORZ");
         return set_window_state(disp, win, max_vert, max_horiz, enable);
     }
 }
 
-bool window::select_activate(grid::POS dir) {
-    Display* disp = XOpenDisplay(NULL);
+bool window::is_ignored(Display* disp, Window win) {
+    return is_dock_window(disp, win) || is_menu_window(disp, win);
+}
+
+void window::find_ignored(Display* disp, const Window* wins, size_t count,
+        std::vector<bool>& out, std::vector<bool>* hidden_out) {
+    TRACE_SPAN("find_ignored");
+    // both properties for every window, in two round trips
+    static thread_local Atom wintype_msg = x11_util::intern_atom(disp, "_NET_WM_WINDOW_TYPE"),
+        state_msg = x11_util::intern_atom(disp, "_NET_WM_STATE");
+    prop_list_t types, states;
+    x11_util::get_properties(disp, wins, count, XA_ATOM, wintype_msg, types);
+    x11_util::get_properties(disp, wins, count, XA_ATOM, state_msg, states);
+
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        // windows which lack either property are fine
+        out[i] = (types[i].data != NULL &&
+                has_dock_type(disp, wins[i], (const Atom*)types[i].data, types[i].count)) ||
+            (states[i].data != NULL &&
+                    has_menu_state(disp, wins[i], (const Atom*)states[i].data, states[i].count));
+    }
+    if (hidden_out != NULL) {
+        hidden_out->resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            (*hidden_out)[i] = states[i].data != NULL &&
+                has_hidden_state(disp, (const Atom*)states[i].data, states[i].count);
+        }
+    }
+    x11_util::free_properties(types);
+    x11_util::free_properties(states);
+}
+
+bool window::get_class(Display* disp, Window win, std::string& out_instance,
+        std::string& out_class, std::string& out_role) {
+    std::vector<Class> classes;
+    get_classes(disp, &win, 1, classes);
+    if (!classes[0].found) {
+        return false;
+    }
+    out_instance.swap(classes[0].instance);
+    out_class.swap(classes[0].wm_class);
+    out_role.swap(classes[0].role);
+    return true;
+}
+
+void window::get_classes(Display* disp, const Window* wins, size_t count,
+        std::vector<Class>& out) {
+    static thread_local Atom role_msg = x11_util::intern_atom(disp, "WM_WINDOW_ROLE");
+    prop_list_t hints, roles;
+    x11_util::get_properties(disp, wins, count, XA_STRING, XA_WM_CLASS, hints);
+    x11_util::get_properties(disp, wins, count, XA_STRING, role_msg, roles);
+
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        Class& cls = out[i];
+        cls.found = hints[i].data != NULL;
+        if (cls.found) {
+            // WM_CLASS is "instance\0class\0", always nul-terminated
+            const char* hint = (const char*)hints[i].data;
+            cls.instance = hint;
+            size_t instance_len = cls.instance.size();
+            cls.wm_class = (instance_len + 1 < hints[i].count) ? hint + instance_len + 1 : "";
+        } else {
+            cls.instance.clear();
+            cls.wm_class.clear();
+        }
+        if (roles[i].data != NULL) {
+            cls.role = (const char*)roles[i].data;
+        } else {
+            cls.role.clear();
+        }
+    }
+    x11_util::free_properties(hints);
+    x11_util::free_properties(roles);
+}
+
+bool window::get_title(Display* disp, Window win, std::string& out) {
+    static thread_local Atom name_msg = x11_util::intern_atom(disp, "_NET_WM_NAME"),
+        utf8_type = x11_util::intern_atom(disp, "UTF8_STRING");
+    char* name = (char*)x11_util::get_property(disp, win, utf8_type, name_msg, NULL);
+    if (name == NULL) {
+        name = (char*)x11_util::get_property(disp, win, XA_STRING, XA_WM_NAME, NULL);
+    }
+    if (name == NULL) {
+        return false;
+    }
+    out = name;
+    x11_util::free_property(name);
+    return true;
+}
+
+bool window::set_desktop(Display* disp, Window win, long desktop) {
+    static thread_local Atom desktop_msg = x11_util::intern_atom(disp, "_NET_WM_DESKTOP");
+    return _client_msg(disp, win, desktop_msg,
+            desktop, SOURCE_INDICATION, 0, 0, 0);
+}
+
+bool window::get_current_desktop(Display* disp, long& out) {
+    static thread_local Atom curdesk_msg = x11_util::intern_atom(disp, "_NET_CURRENT_DESKTOP");
+    unsigned long desktop;
+    size_t count = 0;
+    if (!x11_util::get_values(disp, DefaultRootWindow(disp),
+                    XA_CARDINAL, curdesk_msg, &desktop, 1, &count) || count != 1) {
+        return false;
+    }
+    out = (long)desktop;
+    return true;
+}
+
+bool window::get_size(Display* disp, Window win, Dimensions& out_exterior,
+        unsigned int& out_margin_width, unsigned int& out_margin_height,
+        Window& out_frame) {
+    return get_window_size(disp, win, &out_exterior,
+            &out_margin_width, &out_margin_height, &out_frame);
+}
+
+void window::parse_size_hints(const unsigned long* values, size_t count,
+        SizeHints& out) {
+    /* flags, x/y/w/h (obsolete), min w/h, max w/h, inc w/h, min/max aspect,
+       base w/h, gravity. pre-ICCCM clients stop after the aspects. */
+    if (count < 11) {
+        return;
+    }
+    unsigned long flags = values[0];
+    if (flags & PMinSize) {
+        out.min_width = values[5];
+        out.min_height = values[6];
+    }
+    if (flags & PMaxSize) {
+        out.max_width = values[7];
+        out.max_height = values[8];
+    }
+    if (flags & PResizeInc) {
+        out.width_inc = values[9];
+        out.height_inc = values[10];
+    }
+    if ((flags & PBaseSize) && count >= 17) {
+        out.base_width = values[15];
+        out.base_height = values[16];
+    }
+    DEBUG("size hints: min %lux%lu max %lux%lu base %lux%lu inc %lux%lu",
+            out.min_width, out.min_height, out.max_width, out.max_height,
+            out.base_width, out.base_height, out.width_inc, out.height_inc);
+}
+
+bool window::activate(Display* disp, Window cur, Window next) {
+    return activate_window(disp, cur, next);
+}
+
+bool window::get_active(Display* disp, Window& out) {
+    return get_active_window(disp, out);
+}
+
+bool window::select_activate(grid::POS dir, const DesktopSnapshot* snapshot) {
+    TRACE_SPAN("select_activate");
+    PROBE(display_open_start);
+    Display* disp = open_display();
+    PROBE1(display_open_done, disp != NULL);
     if (disp == NULL) {
         ERROR("unable to get display");
         return false;
     }
 
-    std::vector<Window> wins;
+    Window active;
+    if (!get_active_window(disp, active)) {
+        x11_util::close_display(disp);
+        return false;
+    }
 
-    {
-        size_t win_count = 0;
-        static Atom clientlist_msg = XInternAtom(disp, "_NET_CLIENT_LIST", False);
-        Window* all_wins = (Window*)x11_util::get_property(disp, DefaultRootWindow(disp),
-                XA_WINDOW, clientlist_msg, &win_count);
-        if (all_wins == NULL || win_count == 0) {
+    if (snapshot != NULL && snapshot->prediction.active == active &&
+            snapshot->prediction.neighbors[dir] != 0) {
+        // already worked out which window to select
+        stats::count(stats::COUNTER_CACHE_HITS);
+        Window next = snapshot->prediction.neighbors[dir];
+        DEBUG("predicted %s of %lu: %lu", grid::pos_str(dir), active, next);
+        bool ok = activate_window(disp, active, next);
+        x11_util::close_display(disp);
+        return ok;
+    }
+
+    stats::count(stats::COUNTER_CACHE_MISSES);
+    if (snapshot != NULL) {
+        // the windows were already fetched, only need to check the active one
+        Window next;
+        if (!desktop::neighbor(*snapshot, active, dir, next)) {
             ERROR("unable to get list of windows");
-            if (all_wins != NULL) {
-                x11_util::free_property(all_wins);
-            }
-            XCloseDisplay(disp);
+            x11_util::close_display(disp);
             return false;
         }
-        // only select normal windows, ignore docks and menus
-        for (size_t i = 0; i < win_count; ++i) {
-            if (!is_dock_window(disp, all_wins[i]) && !is_menu_window(disp, all_wins[i])) {
-                wins.push_back(all_wins[i]);
-            }
-        }
-        x11_util::free_property(all_wins);
+        bool ok = activate_window(disp, active, next);
+        x11_util::close_display(disp);
+        return ok;
     }
 
+    std::vector<Window> wins;
     size_t active_window = 0;
     dim_list_t all_windows;
     {
-        Window* active = get_active_window(disp);
-        if (active == NULL) {
-            XCloseDisplay(disp);
-            return false;
+        TRACE_SPAN("select_clients");
+        size_t win_count = 0;
+        static thread_local Atom clientlist_msg = x11_util::intern_atom(disp, "_NET_CLIENT_LIST");
+        Window* all_wins = (Window*)x11_util::get_property(disp, DefaultRootWindow(disp),
+                XA_WINDOW, clientlist_msg, &win_count);
+        if (all_wins != NULL) {
+            // only select normal windows, ignore docks and menus
+            std::vector<bool> ignored;
+            find_ignored(disp, all_wins, win_count, ignored);
+            for (size_t i = 0; i < win_count; ++i) {
+                if (!ignored[i]) {
+                    wins.push_back(all_wins[i]);
+                }
+            }
+            x11_util::free_property(all_wins);
         }
+        PROBE3(select_clients, win_count, wins.size(), PROBE_REQUESTS(disp));
+
         for (size_t i = 0; i < wins.size(); ++i) {
-            if (wins[i] == *active) {
+            if (wins[i] == active) {
                 active_window = i;
                 DEBUG("ACTIVE:");
             }
             all_windows.push_back(Dimensions());
             get_window_size(disp, wins[i], &all_windows.back(), NULL, NULL);
         }
-        x11_util::free_property(active);
+    }
+
+    if (wins.empty()) {
+        ERROR("unable to get list of windows");
+        x11_util::close_display(disp);
+        return false;
     }
 
     size_t next_window;
@@ -298,51 +592,91 @@ bool window::select_activate(grid::POS dir) {
 
     bool ok = activate_window(disp, wins[active_window], wins[next_window]);
 
-    XCloseDisplay(disp);
+    x11_util::close_display(disp);
     return ok;
 }
 
 ActiveWindow::~ActiveWindow() {
-    if (disp != NULL) {
-        XCloseDisplay(disp);
-    }
-    if (win != NULL) {
-        x11_util::free_property(win);
+    if (disp != NULL && own_disp) {
+        x11_util::close_display(disp);
     }
 }
 
 bool ActiveWindow::init() {
     if (disp == NULL) {
-        disp = XOpenDisplay(NULL);
+        PROBE(display_open_start);
+        disp = open_display();
+        PROBE1(display_open_done, disp != NULL);
         if (disp == NULL) {
             ERROR("unable to get display");
             return false;
         }
     }
 
-    if (win == NULL) {
-        win = get_active_window(disp);
-        if (win == NULL) {
+    if (!have_win) {
+        if (!get_active_window(disp, win)) {
             return false;
         }
+        have_win = true;
     }
     return true;
 }
 
-bool ActiveWindow::Size(Dimensions& activewin) {
+bool ActiveWindow::Id(Window& out) {
     if (!init()) {
         return false;
     }
+    out = win;
+    return true;
+}
+
+void ActiveWindow::SetMargins(unsigned int width, unsigned int height) {
+    margin_width = width;
+    margin_height = height;
+    have_margins = true;
+}
 
-    if (is_dock_window(disp, *win) || is_menu_window(disp, *win)) {
+bool ActiveWindow::Size(Dimensions& activewin, SizeHints* out_hints) {
+    if (!init()) {
+        return false;
+    }
+
+    /* whether to leave the window alone, and how it may be sized, all in one
+       round trip */
+    static thread_local Atom wintype_msg = x11_util::intern_atom(disp, "_NET_WM_WINDOW_TYPE"),
+        state_msg = x11_util::intern_atom(disp, "_NET_WM_STATE");
+    const Atom types[] = { XA_ATOM, XA_ATOM, XA_WM_SIZE_HINTS };
+    const Atom names[] = { wintype_msg, state_msg, XA_WM_NORMAL_HINTS };
+    prop_list_t props;
+    x11_util::get_window_properties(disp, win, types, names,
+            (out_hints != NULL) ? 3 : 2, props);
+    if ((props[0].data != NULL &&
+                    has_dock_type(disp, win, (const Atom*)props[0].data, props[0].count)) ||
+            (props[1].data != NULL &&
+                    has_menu_state(disp, win, (const Atom*)props[1].data, props[1].count))) {
         LOG("Active window is a desktop or dock. Ignoring move request.");
+        x11_util::free_properties(props);
         return false;
     }
 
-    if (!get_window_size(disp, *win, &activewin, NULL, NULL)) {
+    // the margins come along for free, keep them for MoveResize
+    if (!get_window_size(disp, win, &activewin, &margin_width, &margin_height)) {
         ERROR("couldn't get window size");
+        x11_util::free_properties(props);
         return false;
     }
+    have_margins = true;
+
+    if (out_hints != NULL) {
+        *out_hints = SizeHints();
+        out_hints->margin_width = margin_width;
+        out_hints->margin_height = margin_height;
+        if (props[2].data != NULL) {
+            window::parse_size_hints((const unsigned long*)props[2].data,
+                    props[2].count, *out_hints);
+        }
+    }
+    x11_util::free_properties(props);
 
     DEBUG("activewin %dx %dy %luw %luh",
             activewin.x, activewin.y, activewin.width, activewin.height);
@@ -350,18 +684,35 @@ bool ActiveWindow::Size(Dimensions& activewin) {
     return true;
 }
 
-bool ActiveWindow::MoveResize(const Dimensions& activewin) {
+bool ActiveWindow::ReadyForResize() {
+#ifdef USE_XSYNC
+    if (!config::sync_enabled) {
+        return true;
+    }
     if (!init()) {
         return false;
     }
+    return window::sync::ready(disp, win);
+#else
+    return true;
+#endif
+}
 
-    unsigned int margin_width, margin_height;
-    if (!get_window_size(disp, *win, NULL, &margin_width, &margin_height)) {
+bool ActiveWindow::MoveResize(const Dimensions& activewin) {
+    TRACE_SPAN("move_resize");
+    if (!init()) {
         return false;
     }
 
+    if (!have_margins) {
+        if (!get_window_size(disp, win, NULL, &margin_width, &margin_height)) {
+            return false;
+        }
+        have_margins = true;
+    }
+
     //demaximize the window before attempting to move it
-    if (!maximize_window(disp, *win, false)) {
+    if (!maximize_window(disp, win, false)) {
         ERROR("couldn't demaximize");
         //disregard failure
     }
@@ -375,12 +726,21 @@ bool ActiveWindow::MoveResize(const Dimensions& activewin) {
             margin_width, margin_height,
             activewin.x, activewin.y, new_interior_width, new_interior_height);
 
-    if (XMoveResizeWindow(disp, *win, activewin.x, activewin.y,
-                    new_interior_width, new_interior_height) == 0) {
+#ifdef USE_XSYNC
+    if (config::sync_enabled) {
+        // windows without sync support are just resized as usual
+        window::sync::request(disp, win);
+    }
+#endif
+
+    if (!x11_util::move_resize(disp, win, activewin.x, activewin.y,
+                    new_interior_width, new_interior_height)) {
         ERROR("MoveResize to %ldx %ldy %luw %luh failed.",
                 activewin.x, activewin.y, new_interior_width, new_interior_height);
         return false;
     }
+    PROBE6(move_resize, win, activewin.x, activewin.y,
+            activewin.width, activewin.height, PROBE_REQUESTS(disp));
     return true;
 }
 
@@ -389,7 +749,7 @@ bool ActiveWindow::Maximize() {
         return false;
     }
 
-    if (!maximize_window(disp, *win, true)) {
+    if (!maximize_window(disp, win, true)) {
         ERROR("couldn't maximize");
         return false;
     }
@@ -400,8 +760,8 @@ bool ActiveWindow::DeFullscreen() {
         return false;
     }
 
-    static Atom fs = XInternAtom(disp, "_NET_WM_STATE_FULLSCREEN", False);
-    if (!set_window_state(disp, *win, fs, 0, false)) {
+    static thread_local Atom fs = x11_util::intern_atom(disp, "_NET_WM_STATE_FULLSCREEN");
+    if (!set_window_state(disp, win, fs, 0, false)) {
         ERROR("couldn't defullscreen");
         return false;
     }
@@ -412,8 +772,8 @@ bool ActiveWindow::DeShade() {
         return false;
     }
 
-    static Atom shade = XInternAtom(disp, "_NET_WM_STATE_SHADED", False);
-    if (!set_window_state(disp, *win, shade, 0, false)) {
+    static thread_local Atom shade = x11_util::intern_atom(disp, "_NET_WM_STATE_SHADED");
+    if (!set_window_state(disp, win, shade, 0, false)) {
         ERROR("couldn't deshade");
         return false;
     }
@@ -19,23 +19,98 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string>
+#include <vector>
 #include <X11/Xlib.h>
 
 #include "pos.h"
+#include "desktop.h"
 #include "dimensions.h"
 
 namespace window {
-    /* Finds the nearest window in the given direction and activates it. */
-    bool select_activate(grid::POS dir);
+    /* Finds the nearest window in the given direction and activates it.
+     * Uses the windows in 'snapshot' if one is provided, otherwise they're
+     * fetched from the display. */
+    bool select_activate(grid::POS dir, const DesktopSnapshot* snapshot = NULL);
+
+    /* Activates 'next' in place of 'cur'. Returns true on success, else false. */
+    bool activate(Display* disp, Window cur, Window next);
+
+    /* Gets the currently active window. Returns true on success, else false. */
+    bool get_active(Display* disp, Window& out);
+
+    /* Returns whether the window is a desktop, dock, or menu, which shouldn't
+     * be selected or moved. */
+    bool is_ignored(Display* disp, Window win);
+    /* Like is_ignored(), for each of 'wins', but without a round trip per
+     * window. Windows which can't be checked aren't ignored. If 'hidden_out'
+     * is provided, it's set for each window that's minimized
+     * (_NET_WM_STATE_HIDDEN), from the same reply. */
+    void find_ignored(Display* disp, const Window* wins, size_t count,
+            std::vector<bool>& out, std::vector<bool>* hidden_out = NULL);
+
+    /* Gets the window's WM_CLASS instance and class, and its WM_WINDOW_ROLE
+     * (empty if it has none). Returns false if the window lacks a WM_CLASS. */
+    bool get_class(Display* disp, Window win, std::string& out_instance,
+            std::string& out_class, std::string& out_role);
+
+    struct Class {
+        bool found;// false if the window lacks a WM_CLASS
+        std::string instance, wm_class, role;
+    };
+    /* Like get_class(), for each of 'wins', in two round trips rather than
+     * two per window. 'out' gets an entry for each window, in order. */
+    void get_classes(Display* disp, const Window* wins, size_t count,
+            std::vector<Class>& out);
+
+    /* Gets the window's title, preferring _NET_WM_NAME over WM_NAME.
+     * Returns false if it has neither. */
+    bool get_title(Display* disp, Window win, std::string& out);
+
+    /* Moves the window to the given desktop (-1 for all desktops).
+     * Returns true on success, else false. */
+    bool set_desktop(Display* disp, Window win, long desktop);
+
+    /* Gets the desktop which is being shown. Returns false if there isn't a
+     * window manager to say. */
+    bool get_current_desktop(Display* disp, long& out);
+
+    /* Gets the window's exterior size, its margins (exterior - interior),
+     * and the frame window which the exterior size came from.
+     * Returns true on success, else false. */
+    bool get_size(Display* disp, Window win, Dimensions& out_exterior,
+            unsigned int& out_margin_width, unsigned int& out_margin_height,
+            Window& out_frame);
+
+    /* Fills in 'out' from the format-32 values of a WM_NORMAL_HINTS
+     * property, leaving its margins alone. */
+    void parse_size_hints(const unsigned long* values, size_t count, SizeHints& out);
 }
 
 class ActiveWindow {
 public:
-    ActiveWindow() : disp(NULL), win(NULL) { }
+    ActiveWindow()
+        : disp(NULL), own_disp(true), win(0), have_win(false), have_margins(false) { }
+    /* Uses the caller's connection and an already known window, rather than
+     * connecting and looking up the active window. */
+    ActiveWindow(Display* disp, Window win)
+        : disp(disp), own_disp(false), win(win), have_win(true), have_margins(false) { }
     virtual ~ActiveWindow();
 
-    bool Size(Dimensions& activewin);
+    bool Id(Window& out);
+    /* Gets the window's exterior size. If 'out_hints' isn't NULL, it also
+     * gets the window's WM_NORMAL_HINTS and margins, without another round
+     * trip. */
+    bool Size(Dimensions& activewin, SizeHints* out_hints = NULL);
+
+    /* Skips looking up the window's margins in MoveResize, if they're
+     * already known. */
+    void SetMargins(unsigned int width, unsigned int height);
 
+    /* Returns whether the window is ready for another resize. Always true
+     * unless sync pacing is enabled and the window is still redrawing from
+     * a previous resize. */
+    bool ReadyForResize();
     bool MoveResize(const Dimensions& activewin);
 
     bool Maximize();
@@ -46,7 +121,10 @@ private:
     bool init();
 
     Display* disp;
-    Window* win;
+    bool own_disp;
+    Window win;
+    bool have_win, have_margins;
+    unsigned int margin_width, margin_height;
 };
 
 #endif
@@ -16,57 +16,169 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "backend-xlib.h"
 #include "config.h"
+#include "runtime-cache.h"
+#include "trace.h"
 #include "x11-util.h"
 
-#define MAX_PROPERTY_VALUE_LEN 4096
+namespace {
+    XlibBackend xlib_backend;
+    Backend* backend = &xlib_backend;
+    // a daemon thread serving one screen, empty for $DISPLAY
+    thread_local std::string thread_display;
+    // a connection which the thread keeps open across commands, if any
+    thread_local Display* thread_connection = NULL;
+}
+
+void x11_util::set_backend(Backend* new_backend) {
+    backend = new_backend;
+}
+
+Backend* x11_util::get_backend() {
+    return backend;
+}
+
+bool x11_util::is_fake() {
+    return backend != &xlib_backend;
+}
+
+void x11_util::set_thread_display(const char* name) {
+    if (name != NULL) {
+        thread_display = name;
+    } else {
+        thread_display.clear();
+    }
+}
+
+void x11_util::set_thread_connection(Display* disp) {
+    thread_connection = disp;
+}
+
+Display* x11_util::open_display() {
+    if (thread_connection != NULL) {
+        return thread_connection;
+    }
+    return backend->Open(thread_display.empty() ? NULL : thread_display.c_str());
+}
+
+void x11_util::close_display(Display* disp) {
+    if (disp == thread_connection) {
+        // left open for the next command
+        backend->Flush(disp);
+    } else {
+        backend->Close(disp);
+    }
+}
+
+Atom x11_util::intern_atom(Display* disp, const char* name) {
+    TRACE_SPAN("intern_atom");
+    Atom atom;
+    if (runtime_cache::find_atom(disp, name, atom)) {
+        return atom;
+    }
+    atom = backend->InternAtom(disp, name);
+    runtime_cache::save_atom(disp, name, atom);
+    return atom;
+}
+
+std::string x11_util::atom_name(Display* disp, Atom atom) {
+    std::string ret;
+    if (atom == None || !backend->AtomName(disp, atom, ret)) {
+        ret = "?";
+    }
+    return ret;
+}
 
 unsigned char* x11_util::get_property(Display *disp, Window win,
         Atom xa_prop_type, Atom xa_prop_name, size_t* out_count) {
-    Atom xa_ret_type;
-    int ret_format;
-    unsigned long ret_nitems, ret_bytes_after;
-    unsigned char* ret_prop;
-
-    /* MAX_PROPERTY_VALUE_LEN / 4 explanation (XGetWindowProperty manpage):
-     *
-     * long_length = Specifies the length in 32-bit multiples of the
-     *               data to be retrieved.
-     */
-    if (XGetWindowProperty(disp, win, xa_prop_name, 0, MAX_PROPERTY_VALUE_LEN / 4, false,
-                    xa_prop_type, &xa_ret_type, &ret_format,
-                    &ret_nitems, &ret_bytes_after, &ret_prop) != Success) {
-        ERROR("Cannot get property %d/%s.", xa_prop_name, XGetAtomName(disp, xa_prop_name));
-        return NULL;
-    } else {
-        DEBUG("Property %d/%s -> %lu items", xa_prop_name, XGetAtomName(disp, xa_prop_name), ret_nitems);
+    size_t count = 0;
+    int format = 0;
+    unsigned char* ret = backend->GetProperty(disp, win, xa_prop_type, xa_prop_name,
+            &count, &format);
+    if (ret != NULL && out_count != NULL) {
+        *out_count = count;
     }
+    return ret;
+}
 
-    if (xa_ret_type != xa_prop_type) {
-        if (xa_ret_type == None) {
-            // avoid crash on XGetAtomName(None)
-            char *req = XGetAtomName(disp, xa_prop_type);
-            //not necessarily an error, can happen if the window in question just lacks the requested property
-            //DEBUG("Unsupported or invalid request %s: requested type %s, got <none>", prop_name, req);
-            XFree(req);
-        } else {
-            char *req = XGetAtomName(disp, xa_prop_type),
-                *got = XGetAtomName(disp, xa_ret_type);
-            ERROR("Invalid type of property %d/%s: req %s, got %s",
-                    xa_prop_name, XGetAtomName(disp, xa_prop_name), req, got);
-            XFree(req);
-            XFree(got);
-        }
-        XFree(ret_prop);
-        return NULL;
+bool x11_util::get_values(Display* disp, Window win, Atom xa_prop_type, Atom xa_prop_name,
+        unsigned long* out, size_t capacity, size_t* out_count) {
+    size_t count = 0;
+    bool found = backend->GetValues(disp, win, xa_prop_type, xa_prop_name,
+            out, capacity, &count);
+    if (found) {
+        *out_count = count;
     }
+    return found;
+}
 
-    if (out_count != NULL) {
-        *out_count = ret_nitems;
+void x11_util::get_properties(Display* disp, const Window* wins, size_t count,
+        Atom xa_prop_type, Atom xa_prop_name, prop_list_t& out) {
+    TRACE_SPAN("get_properties");
+    backend->GetProperties(disp, wins, count, xa_prop_type, xa_prop_name, out);
+}
+
+void x11_util::get_window_properties(Display* disp, Window win, const Atom* xa_prop_types,
+        const Atom* xa_prop_names, size_t count, prop_list_t& out) {
+    TRACE_SPAN("get_window_properties");
+    backend->GetWindowProperties(disp, win, xa_prop_types, xa_prop_names, count, out);
+}
+
+void x11_util::free_properties(prop_list_t& props) {
+    for (size_t i = 0; i < props.size(); ++i) {
+        XFree(props[i].data);
     }
-    return ret_prop;
+    props.clear();
 }
 
 void x11_util::free_property(void* prop) {
     XFree(prop);
 }
+
+void x11_util::set_property(Display* disp, Window win, Atom xa_prop_type, Atom xa_prop_name,
+        const unsigned long* values, size_t count) {
+    backend->SetProperty(disp, win, xa_prop_type, xa_prop_name, values, count);
+}
+
+Status x11_util::get_geometry(Display* disp, Window win, Window* out_root,
+        int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+        unsigned int* out_border, unsigned int* out_depth) {
+    Status status = backend->GetGeometry(disp, win, out_root, out_x, out_y,
+            out_width, out_height, out_border, out_depth);
+    if (status == 0) {
+        *out_root = 0;
+        *out_x = *out_y = 0;
+        *out_width = *out_height = *out_border = *out_depth = 0;
+    }
+    return status;
+}
+
+Status x11_util::query_tree(Display* disp, Window win, Window* out_root, Window* out_parent,
+        Window** out_children, unsigned int* out_children_count) {
+    return backend->QueryTree(disp, win, out_root, out_parent,
+            out_children, out_children_count);
+}
+
+bool x11_util::query_screens(Display* disp, dim_list_t& out) {
+    return backend->QueryScreens(disp, out);
+}
+
+bool x11_util::send_message(Display* disp, Window win, Atom type,
+        long data0, long data1, long data2, long data3, long data4) {
+    long data[5] = { data0, data1, data2, data3, data4 };
+    return backend->SendMessage(disp, win, type, data);
+}
+
+bool x11_util::move_resize(Display* disp, Window win,
+        long x, long y, unsigned long width, unsigned long height) {
+    return backend->MoveResize(disp, win, x, y, width, height);
+}
+
+void x11_util::trap_errors(Display* disp) {
+    backend->BeginErrorTrap(disp);
+}
+
+bool x11_util::untrap_errors(Display* disp) {
+    return backend->EndErrorTrap(disp);
+}
@@ -19,14 +19,87 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <stdint.h>
 
+#include "backend.h"
+
+/* Everything that talks to the display goes through here, and from here to
+ * the current Backend (Xlib unless another is set). */
 namespace x11_util {
+    /* Replaces the backend, eg with a FakeBackend. Must be called before any
+     * display is opened. 'backend' isn't deleted. */
+    void set_backend(Backend* backend);
+    Backend* get_backend();
+    /* Whether the backend is something other than plain Xlib (eg faked,
+     * recorded, or replayed), which the daemon and --sync can't use. */
+    bool is_fake();
+
+    /* Sets the display which open_display() connects to from the calling
+     * thread, eg ":1.0". NULL (the default) uses $DISPLAY. */
+    void set_thread_display(const char* name);
+
+    /* Makes open_display() on the calling thread return 'disp' rather than
+     * connecting, and close_display() just flush it, so that a daemon thread
+     * reuses one connection for every command. NULL to stop. */
+    void set_thread_connection(Display* disp);
+
+    /* Opens/closes a connection through the backend. Closing flushes any
+     * requests which are still queued. */
+    Display* open_display();
+    void close_display(Display* disp);
+
+    /* Looks up (or creates) the named atom. This is a round trip, so callers
+     * keep the result in a static. */
+    Atom intern_atom(Display* disp, const char* name);
+    /* Gets the atom's name, or "?" if it's unknown. Also a round trip. */
+    std::string atom_name(Display* disp, Atom atom);
+
     unsigned char* get_property(Display *disp, Window win,
             Atom xa_prop_type, Atom xa_prop_name, size_t* out_count);
     void free_property(void* prop);
+    /* Gets up to 'capacity' values of a format-32 property into 'out',
+     * without allocating. Returns false if the window lacks the property. */
+    bool get_values(Display* disp, Window win, Atom xa_prop_type, Atom xa_prop_name,
+            unsigned long* out, size_t capacity, size_t* out_count);
+    /* Gets the same property from each of 'wins' in a single round trip.
+     * 'out' gets a reply for each window, in order, which must be freed with
+     * free_properties(). */
+    void get_properties(Display* disp, const Window* wins, size_t count,
+            Atom xa_prop_type, Atom xa_prop_name, prop_list_t& out);
+    /* Gets several properties of 'win' in a single round trip, one for each
+     * of 'xa_prop_types' and 'xa_prop_names'. */
+    void get_window_properties(Display* disp, Window win, const Atom* xa_prop_types,
+            const Atom* xa_prop_names, size_t count, prop_list_t& out);
+    void free_properties(prop_list_t& props);
+    /* Replaces a format-32 property, or deletes it if 'count' is 0. */
+    void set_property(Display* disp, Window win, Atom xa_prop_type, Atom xa_prop_name,
+            const unsigned long* values, size_t count);
+
+    /* Like XGetGeometry()/XQueryTree(). 'out_children' must be freed with XFree(). */
+    Status get_geometry(Display* disp, Window win, Window* out_root,
+            int* out_x, int* out_y, unsigned int* out_width, unsigned int* out_height,
+            unsigned int* out_border, unsigned int* out_depth);
+    Status query_tree(Display* disp, Window win, Window* out_root, Window* out_parent,
+            Window** out_children, unsigned int* out_children_count);
+    /* Gets the area of each monitor, or returns false if they're unknown. */
+    bool query_screens(Display* disp, dim_list_t& out);
+
+    /* Sends a format-32 client message about 'win' to the window manager. */
+    bool send_message(Display* disp, Window win, Atom type,
+            long data0, long data1, long data2, long data3, long data4);
+    /* Moves the window's frame to 'x','y', and resizes the window itself to
+     * 'width','height'. */
+    bool move_resize(Display* disp, Window win,
+            long x, long y, unsigned long width, unsigned long height);
+
+    /* Between these, errors from round trips (eg about a window which has
+     * since been destroyed) are swallowed rather than ending the process.
+     * untrap_errors() returns whether there were any. */
+    void trap_errors(Display* disp);
+    bool untrap_errors(Display* disp);
 }
 
 #endif